@@ -0,0 +1,365 @@
+/*
+ * File: Sudoku-Affinity.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Thread placement. Parses CPU lists for pinning the pool workers and the thread that reads
+ *              and writes the corpus, applies them, and picks the default pool size from the CPUs the
+ *              process may actually use: its affinity mask, capped by any cgroup CPU quota.
+ */
+
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// Where cgroup v1 mounts the cpu controller; the first that exists is used.
+static const char *cgroupV1Roots[] = {"/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu"};
+
+
+/*
+ * Function: cpuCount
+ * ------------------
+ * Returns: The number of CPUs in a placement bitmap.
+ */
+
+static unsigned cpuCount(const uint64_t cpus[MAX_CPUS / 64]) {
+    unsigned count = 0;
+
+    for (int w = 0; w < MAX_CPUS / 64; w++) {
+        count += (unsigned)__builtin_popcountll(cpus[w]);
+    }
+    return count;
+}
+
+
+/*
+ * Function: toCpuSet
+ * ------------------
+ * Converts a placement bitmap to a cpu_set_t.
+ */
+
+static void toCpuSet(const uint64_t cpus[MAX_CPUS / 64], cpu_set_t *set) {
+    CPU_ZERO(set);
+    for (int cpu = 0; cpu < MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        if (cpus[cpu / 64] & ((uint64_t)1 << (cpu % 64))) {
+            CPU_SET(cpu, set);
+        }
+    }
+}
+
+
+/*
+ * Function: parseCpuList
+ * ----------------------
+ * Parses a CPU list in the kernel's cpuset syntax: comma-separated CPU numbers and ranges, such as
+ * "0-3,8,10-11". Every CPU must be in the process's affinity mask.
+ *
+ * text: The list.
+ * cpus: Receives the CPUs.
+ *
+ * Returns: true on success, false if the list is malformed or names a CPU the process may not use.
+ */
+
+static bool parseCpuList(const char *text, uint64_t cpus[MAX_CPUS / 64]) {
+    cpu_set_t allowed;
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    const char *p = text;
+
+    memset(cpus, 0, MAX_CPUS / 8);
+    for (;;) {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p) {
+            return false;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(++p, &end, 10);
+            if (end == p) {
+                return false;
+            }
+            p = end;
+        }
+        if (first < 0 || last < first || last >= MAX_CPUS) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (haveMask && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))) {
+                return false;
+            }
+            cpus[cpu / 64] |= (uint64_t)1 << (cpu % 64);
+        }
+        if (*p == '\0') {
+            return true;
+        }
+        if (*p++ != ',') {
+            return false;
+        }
+    }
+}
+
+
+/*
+ * Function: isPlacementOption
+ * ---------------------------
+ * Returns: true if an argument is one of the placement options handled by parsePlacementOption.
+ */
+
+bool isPlacementOption(const char *option) {
+    return strcmp(option, "--cpus") == 0 || strcmp(option, "--cpuset") == 0 || strcmp(option, "--io-cpus") == 0;
+}
+
+
+/*
+ * Function: parsePlacementOption
+ * ------------------------------
+ * Applies one placement option to a placement:
+ *      --cpus LIST     pins worker i to the i-th CPU of LIST, cycling when there are more workers;
+ *      --cpuset LIST   lets the workers share the CPUs of LIST;
+ *      --io-cpus LIST  places the thread that reads and writes the corpus, and the decompressor it starts.
+ *
+ * params:
+ *      placement: The placement to update; zero it before the first option.
+ *      option: The option name.
+ *      value: The CPU list.
+ *
+ * Returns: true on success, false if the list is malformed or names a CPU the process may not use.
+ */
+
+bool parsePlacementOption(cpuPlacement *placement, const char *option, const char *value) {
+    if (strcmp(option, "--io-cpus") == 0) {
+        return parseCpuList(value, placement->io);
+    }
+    placement->pinEach = strcmp(option, "--cpus") == 0;
+    return parseCpuList(value, placement->workers);
+}
+
+
+/*
+ * Function: readCgroupLimit
+ * -------------------------
+ * Reads the CPU quota of one cgroup directory, as a number of CPUs: cpu.max for cgroup v2, or
+ * cpu.cfs_quota_us over cpu.cfs_period_us for v1.
+ *
+ * Returns: The quota, or 0 if the directory sets none.
+ */
+
+static double readCgroupLimit(const char *dir, bool v2) {
+    char path[4096 + 32];
+    long long quota = 0, period = 0;
+    FILE *file;
+
+    if (v2) {
+        char max[32];
+        snprintf(path, sizeof(path), "%s/cpu.max", dir);
+        if (!(file = fopen(path, "r"))) {
+            return 0;
+        }
+        if (fscanf(file, "%31s %lld", max, &period) == 2 && strcmp(max, "max") != 0) {
+            quota = atoll(max);
+        }
+        fclose(file);
+    } else {
+        snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+        if ((file = fopen(path, "r"))) {
+            if (fscanf(file, "%lld", &quota) != 1) {
+                quota = 0;
+            }
+            fclose(file);
+        }
+        snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+        if ((file = fopen(path, "r"))) {
+            if (fscanf(file, "%lld", &period) != 1) {
+                period = 0;
+            }
+            fclose(file);
+        }
+    }
+    return quota > 0 && period > 0 ? (double)quota / (double)period : 0;
+}
+
+
+/*
+ * Function: cgroupLimitAlong
+ * --------------------------
+ * Finds the tightest CPU quota on the path from the process's cgroup up to the hierarchy root, since a
+ * quota on any ancestor also throttles the process.
+ *
+ * root: Mount point of the hierarchy.
+ * group: The process's cgroup, relative to the root, from /proc/self/cgroup.
+ * v2: Whether the hierarchy is cgroup v2.
+ *
+ * Returns: The quota as a number of CPUs, or 0 if none is set.
+ */
+
+static double cgroupLimitAlong(const char *root, const char *group, bool v2) {
+    char dir[4096];
+    size_t rootLength = strlen(root);
+    double limit = 0;
+
+    snprintf(dir, sizeof(dir), "%s%s", root, strcmp(group, "/") == 0 ? "" : group);
+    for (;;) {
+        double level = readCgroupLimit(dir, v2);
+        if (level > 0 && (limit == 0 || level < limit)) {
+            limit = level;
+        }
+        char *slash = strrchr(dir, '/');
+        if (strlen(dir) <= rootLength || !slash || (size_t)(slash - dir) < rootLength) {
+            return limit;
+        }
+        *slash = '\0';
+    }
+}
+
+
+/*
+ * Function: cgroupCpuLimit
+ * ------------------------
+ * Reads the CPU quota the process runs under, from whichever cgroup hierarchy controls its CPU time.
+ *
+ * Returns: The quota as a number of CPUs (possibly fractional), or 0 if there is none.
+ */
+
+static double cgroupCpuLimit(void) {
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    char line[4096];
+    double limit = 0;
+
+    if (!file) {
+        return 0;
+    }
+    // Lines are "hierarchy-id:controllers:path"; the v2 hierarchy has an empty controller list
+    while (fgets(line, sizeof(line), file)) {
+        char *controllers = strchr(line, ':');
+        char *group = controllers ? strchr(controllers + 1, ':') : NULL;
+        if (!group) {
+            continue;
+        }
+        *group++ = '\0';
+        controllers++;
+        group[strcspn(group, "\n")] = '\0';
+
+        double found = 0;
+        if (*controllers == '\0') {
+            found = cgroupLimitAlong("/sys/fs/cgroup", group, true);
+        } else {
+            bool cpu = false;
+            for (char *name = strtok(controllers, ","); name; name = strtok(NULL, ",")) {
+                cpu = cpu || strcmp(name, "cpu") == 0;
+            }
+            for (size_t i = 0; cpu && i < sizeof(cgroupV1Roots) / sizeof(cgroupV1Roots[0]); i++) {
+                if (access(cgroupV1Roots[i], F_OK) == 0) {
+                    found = cgroupLimitAlong(cgroupV1Roots[i], group, false);
+                    break;
+                }
+            }
+        }
+        if (found > 0 && (limit == 0 || found < limit)) {
+            limit = found;
+        }
+    }
+    fclose(file);
+    return limit;
+}
+
+
+/*
+ * Function: defaultThreads
+ * ------------------------
+ * Picks the default pool size: one worker per CPU the workers are placed on, or else per CPU in the
+ * process's affinity mask, but no more than the cgroup quota rounded up. Running more workers than the
+ * quota allows only gets them throttled together at the end of each period, which shows up as latency
+ * spikes rather than throughput.
+ *
+ * placement: The placement in effect, or NULL.
+ *
+ * Returns: The number of workers, at least 1.
+ */
+
+unsigned defaultThreads(const cpuPlacement *placement) {
+    cpu_set_t set;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned cpus = online > 0 ? (unsigned)online : 1;
+
+    if (placement && cpuCount(placement->workers) > 0) {
+        cpus = cpuCount(placement->workers);
+    } else if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+        cpus = (unsigned)CPU_COUNT(&set);
+    }
+
+    double quota = cgroupCpuLimit();
+    if (quota > 0) {
+        unsigned allowed = (unsigned)quota;
+        allowed += (double)allowed < quota;
+        if (allowed < cpus) {
+            cpus = allowed;
+        }
+    }
+    return cpus > 0 ? cpus : 1;
+}
+
+
+/*
+ * Function: placeWorkerThread
+ * ---------------------------
+ * Places the calling pool worker according to a placement: on a single CPU with --cpus, on the whole
+ * set with --cpuset. Leaves the thread alone when no worker CPUs were given.
+ *
+ * With --cpus, worker i takes the (i + firstWorker)-th CPU of the list, cycling when there are more workers.
+ *
+ * placement: The placement.
+ * index: The worker's index in its pool.
+ *
+ * Returns: true on success or when there is nothing to do, false if the affinity could not be set.
+ */
+
+bool placeWorkerThread(const cpuPlacement *placement, unsigned index) {
+    unsigned count = cpuCount(placement->workers);
+    cpu_set_t set;
+
+    if (count == 0) {
+        return true;
+    }
+    if (placement->pinEach) {
+        unsigned skip = (index + placement->firstWorker) % count;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if ((placement->workers[cpu / 64] & ((uint64_t)1 << (cpu % 64))) && skip-- == 0) {
+                CPU_SET(cpu, &set);
+                break;
+            }
+        }
+    } else {
+        toCpuSet(placement->workers, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+
+/*
+ * Function: placeIoThread
+ * -----------------------
+ * Places the calling thread on the --io-cpus set. Threads it starts afterwards, such as the corpus
+ * decompressor, inherit the placement, so call it after creating the pool and before opening the
+ * corpus.
+ *
+ * placement: The placement.
+ *
+ * Returns: true on success or when no I/O CPUs were given, false if the affinity could not be set.
+ */
+
+bool placeIoThread(const cpuPlacement *placement) {
+    cpu_set_t set;
+
+    if (cpuCount(placement->io) == 0) {
+        return true;
+    }
+    toCpuSet(placement->io, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
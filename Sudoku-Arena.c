@@ -0,0 +1,147 @@
+/*
+ * File: Sudoku-Arena.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Bump allocator for batch storage. Grids, task descriptors, and verdict buffers are carved
+ *              out of a few large slabs mapped straight from the kernel, huge-page backed where the
+ *              system allows, and released all at once. A batch sizes its arena up front, so its
+ *              footprint is fixed by the thread count and chunk size however large the corpus is, and
+ *              the rounds themselves never call malloc.
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "Sudoku-Validator.h"
+
+// Huge page size assumed when rounding slabs for MAP_HUGETLB.
+#define HUGE_PAGE_BYTES ((size_t)2 << 20)
+
+// Alignment of every allocation: a cache line, so workers' pieces never share one.
+#define ARENA_ALIGN 64
+
+// Header at the start of each slab; allocations follow it.
+struct arenaSlab {
+    arenaSlab *next;
+    size_t size;         // Bytes mapped, header included
+    size_t used;         // Bytes handed out, header included
+} __attribute__((aligned(ARENA_ALIGN)));
+
+
+/*
+ * Function: mapSlab
+ * -----------------
+ * Maps a slab of at least the given size. Explicit huge pages are tried first; when none are reserved
+ * the slab falls back to ordinary pages with a transparent huge page hint.
+ *
+ * params:
+ *      size: Bytes wanted.
+ *      huge: Set to true if the slab got explicit huge pages.
+ *
+ * Returns: The slab, or NULL if no memory could be mapped.
+ */
+
+static arenaSlab *mapSlab(size_t size, bool *huge) {
+    size_t hugeSize = (size + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    void *memory = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    memory = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    *huge = memory != MAP_FAILED;
+    if (*huge) {
+        size = hugeSize;
+    } else {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    arenaSlab *slab = (arenaSlab *)memory;
+    slab->next = NULL;
+    slab->size = size;
+    slab->used = sizeof(arenaSlab);
+    return slab;
+}
+
+
+/*
+ * Function: arenaInit
+ * -------------------
+ * Prepares an empty arena. No memory is mapped until the first allocation.
+ *
+ * a: The arena.
+ * slabBytes: Size of each slab; a batch that knows its needs passes the total so one slab holds all.
+ */
+
+void arenaInit(arena *a, size_t slabBytes) {
+    a->slabs = a->current = NULL;
+    a->slabBytes = slabBytes;
+    a->footprint = 0;
+    a->hugePages = false;
+}
+
+
+/*
+ * Function: arenaAlloc
+ * --------------------
+ * Hands out cache-line aligned memory from the current slab, mapping a new slab when it is full. The
+ * memory is zero, as the kernel mapped it.
+ *
+ * a: The arena.
+ * bytes: Size of the allocation.
+ *
+ * Returns: The memory, or NULL if a new slab was needed and could not be mapped.
+ */
+
+void *arenaAlloc(arena *a, size_t bytes) {
+    arenaSlab *slab = a->current;
+
+    bytes = (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!slab || slab->size - slab->used < bytes) {
+        size_t size = sizeof(arenaSlab) + bytes > a->slabBytes ? sizeof(arenaSlab) + bytes : a->slabBytes;
+        bool huge;
+        slab = mapSlab(size, &huge);
+        if (!slab) {
+            return NULL;
+        }
+        if (a->current) {
+            a->current->next = slab;
+        } else {
+            a->slabs = slab;
+        }
+        a->footprint += slab->size;
+        a->hugePages = a->hugePages || huge;
+    }
+    a->current = slab;
+    void *memory = (char *)slab + slab->used;
+    slab->used += bytes;
+    return memory;
+}
+
+
+/*
+ * Function: arenaFree
+ * -------------------
+ * Unmaps every slab. The arena is left empty and may be used again.
+ */
+
+void arenaFree(arena *a) {
+    arenaSlab *slab = a->slabs;
+
+    while (slab) {
+        arenaSlab *next = slab->next;
+        munmap(slab, slab->size);
+        slab = next;
+    }
+    a->slabs = a->current = NULL;
+    a->footprint = 0;
+    a->hugePages = false;
+}
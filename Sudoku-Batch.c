@@ -0,0 +1,984 @@
+/*
+ * File: Sudoku-Batch.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Batch validation of every grid in a corpus file. The corpus is streamed one round at a
+ *              time, so memory stays bounded; each round is split into fixed-size chunks, each worker
+ *              validates a chunk and formats its verdicts into a private buffer, and the buffers of a
+ *              round are written out in order with a single writev. Long runs can checkpoint between
+ *              rounds and resume from the last checkpoint after a crash, and very large corpora can be
+ *              split between forked processes that report back through shared memory.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// Grids per chunk. A multiple of 8 so bitmap chunks start on a byte boundary.
+#define BATCH_CHUNK_GRIDS 8192
+
+// Default seconds between checkpoints.
+#define BATCH_CHECKPOINT_SECONDS 60
+
+// Upper bound on the full report for one grid with the given number of units, plus the summary line.
+#define BATCH_FULL_GRID_BYTES(units) ((units) * 40 + 64)
+
+// Struct describing the chunk one batch worker is responsible for.
+typedef struct {
+    const gridCell (*grids)[SIZE][SIZE]; // The chunk's grids
+    const gridCell *cells;    // The chunk's grids when shape is set, order^2 cells each
+    size_t first;        // Corpus index of the first grid in the chunk
+    size_t count;        // Number of grids in the chunk
+    verdictMode mode;
+    bool puzzle;         // Check givens only; 0 marks an empty cell
+    const unitTable *units;                   // The variant's units
+    bool (*check)(const gridCell[SIZE][SIZE]);     // Specialized check for the variant, or NULL for the generic engine
+    const gridShape *shape;                   // Grid shape other than SIZE x SIZE, or NULL
+    bool (*shapeCheck)(const gridCell *cells);     // Compiled kernel for the shape, or NULL for shapeValidate
+    const char *source;  // Name used in full-mode summary lines
+    outputBuffer *out;   // Sized so formatting a whole chunk never triggers a flush
+    size_t valid;
+} batchTask;
+
+// One shard of a multi-process run, in memory shared with the parent. The shard's verdict bitmap
+// follows the shard table in the same mapping.
+typedef struct {
+    int64_t start;           // Byte range of the corpus the shard validates
+    int64_t end;
+    size_t bitmapOffset;     // Offset of the shard's bitmap from the start of the mapping
+    size_t bitmapBytes;
+    uint64_t grids;          // Filled in by the shard process
+    uint64_t valid;
+    uint64_t footprint;      // Bytes the shard's arena mapped
+    bool hugePages;          // Whether the arena got explicit huge pages
+    int error;               // errno value of a failure in the shard, or 0
+    bool done;
+} __attribute__((aligned(64))) shardResult;
+
+
+/*
+ * Function: checkGrid
+ * -------------------
+ * Validates grid n of the chunk with the task's specialized check, or with the generic engine when the
+ * variant or shape has none.
+ */
+
+static inline bool checkGrid(const batchTask *task, size_t n) {
+    if (task->shape) {
+        const gridCell *cells = task->cells + n * (size_t)(task->shape->order * task->shape->order);
+        return task->shapeCheck ? task->shapeCheck(cells) : shapeValidate(task->shape, cells, task->puzzle);
+    }
+    return task->check ? task->check(task->grids[n]) : validateUnits(task->units, task->grids[n], task->puzzle);
+}
+
+
+/*
+ * Function: formatFull
+ * --------------------
+ * Checks every unit of the variant and appends the same report a single-grid run prints, with extra
+ * lines for any diagonals or windows. In puzzle mode each unit is only checked for conflicting givens.
+ *
+ * task: The chunk being processed.
+ * n: Position of the grid in the chunk.
+ * index: Position of the grid in the corpus.
+ *
+ * Returns: true if the grid is valid, false otherwise.
+ */
+
+static bool formatFull(batchTask *task, size_t n, size_t index) {
+    static const char *kinds[3] = {"row", "column", "subgrid"};
+    bool isValid = true;
+
+    if (task->shape) {
+        int order = task->shape->order;
+        const gridCell *cells = task->cells + n * (size_t)(order * order);
+        for (int i = 0; i < 3 * order; i++) {
+            bool valid = shapeUnitValid(task->shape, cells, i, task->puzzle);
+            outputNamedUnitLine(task->out, i, kinds[i / order], i % order + 1, valid);
+            isValid = isValid && valid;
+        }
+    } else {
+        for (int i = 0; i < task->units->count; i++) {
+            bool valid = isTableUnitValid(task->units, task->grids[n], i, task->puzzle);
+            outputNamedUnitLine(task->out, i, unitKindName(task->units, i), task->units->number[i], valid);
+            isValid = isValid && valid;
+        }
+    }
+
+    outputString(task->out, task->source);
+    outputString(task->out, "[");
+    outputUnsigned(task->out, index);
+    if (task->puzzle) {
+        outputString(task->out, isValid ? "] contains a consistent puzzle\n" : "] contains an INCONSISTENT puzzle\n");
+    } else {
+        outputString(task->out, isValid ? "] contains a valid solution\n" : "] contains an INVALID solution\n");
+    }
+    return isValid;
+}
+
+
+/*
+ * Function: batchWorker
+ * ---------------------
+ * Validates one chunk and formats its verdicts in the requested mode.
+ *
+ * arg: Pointer to a batchTask.
+ *
+ * Returns: NULL.
+ */
+
+static void *batchWorker(void *arg) {
+    batchTask *task = (batchTask *)arg;
+    unsigned char bits = 0;
+
+    task->valid = 0;
+    for (size_t n = 0; n < task->count; n++) {
+        bool valid;
+
+        switch (task->mode) {
+            case VERDICT_FULL:
+                valid = formatFull(task, n, task->first + n);
+                break;
+            case VERDICT_LINE:
+                valid = checkGrid(task, n);
+                outputString(task->out, valid ? "valid\n" : "INVALID\n");
+                break;
+            case VERDICT_BYTE:
+                valid = checkGrid(task, n);
+                outputBytes(task->out, valid ? "1" : "0", 1);
+                break;
+            default:
+                valid = checkGrid(task, n);
+                bits |= (unsigned char)(valid << (n % 8));
+                if (n % 8 == 7 || n + 1 == task->count) {
+                    outputBytes(task->out, &bits, 1);
+                    bits = 0;
+                }
+                break;
+        }
+        task->valid += valid;
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: sameRun
+ * -----------------
+ * Returns: true if a checkpoint was written for the same corpus file and output options as another.
+ */
+
+static bool sameRun(const batchCheckpoint *a, const batchCheckpoint *b) {
+    return a->corpusSize == b->corpusSize && a->corpusModified == b->corpusModified && a->mode == b->mode &&
+           a->puzzle == b->puzzle && a->variant == b->variant && a->boxRows == b->boxRows &&
+           a->boxCols == b->boxCols;
+}
+
+
+/*
+ * Function: resumeCorpus
+ * ----------------------
+ * Moves a freshly opened corpus past the grids a checkpoint counts as done. The recorded offset is used
+ * when there is one; otherwise (compressed corpora, or a stop inside a one-line grid) the finished
+ * grids are parsed and dropped without being validated.
+ *
+ * stream, file: The corpus, read as a stream or, for other shapes, as text.
+ * shape: The grid shape.
+ * grids: Scratch room for roundGrids grids.
+ * roundGrids: Grids to parse per step when skipping.
+ * progress: The checkpoint.
+ *
+ * Returns: true on success, false if the corpus ends before the checkpoint's grid count.
+ */
+
+static bool resumeCorpus(corpusStream *stream, FILE *file, const gridShape *shape, gridCell *grids,
+                         size_t roundGrids, const batchCheckpoint *progress) {
+    if (progress->input >= 0 &&
+        (stream ? corpusSeek(stream, progress->input) : fseeko(file, (off_t)progress->input, SEEK_SET) == 0)) {
+        return true;
+    }
+
+    size_t cellsPerGrid = (size_t)shape->order * (size_t)shape->order;
+    for (uint64_t skipped = 0; skipped < progress->grids;) {
+        size_t want = progress->grids - skipped < roundGrids ? (size_t)(progress->grids - skipped) : roundGrids;
+        size_t got;
+        if (stream) {
+            got = corpusNext(stream, (gridCell (*)[SIZE][SIZE])grids, want);
+        } else {
+            for (got = 0; got < want && readGridText(file, shape->order, grids + got * cellsPerGrid); got++) {
+            }
+        }
+        if (got == 0) {
+            return false;
+        }
+        skipped += got;
+    }
+    return true;
+}
+
+
+/*
+ * Function: saveProgress
+ * ----------------------
+ * Syncs the verdicts written so far and then records them in a checkpoint, in that order, so the
+ * checkpoint never counts output that a crash could still lose.
+ *
+ * Returns: true on success, false with errno set otherwise.
+ */
+
+static bool saveProgress(const char *path, batchCheckpoint *progress, int outFd, corpusStream *stream, FILE *file) {
+    off_t written = lseek(outFd, 0, SEEK_CUR);
+
+    if (written < 0 || fsync(outFd) != 0) {
+        return false;
+    }
+    progress->output = (uint64_t)written;
+    progress->input = stream ? corpusOffset(stream) : (int64_t)ftello(file);
+    return checkpointSave(path, progress);
+}
+
+
+/*
+ * Function: isOneLineGrid
+ * -----------------------
+ * Returns: true if a text line, without its line ending, is a single grid of SIZE*SIZE digits or '.'.
+ */
+
+static bool isOneLineGrid(const unsigned char *line, size_t length) {
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t')) {
+        length--;
+    }
+    if (length != SIZE * SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if ((line[i] < '0' || line[i] > '9') && line[i] != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: nextLineStart
+ * -----------------------
+ * Finds the first line that starts at or after an offset.
+ *
+ * fd: The corpus file.
+ * offset: Where to start looking.
+ * size: Size of the file.
+ *
+ * Returns: The offset of that line, or size if there is none.
+ */
+
+static int64_t nextLineStart(int fd, int64_t offset, int64_t size) {
+    unsigned char block[4096];
+
+    if (offset == 0) {
+        return 0;
+    }
+    // The line starts right at the offset if the byte before it ends a line
+    for (int64_t at = offset - 1; at < size;) {
+        ssize_t n = pread(fd, block, sizeof(block), (off_t)at);
+        if (n <= 0) {
+            break;
+        }
+        unsigned char *newline = memchr(block, '\n', (size_t)n);
+        if (newline) {
+            return at + (newline - block) + 1;
+        }
+        at += n;
+    }
+    return size;
+}
+
+
+/*
+ * Function: planShards
+ * --------------------
+ * Splits a corpus into byte ranges, one per process, that start and end on grid boundaries. A binary
+ * corpus is split by grid count. A text corpus must hold one grid per line and is split at the line
+ * starts nearest to equal byte shares. Each shard's bitmap gets room for as many grids as its range
+ * could hold, rounded up to a cache line so shards never share one.
+ *
+ * path: The corpus file.
+ * shards: Receives the ranges and bitmap layout of count shards.
+ * count: Number of shards.
+ *
+ * Returns: The bytes needed for the shard table and bitmaps, or 0 after printing why the corpus cannot
+ *          be split.
+ */
+
+static size_t planShards(const char *path, shardResult *shards, unsigned count) {
+    unsigned char head[4096];
+    struct stat info;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        perror("Error opening corpus");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    int64_t size = (int64_t)info.st_size;
+    ssize_t got = pread(fd, head, sizeof(head), 0);
+    got = got < 0 ? 0 : got;
+
+    bool binary = got >= CORPUS_HEADER_SIZE && memcmp(head, CORPUS_MAGIC, 4) == 0;
+    bool compressed = got >= 2 && ((head[0] == 0x1f && head[1] == 0x8b) ||
+                                   (got >= 4 && head[0] == 0x28 && head[1] == 0xb5 && head[2] == 0x2f && head[3] == 0xfd));
+    unsigned char *newline = memchr(head, '\n', (size_t)got);
+    size_t firstLine = newline ? (size_t)(newline - head) : (size_t)got;
+    if (compressed || (!binary && got > 0 && !isOneLineGrid(head, firstLine))) {
+        fprintf(stderr, "%s: --processes needs an uncompressed binary corpus or a text corpus with one grid per line\n",
+                path);
+        close(fd);
+        return 0;
+    }
+
+    size_t offset = (count * sizeof(shardResult) + 63) & ~(size_t)63;
+    int64_t grids = binary ? (size - CORPUS_HEADER_SIZE) / (SIZE * SIZE) : 0;
+    for (unsigned i = 0; i < count; i++) {
+        shardResult *shard = &shards[i];
+        memset(shard, 0, sizeof(*shard));
+        if (binary) {
+            shard->start = CORPUS_HEADER_SIZE + grids * i / count * (SIZE * SIZE);
+            shard->end = i + 1 == count ? size : CORPUS_HEADER_SIZE + grids * (i + 1) / count * (SIZE * SIZE);
+        } else {
+            shard->start = i == 0 ? 0 : shards[i - 1].end;
+            shard->end = i + 1 == count ? size : nextLineStart(fd, size / count * (i + 1), size);
+            shard->end = shard->end < shard->start ? shard->start : shard->end;
+        }
+        // Every grid takes at least SIZE*SIZE bytes in either layout
+        size_t capacity = (size_t)((shard->end - shard->start) / (SIZE * SIZE)) + 1;
+        shard->bitmapOffset = offset;
+        shard->bitmapBytes = ((capacity + 7) / 8 + 63) & ~(size_t)63;
+        offset += shard->bitmapBytes;
+    }
+    close(fd);
+    return offset;
+}
+
+
+/*
+ * Function: runShard
+ * ------------------
+ * Body of one shard process: validates the grids of its byte range on a pool of its own and records
+ * one bit per grid in its bitmap, through the same chunked workers as an in-process run.
+ *
+ * corpusFile: The corpus.
+ * shard: The shard's range and result slot.
+ * bitmap: The shard's bitmap in the shared mapping.
+ * settings: Template task carrying the variant, puzzle mode, and check.
+ * threads: Workers in this process.
+ * placement: CPU placement for the workers.
+ *
+ * Returns: 0 on success, or an errno value.
+ */
+
+static int runShard(const char *corpusFile, shardResult *shard, unsigned char *bitmap, const batchTask *settings,
+                    unsigned threads, const cpuPlacement *placement) {
+    corpusStream *stream = corpusOpen(corpusFile);
+    if (!stream) {
+        return errno ? errno : EIO;
+    }
+    if (!corpusRange(stream, shard->start, shard->end)) {
+        int error = errno ? errno : EIO;
+        corpusClose(stream);
+        return error;
+    }
+
+    size_t roundGrids = (size_t)threads * BATCH_CHUNK_GRIDS;
+    workPool *pool = poolCreate(threads, placement);
+    arena storage;
+    arenaInit(&storage, roundGrids * SIZE * SIZE + threads * (sizeof(batchTask) + sizeof(outputBuffer) + 128) + 256);
+    batchTask *tasks = arenaAlloc(&storage, threads * sizeof(*tasks));
+    outputBuffer *buffers = arenaAlloc(&storage, threads * sizeof(*buffers));
+    gridCell (*grids)[SIZE][SIZE] = arenaAlloc(&storage, roundGrids * SIZE * SIZE);
+    int error = pool && tasks && buffers && grids ? 0 : ENOMEM;
+
+    while (!error) {
+        size_t loaded = corpusNext(stream, grids, roundGrids);
+        if (loaded == 0) {
+            error = corpusError(stream);
+            break;
+        }
+        if ((shard->grids + loaded + 7) / 8 > shard->bitmapBytes) {
+            error = EOVERFLOW; // More grids than the range could hold: not one grid per line after all
+            break;
+        }
+
+        // Rounds are whole multiples of 8 grids until the last, so every chunk starts on a bitmap byte
+        unsigned started = 0;
+        for (size_t next = 0; next < loaded; started++) {
+            batchTask *task = &tasks[started];
+            *task = *settings;
+            task->grids = (const gridCell (*)[SIZE][SIZE])grids + next;
+            task->first = shard->grids + next;
+            task->count = loaded - next < BATCH_CHUNK_GRIDS ? loaded - next : BATCH_CHUNK_GRIDS;
+            task->mode = VERDICT_BITMAP;
+            task->out = &buffers[started];
+            outputAttach(task->out, -1, (char *)bitmap + task->first / 8, (task->count + 7) / 8);
+            next += task->count;
+            poolSubmit(pool, batchWorker, task);
+        }
+        poolWait(pool);
+        for (unsigned t = 0; t < started; t++) {
+            shard->valid += tasks[t].valid;
+        }
+        shard->grids += loaded;
+    }
+
+    if (pool) {
+        poolDestroy(pool);
+    }
+    shard->footprint = storage.footprint;
+    shard->hugePages = storage.hugePages;
+    arenaFree(&storage);
+    corpusClose(stream);
+    return error;
+}
+
+
+/*
+ * Function: writeMerged
+ * ---------------------
+ * Writes the verdicts of all shards, in corpus order, in one of the compact output modes.
+ *
+ * Returns: true on success, false if the output could not be written.
+ */
+
+static bool writeMerged(int fd, verdictMode mode, const shardResult *shards, unsigned count,
+                        const unsigned char *mapping) {
+    outputBuffer out;
+    unsigned char bits = 0;
+    uint64_t position = 0;
+
+    if (!outputInit(&out, fd, 1 << 16)) {
+        return false;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        const unsigned char *bitmap = mapping + shards[i].bitmapOffset;
+        for (uint64_t n = 0; n < shards[i].grids; n++, position++) {
+            bool valid = bitmap[n / 8] >> (n % 8) & 1;
+            if (mode == VERDICT_LINE) {
+                outputString(&out, valid ? "valid\n" : "INVALID\n");
+            } else if (mode == VERDICT_BYTE) {
+                outputBytes(&out, valid ? "1" : "0", 1);
+            } else {
+                // Shards hold any number of grids, so their bits are repacked onto one running bitmap
+                bits |= (unsigned char)(valid << (position % 8));
+                if (position % 8 == 7) {
+                    outputBytes(&out, &bits, 1);
+                    bits = 0;
+                }
+            }
+        }
+    }
+    if (mode == VERDICT_BITMAP && position % 8 != 0) {
+        outputBytes(&out, &bits, 1);
+    }
+    bool ok = outputFlush(&out) && !out.failed;
+    outputFree(&out);
+    return ok;
+}
+
+
+/*
+ * Function: runSharded
+ * --------------------
+ * Validates a corpus in several forked processes instead of threads of one. Each process takes a
+ * byte range of the corpus and runs its own pool, allocator, and reader, so nothing is shared between
+ * them but a mapping that holds every shard's counts and verdict bitmap. The parent waits for all of
+ * them, then merges the bitmaps in corpus order.
+ *
+ * corpusFile: The corpus.
+ * processes: Number of shard processes.
+ * threads: Workers per process.
+ * placement: CPU placement for the workers of all processes; with --cpus, shard i pins its workers from
+ *            the (i * threads)-th CPU of the list on.
+ * settings: Template task carrying the variant, puzzle mode, and check.
+ * mode: Output mode; full reports are not supported.
+ * outFd: Where to write the verdicts.
+ * count, valid: Receive the totals.
+ * memory: Receives the arena footprint of all shards together, and whether all got explicit huge pages.
+ *
+ * Returns: true on success, false if the corpus cannot be split, a shard failed, or writing failed.
+ */
+
+static bool runSharded(const char *corpusFile, unsigned processes, unsigned threads, const cpuPlacement *placement,
+                       const batchTask *settings, verdictMode mode, int outFd, size_t *count, size_t *valid,
+                       arena *memory) {
+    shardResult *plan = calloc(processes, sizeof(*plan));
+    size_t bytes = plan ? planShards(corpusFile, plan, processes) : 0;
+    if (!plan) {
+        perror("Error allocating shards");
+    }
+    if (bytes == 0) {
+        free(plan);
+        return false;
+    }
+
+    unsigned char *mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        perror("Error mapping shard results");
+        free(plan);
+        return false;
+    }
+    shardResult *shards = (shardResult *)mapping;
+    memcpy(shards, plan, processes * sizeof(*plan));
+    free(plan);
+
+    // Nothing in this process has started a thread yet, so forking is safe
+    pid_t *children = calloc(processes, sizeof(*children));
+    bool ok = children != NULL;
+    for (unsigned i = 0; ok && i < processes; i++) {
+        children[i] = fork();
+        if (children[i] == 0) {
+            // With --cpus, each shard's workers start where the previous shard's left off in the list
+            cpuPlacement shardPlacement = *placement;
+            shardPlacement.firstWorker = i * threads;
+            shards[i].error = runShard(corpusFile, &shards[i], mapping + shards[i].bitmapOffset, settings, threads,
+                                       &shardPlacement);
+            shards[i].done = true;
+            _exit(shards[i].error ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+        if (children[i] < 0) {
+            perror("Error starting shard process");
+            ok = false;
+        }
+    }
+
+    for (unsigned i = 0; children && i < processes && children[i] > 0; i++) {
+        int status;
+        while (waitpid(children[i], &status, 0) < 0 && errno == EINTR) {
+        }
+        if (!shards[i].done || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            if (shards[i].error) {
+                fprintf(stderr, "%s: shard %u (bytes %lld-%lld): %s\n", corpusFile, i + 1, (long long)shards[i].start,
+                        (long long)shards[i].end,
+                        shards[i].error == EOVERFLOW || shards[i].error == EINVAL ? "not one grid per line"
+                                                                                    : strerror(shards[i].error));
+            } else {
+                fprintf(stderr, "%s: shard %u (bytes %lld-%lld) did not finish\n", corpusFile, i + 1,
+                        (long long)shards[i].start, (long long)shards[i].end);
+            }
+            ok = false;
+        }
+    }
+    free(children);
+
+    *count = *valid = 0;
+    memory->footprint = 0;
+    memory->hugePages = true;
+    for (unsigned i = 0; ok && i < processes; i++) {
+        *count += shards[i].grids;
+        *valid += shards[i].valid;
+        memory->footprint += shards[i].footprint;
+        memory->hugePages = memory->hugePages && shards[i].hugePages;
+    }
+    if (ok && !writeMerged(outFd, mode, shards, processes, mapping)) {
+        perror("Error writing verdicts");
+        ok = false;
+    }
+    munmap(mapping, bytes);
+    return ok;
+}
+
+
+/*
+ * Function: printSummary
+ * ----------------------
+ * Prints the count of valid and invalid grids (or consistent and inconsistent puzzles) to stderr,
+ * followed by the memory the batch buffers took and whether it is backed by explicit huge pages.
+ *
+ * memory: The batch arena, read before it was freed; for a multi-process run, the totals of all shards.
+ */
+
+static void printSummary(const char *corpusFile, bool puzzle, size_t count, size_t valid, const arena *memory) {
+    if (puzzle) {
+        fprintf(stderr, "%s: %zu puzzles, %zu consistent, %zu INCONSISTENT\n", corpusFile, count, valid, count - valid);
+    } else {
+        fprintf(stderr, "%s: %zu grids, %zu valid, %zu INVALID\n", corpusFile, count, valid, count - valid);
+    }
+    fprintf(stderr, "%s: %zu KiB of batch buffers, on %s\n", corpusFile, (memory->footprint + 1023) / 1024,
+            memory->hugePages ? "explicit huge pages" : "ordinary pages (transparent huge pages requested)");
+}
+
+
+/*
+ * Function: batchUsage
+ * --------------------
+ * Prints the options accepted by the batch subcommand.
+ */
+
+static void batchUsage(void) {
+    fprintf(stderr,
+            "Usage: batch [--output full|verdict|byte|bitmap] [--threads T] [--puzzle]\n"
+            "             [--variant standard|x|windoku|jigsaw] [--regions FILE] [--box RxC]\n"
+            "             [--cpus LIST | --cpuset LIST] [--io-cpus LIST] [-o FILE]\n"
+            "             [--checkpoint FILE [--checkpoint-interval S] [--resume]] [--processes N]\n"
+            "             <corpus_file>\n"
+            "  --output MODE  full: unit lines and summary per grid; verdict: one line per grid;\n"
+            "                 byte: '1'/'0' per grid; bitmap: one bit per grid, LSB first (default verdict)\n"
+            "  --threads T    Worker threads (default: one per usable CPU, within any cgroup CPU quota)\n"
+            "  --puzzle       Check unsolved puzzles: 0 or '.' is an empty cell, only the givens must not conflict\n"
+            "  --variant V    Extra rules: x adds both diagonals, windoku four extra 3x3 windows,\n"
+            "                 jigsaw replaces the subgrids with the regions of --regions (default standard)\n"
+            "  --regions FILE Jigsaw region map: the region (1-9) of every cell, laid out like a grid\n"
+            "  --box RxC      Box rows x columns: 3x3 for 9x9 (default), 2x3 for 6x6, 3x4 for 12x12;\n"
+            "                 a single number B means BxB. Grids other than 9x9 are read as text\n"
+            "  --cpus LIST    Pin worker i to the i-th CPU of LIST, e.g. 0-3,8 (cycling when T is larger)\n"
+            "  --cpuset LIST  Let the workers share the CPUs of LIST\n"
+            "  --io-cpus LIST Run the thread that reads the corpus and writes verdicts on LIST\n"
+            "  -o FILE        Write verdicts to FILE instead of stdout\n"
+            "  --checkpoint FILE  Record progress in FILE every S seconds (needs -o); removed on success\n"
+            "  --checkpoint-interval S  Seconds between checkpoints (default %d; 0 checkpoints every round)\n"
+            "  --resume       Continue from the checkpoint in FILE, if there is one, appending to -o\n"
+            "  --processes N  Split the corpus into N byte ranges checked by N forked processes, each with\n"
+            "                 T threads (default: the usable CPUs shared out); binary or one-grid-per-line\n"
+            "                 text corpora, not compressed, and not with full, --box, or --checkpoint\n",
+            BATCH_CHECKPOINT_SECONDS);
+}
+
+
+/*
+ * Function: batchMain
+ * -------------------
+ * Entry point of the batch subcommand. Validates every grid of a corpus file (plain, binary, or
+ * compressed) and writes the verdicts to stdout in the chosen mode. With --puzzle the grids are unsolved
+ * puzzles and only their givens are checked; with --variant the grids follow X, windoku, or jigsaw rules.
+ * With --box the grids have another shape, such as 6x6 with 2x3 boxes, and are read as text. A count of valid and invalid grids is printed to stderr.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on bad options, an unreadable corpus, or a write error.
+ */
+
+int batchMain(int argc, char *argv[]) {
+    verdictMode mode = VERDICT_LINE;
+    unsigned threads = 0;
+    cpuPlacement placement = {0};
+    bool puzzle = false;
+    int variant = VARIANT_STANDARD;
+    const char *regionsFile = NULL;
+    const char *corpusFile = NULL;
+    const char *outputFile = NULL;
+    const char *checkpointFile = NULL;
+    unsigned long checkpointSeconds = BATCH_CHECKPOINT_SECONDS;
+    bool resume = false;
+    unsigned processes = 0;
+    gridShape shape = {BOX_ROWS, BOX_COLS, SIZE};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            int parsed = parseVerdictMode(argv[++i]);
+            if (parsed < 0) {
+                batchUsage();
+                return EXIT_FAILURE;
+            }
+            mode = (verdictMode)parsed;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (threads == 0) {
+                batchUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (isPlacementOption(argv[i]) && i + 1 < argc) {
+            if (!parsePlacementOption(&placement, argv[i], argv[i + 1])) {
+                fprintf(stderr, "%s: not a list of CPUs this process may use: %s\n", argv[i], argv[i + 1]);
+                return EXIT_FAILURE;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--puzzle") == 0) {
+            puzzle = true;
+        } else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+            variant = parseVariant(argv[++i]);
+            if (variant < 0) {
+                batchUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--regions") == 0 && i + 1 < argc) {
+            regionsFile = argv[++i];
+        } else if (strcmp(argv[i], "--box") == 0 && i + 1 < argc) {
+            if (!parseShape(argv[++i], &shape)) {
+                fprintf(stderr, "Box shape must be RxC or B, for grids up to %dx%d\n", MAX_ORDER, MAX_ORDER);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpointFile = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+            checkpointSeconds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+        } else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+            processes = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (processes == 0) {
+                batchUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (argv[i][0] != '-' && !corpusFile) {
+            corpusFile = argv[i];
+        } else {
+            batchUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    bool shaped = shape.boxRows != BOX_ROWS || shape.boxCols != BOX_COLS;
+    if (!corpusFile || (variant == VARIANT_JIGSAW) != (regionsFile != NULL) ||
+        (shaped && variant != VARIANT_STANDARD) || (resume && !checkpointFile)) {
+        batchUsage();
+        return EXIT_FAILURE;
+    }
+    if (processes && (mode == VERDICT_FULL || shaped || checkpointFile)) {
+        fprintf(stderr, "--processes cannot be combined with --output full, --box, or --checkpoint\n");
+        return EXIT_FAILURE;
+    }
+    if (checkpointFile && !outputFile) {
+        fprintf(stderr, "--checkpoint needs -o FILE, so a resumed run can cut the output back to the checkpoint\n");
+        return EXIT_FAILURE;
+    }
+
+    static unitTable units;
+    gridCell regions[SIZE][SIZE];
+    if (regionsFile && !loadRegions(regionsFile, regions)) {
+        fprintf(stderr, "%s: %s\n", regionsFile, errno == EINVAL ? "expected 81 region numbers" : strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (!unitTableBuild(&units, (variantKind)variant, regions)) {
+        fprintf(stderr, "%s: each region 1..%d must cover exactly %d cells\n", regionsFile, SIZE, SIZE);
+        return EXIT_FAILURE;
+    }
+    bool (*check)(const gridCell[SIZE][SIZE]) = puzzle ? (variant == VARIANT_STANDARD ? validatePuzzle : NULL)
+                                                  : units.kernel;
+    bool (*shapeCheck)(const gridCell *) = shapeKernel(&shape, puzzle);
+    if (threads == 0) {
+        threads = defaultThreads(&placement) / (processes ? processes : 1);
+        threads = threads ? threads : 1;
+    }
+
+    // A checkpoint identifies the corpus by size and modification time, and the options that shape the output
+    batchCheckpoint progress = {0};
+    bool resuming = false;
+    if (checkpointFile) {
+        struct stat corpusInfo;
+        if (stat(corpusFile, &corpusInfo) != 0) {
+            perror("Error opening corpus");
+            return EXIT_FAILURE;
+        }
+        progress = (batchCheckpoint){(uint64_t)corpusInfo.st_size, (int64_t)corpusInfo.st_mtime, (int)mode, puzzle,
+                                     variant, shape.boxRows, shape.boxCols, 0, 0, 0, 0};
+    }
+    if (resume) {
+        batchCheckpoint saved;
+        if (checkpointLoad(checkpointFile, &saved)) {
+            if (!sameRun(&saved, &progress)) {
+                fprintf(stderr, "%s: written for another corpus file or other output options\n", checkpointFile);
+                return EXIT_FAILURE;
+            }
+            progress = saved;
+            resuming = true;
+        } else if (errno != ENOENT) {
+            fprintf(stderr, "%s: %s\n", checkpointFile, errno == EINVAL ? "not a batch checkpoint" : strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A resumed run cuts the output back to what the checkpoint counts and appends from there
+    int outFd = STDOUT_FILENO;
+    if (outputFile) {
+        struct stat outputInfo;
+        outFd = open(outputFile, O_WRONLY | O_CREAT | O_CLOEXEC | (resuming ? 0 : O_TRUNC), 0644);
+        if (outFd < 0) {
+            perror(outputFile);
+            return EXIT_FAILURE;
+        }
+        if (resuming && (fstat(outFd, &outputInfo) != 0 || (uint64_t)outputInfo.st_size < progress.output)) {
+            fprintf(stderr, "%s: shorter than the %llu bytes the checkpoint records\n", outputFile,
+                    (unsigned long long)progress.output);
+            close(outFd);
+            return EXIT_FAILURE;
+        }
+        if (resuming && (ftruncate(outFd, (off_t)progress.output) != 0 ||
+                         lseek(outFd, (off_t)progress.output, SEEK_SET) < 0)) {
+            perror(outputFile);
+            close(outFd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (processes) {
+        batchTask settings = {.puzzle = puzzle, .units = &units, .check = check, .source = corpusFile};
+        size_t count, valid;
+        arena memory;
+        bool ok = runSharded(corpusFile, processes, threads, &placement, &settings, mode, outFd, &count, &valid,
+                             &memory);
+        if (outputFile && close(outFd) != 0 && ok) {
+            perror("Error writing verdicts");
+            ok = false;
+        }
+        if (ok) {
+            printSummary(corpusFile, puzzle, count, valid, &memory);
+        }
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // The workers are started before this thread moves to the I/O CPUs, so they do not inherit them
+    workPool *pool = poolCreate(threads, &placement);
+    if (!placeIoThread(&placement)) {
+        perror("Error placing the I/O thread");
+    }
+
+    // Grids of other shapes have no binary corpus layout, so they are read as text
+    corpusStream *stream = NULL;
+    FILE *file = NULL;
+    if (shaped) {
+        file = fopen(corpusFile, "r");
+    } else {
+        stream = corpusOpen(corpusFile);
+    }
+    if (!stream && !file) {
+        perror("Error opening corpus");
+        poolDestroy(pool);
+        if (outputFile) {
+            close(outFd);
+        }
+        return EXIT_FAILURE;
+    }
+
+    size_t cellsPerGrid = (size_t)shape.order * (size_t)shape.order;
+    size_t gridBytes = mode == VERDICT_FULL ? BATCH_FULL_GRID_BYTES(shaped ? 3 * shape.order : units.count) +
+                                                  strlen(corpusFile)
+                       : mode == VERDICT_LINE ? sizeof("INVALID\n")
+                                              : 1;
+    size_t gridsBytes = (size_t)threads * BATCH_CHUNK_GRIDS * cellsPerGrid;
+    size_t verdictBytes = BATCH_CHUNK_GRIDS * gridBytes;
+
+    // Grids, tasks, and verdict buffers share one slab sized here, plus a cache line of padding per
+    // allocation, so the footprint is fixed before the first grid is read and rounds never allocate
+    arena storage;
+    arenaInit(&storage, gridsBytes + threads * (sizeof(batchTask) + sizeof(outputBuffer) + verdictBytes + 64) + 256);
+    batchTask *tasks = arenaAlloc(&storage, threads * sizeof(*tasks));
+    outputBuffer *buffers = arenaAlloc(&storage, threads * sizeof(*buffers));
+    gridCell *grids = arenaAlloc(&storage, gridsBytes);
+    bool ok = pool && tasks && buffers && grids;
+    for (unsigned t = 0; ok && t < threads; t++) {
+        char *data = arenaAlloc(&storage, verdictBytes);
+        memset(&tasks[t], 0, sizeof(tasks[t]));
+        tasks[t].out = &buffers[t];
+        outputAttach(&buffers[t], outFd, data, verdictBytes);
+        ok = data != NULL;
+    }
+    if (!ok) {
+        perror("Error allocating batch buffers");
+    }
+
+    size_t count = (size_t)progress.grids, valid = (size_t)progress.valid, loaded;
+    size_t roundGrids = (size_t)threads * BATCH_CHUNK_GRIDS;
+    if (ok && resuming && !resumeCorpus(stream, file, &shape, grids, roundGrids, &progress)) {
+        fprintf(stderr, "%s: ends before the %zu grids the checkpoint records\n", corpusFile, count);
+        ok = false;
+    }
+    uint64_t lastCheckpoint = nowNanos();
+    for (;;) {
+        if (!ok) {
+            break;
+        }
+        if (stream) {
+            loaded = corpusNext(stream, (gridCell (*)[SIZE][SIZE])grids, roundGrids);
+        } else {
+            for (loaded = 0; loaded < roundGrids && readGridText(file, shape.order, grids + loaded * cellsPerGrid);
+                 loaded++) {
+            }
+        }
+        if (loaded == 0) {
+            break;
+        }
+
+        unsigned started = 0;
+        for (size_t next = 0; next < loaded; started++) {
+            batchTask *task = &tasks[started];
+            if (shaped) {
+                task->cells = grids + next * cellsPerGrid;
+                task->shape = &shape;
+            } else {
+                task->grids = (const gridCell (*)[SIZE][SIZE])grids + next;
+            }
+            task->shapeCheck = shapeCheck;
+            task->first = count + next;
+            task->count = loaded - next < BATCH_CHUNK_GRIDS ? loaded - next : BATCH_CHUNK_GRIDS;
+            task->mode = mode;
+            task->puzzle = puzzle;
+            task->units = &units;
+            task->check = check;
+            task->source = corpusFile;
+            next += task->count;
+            poolSubmit(pool, batchWorker, task);
+        }
+        count += loaded;
+        poolWait(pool);
+        for (unsigned t = 0; t < started; t++) {
+            valid += tasks[t].valid;
+        }
+        if (!outputFlushAll(buffers, started)) {
+            perror("Error writing verdicts");
+            ok = false;
+        }
+
+        if (ok && checkpointFile && nowNanos() - lastCheckpoint >= checkpointSeconds * 1000000000ull) {
+            progress.grids = count;
+            progress.valid = valid;
+            if (!saveProgress(checkpointFile, &progress, outFd, stream, file)) {
+                perror("Error writing checkpoint");
+                ok = false;
+            }
+            lastCheckpoint = nowNanos();
+        }
+    }
+
+    poolDestroy(pool);
+    arena memory = storage;
+    arenaFree(&storage);
+
+    if (stream) {
+        if (ok && corpusError(stream)) {
+            errno = corpusError(stream);
+            perror("Error reading corpus");
+            ok = false;
+        }
+        corpusClose(stream);
+    } else {
+        if (ok && ferror(file)) {
+            perror("Error reading corpus");
+            ok = false;
+        }
+        fclose(file);
+    }
+    if (outputFile && close(outFd) != 0 && ok) {
+        perror("Error writing verdicts");
+        ok = false;
+    }
+    // The run is complete, so there is nothing left to resume
+    if (ok && checkpointFile && unlink(checkpointFile) != 0 && errno != ENOENT) {
+        perror("Error removing checkpoint");
+    }
+
+    if (ok) {
+        printSummary(corpusFile, puzzle, count, valid, &memory);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,424 @@
+/*
+ * File: Sudoku-Bench.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Benchmark harness for the validation engines. Runs every engine over the same
+ *              corpus and reports throughput, per-grid latency percentiles, and cycles per grid
+ *              as CSV or JSON so results can be compared across releases.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+// Number of grids generated when no corpus file is given.
+#define BENCH_DEFAULT_GRIDS 10000
+
+// Defect the generated corpus carries, named as gen's --invalid takes it, and the share of grids with one.
+#define BENCH_DEFECT INVALID_MIXED
+#define BENCH_DEFECT_NAME "mixed"
+#define BENCH_DEFECT_PERCENT 25
+
+// Grids validated per timed call when measuring the batch engine's latency.
+#define BENCH_BATCH_CHUNK 64
+
+// Names accepted by --engines, in the order they are reported. The validation engines come first and
+// run by default; the solvers (a grid counts as valid when it has a solution) run only when named.
+static const char *engineNames[] = {"threaded", "serial", "bitmask", "batch", "puzzle", "bitboard", "dlx"};
+#define NUM_ENGINES (sizeof(engineNames) / sizeof(engineNames[0]))
+#define NUM_VALIDATION_ENGINES 5
+#define ENGINE_BATCH 3
+#define ENGINE_PUZZLE 4
+#define ENGINE_DLX 6
+
+// Struct to hold the measurements taken for one engine.
+typedef struct {
+    const char *engine;
+    size_t grids;
+    size_t valid;
+    double seconds;
+    double gridsPerSec;
+    double nsPerGrid;
+    uint64_t p50;
+    uint64_t p99;
+    double cyclesPerGrid;
+} benchReport;
+
+// Struct describing the corpus a run measured, so reports from different runs can be matched up.
+typedef struct {
+    const char *source;      // Corpus file, or NULL for a generated corpus
+    size_t count;            // Grids in the corpus
+    uint64_t seed;           // Generator settings; only meaningful when source is NULL
+    const char *invalid;
+    unsigned invalidPercent;
+} benchCorpus;
+
+
+/*
+ * Function: generateCorpus
+ * ------------------------
+ * Builds a reproducible corpus with the corpus generator. BENCH_DEFECT_PERCENT of the grids carry a
+ * defect of a randomly chosen kind, keeping a mix of valid and invalid input.
+ *
+ * grids: Output array with room for count grids.
+ * count: Number of grids to generate.
+ * seed: Stream seed.
+ *
+ * Returns: void.
+ */
+
+static void generateCorpus(gridCell (*grids)[SIZE][SIZE], size_t count, uint64_t seed) {
+    for (size_t n = 0; n < count; n++) {
+        generateGrid(grids[n], seed, n, BENCH_DEFECT, BENCH_DEFECT_PERCENT);
+    }
+}
+
+
+/*
+ * Function: compareU64
+ * --------------------
+ * qsort comparator for uint64_t values.
+ */
+
+static int compareU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+/*
+ * Function: checkGrid
+ * -------------------
+ * Runs one of the engines that take a single grid per call.
+ *
+ * engine: Index into engineNames (not batch or puzzle).
+ * grid: The grid to check.
+ * dlx: A 9x9 DLX solver, used by the dlx engine.
+ *
+ * Returns: The engine's verdict.
+ */
+
+static bool checkGrid(size_t engine, const gridCell grid[SIZE][SIZE], dlxSolver *dlx) {
+    switch (engine) {
+        case 0: return validateThreaded(grid);
+        case 1: return validateSerial(grid);
+        case 2: return validateBitmask(grid);
+        case ENGINE_DLX: return dlxSolve(dlx, &grid[0][0], NULL, 1) > 0;
+        default: return solveGrid(grid, NULL, 1) > 0;
+    }
+}
+
+
+/*
+ * Function: runEngine
+ * -------------------
+ * Measures one engine over the corpus. A first untimed-per-call pass gives throughput and cycles per
+ * grid; a second pass times every call individually to build the latency distribution. The batch and
+ * puzzle engines are timed in chunks of BENCH_BATCH_CHUNK grids and their latency is the amortised cost
+ * per grid. The puzzle engine counts grids whose givens are consistent, treating 0 as an empty cell.
+ *
+ * engine: Index into engineNames.
+ * grids: Corpus to validate.
+ * count: Number of grids in the corpus.
+ * verdicts: Scratch array with one entry per grid.
+ * samples: Scratch array with one entry per grid, used for latency samples.
+ * dlx: A 9x9 DLX solver, used by the dlx engine.
+ *
+ * Returns: The filled in report.
+ */
+
+static benchReport runEngine(size_t engine, const gridCell (*grids)[SIZE][SIZE], size_t count,
+                             unsigned char *verdicts, uint64_t *samples, dlxSolver *dlx) {
+    benchReport report = {.engine = engineNames[engine], .grids = count};
+    size_t numSamples = 0;
+
+    uint64_t startNs = nowNanos();
+    uint64_t startCycles = readCycles();
+    switch (engine) {
+        case ENGINE_BATCH:
+            validateBatch(grids, count, verdicts);
+            break;
+        case ENGINE_PUZZLE:
+            validatePuzzleBatch(grids, count, verdicts);
+            break;
+        default:
+            for (size_t i = 0; i < count; i++) {
+                verdicts[i] = checkGrid(engine, grids[i], dlx);
+            }
+            break;
+    }
+    uint64_t cycles = readCycles() - startCycles;
+    uint64_t elapsed = nowNanos() - startNs;
+
+    for (size_t i = 0; i < count; i++) {
+        report.valid += verdicts[i];
+    }
+
+    // Second pass: per-call latency
+    if (engine == ENGINE_BATCH || engine == ENGINE_PUZZLE) {
+        for (size_t i = 0; i < count; i += BENCH_BATCH_CHUNK) {
+            size_t chunk = count - i < BENCH_BATCH_CHUNK ? count - i : BENCH_BATCH_CHUNK;
+            uint64_t t0 = nowNanos();
+            if (engine == ENGINE_BATCH) {
+                validateBatch(grids + i, chunk, verdicts + i);
+            } else {
+                validatePuzzleBatch(grids + i, chunk, verdicts + i);
+            }
+            samples[numSamples++] = (nowNanos() - t0) / chunk;
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            uint64_t t0 = nowNanos();
+            verdicts[i] = checkGrid(engine, grids[i], dlx);
+            samples[numSamples++] = nowNanos() - t0;
+        }
+    }
+
+    qsort(samples, numSamples, sizeof(*samples), compareU64);
+    if (numSamples > 0) {
+        report.p50 = samples[(numSamples - 1) / 2];
+        report.p99 = samples[(numSamples - 1) * 99 / 100];
+    }
+
+    report.seconds = (double)elapsed / 1e9;
+    report.nsPerGrid = count ? (double)elapsed / (double)count : 0.0;
+    report.gridsPerSec = elapsed ? (double)count * 1e9 / (double)elapsed : 0.0;
+    report.cyclesPerGrid = count ? (double)cycles / (double)count : 0.0;
+    return report;
+}
+
+
+/*
+ * Function: printJsonString
+ * -------------------------
+ * Writes text to stdout as a quoted JSON string, escaping quotes, backslashes, and control characters.
+ */
+
+static void printJsonString(const char *text) {
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            printf("\\%c", *p);
+        } else if (*p < 0x20) {
+            printf("\\u%04x", *p);
+        } else {
+            putchar(*p);
+        }
+    }
+    putchar('"');
+}
+
+
+/*
+ * Function: printCsvField
+ * -----------------------
+ * Writes text to stdout as one CSV field, quoted (with quotes doubled) when it holds a comma, a quote,
+ * or a line break.
+ */
+
+static void printCsvField(const char *text) {
+    if (!strpbrk(text, ",\"\r\n")) {
+        fputs(text, stdout);
+        return;
+    }
+    putchar('"');
+    for (const char *p = text; *p; p++) {
+        if (*p == '"') {
+            putchar('"');
+        }
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+
+/*
+ * Function: printReports
+ * ----------------------
+ * Writes the collected reports to stdout as CSV (one header row, one row per engine) or as a JSON
+ * document with the corpus description and an array of engine objects. The corpus columns name the
+ * corpus file, or give the seed, grid count, and defect settings a generated corpus was built from;
+ * the generator settings are empty (null in JSON) for a corpus file.
+ *
+ * reports: The reports to print.
+ * numReports: Number of reports.
+ * json: true for JSON output, false for CSV.
+ * corpus: The corpus the engines ran on.
+ *
+ * Returns: void.
+ */
+
+static void printReports(const benchReport *reports, size_t numReports, bool json, const benchCorpus *corpus) {
+    const char *source = corpus->source ? corpus->source : "generated";
+
+    if (!json) {
+        printf("corpus,seed,count,invalid,invalid_percent,"
+               "engine,grids,valid,seconds,grids_per_sec,ns_per_grid,p50_ns,p99_ns,cycles_per_grid\n");
+        for (size_t i = 0; i < numReports; i++) {
+            const benchReport *r = &reports[i];
+            printCsvField(source);
+            if (corpus->source) {
+                printf(",,%zu,,", corpus->count);
+            } else {
+                printf(",%llu,%zu,%s,%u", (unsigned long long)corpus->seed, corpus->count, corpus->invalid,
+                       corpus->invalidPercent);
+            }
+            printf(",%s,%zu,%zu,%.6f,%.1f,%.1f,%llu,%llu,%.1f\n", r->engine, r->grids, r->valid, r->seconds,
+                   r->gridsPerSec, r->nsPerGrid, (unsigned long long)r->p50, (unsigned long long)r->p99,
+                   r->cyclesPerGrid);
+        }
+        return;
+    }
+
+    printf("{\n  \"corpus\": ");
+    printJsonString(source);
+    if (corpus->source) {
+        printf(",\n  \"seed\": null,\n  \"count\": %zu,\n  \"invalid\": null,\n  \"invalid_percent\": null",
+               corpus->count);
+    } else {
+        printf(",\n  \"seed\": %llu,\n  \"count\": %zu,\n  \"invalid\": \"%s\",\n  \"invalid_percent\": %u",
+               (unsigned long long)corpus->seed, corpus->count, corpus->invalid, corpus->invalidPercent);
+    }
+    printf(",\n  \"engines\": [\n");
+    for (size_t i = 0; i < numReports; i++) {
+        const benchReport *r = &reports[i];
+        printf("    {\"engine\": \"%s\", \"grids\": %zu, \"valid\": %zu, \"seconds\": %.6f, "
+               "\"grids_per_sec\": %.1f, \"ns_per_grid\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+               "\"cycles_per_grid\": %.1f}%s\n",
+               r->engine, r->grids, r->valid, r->seconds, r->gridsPerSec, r->nsPerGrid,
+               (unsigned long long)r->p50, (unsigned long long)r->p99, r->cyclesPerGrid,
+               i + 1 < numReports ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+
+/*
+ * Function: benchUsage
+ * --------------------
+ * Prints the options accepted by the bench subcommand.
+ */
+
+static void benchUsage(void) {
+    fprintf(stderr,
+            "Usage: bench [--grids N] [--seed S] [--engines LIST] [--format csv|json] [corpus_file]\n"
+            "  --grids N       Number of grids to generate when no corpus file is given (default %d)\n"
+            "  --seed S        Seed for the generated corpus (default 1)\n"
+            "  --engines LIST  Comma-separated subset of threaded,serial,bitmask,batch,puzzle (default all of\n"
+            "                  these), plus the solvers bitboard and dlx\n"
+            "  --format F      Report format, csv or json (default csv)\n",
+            BENCH_DEFAULT_GRIDS);
+}
+
+
+/*
+ * Function: benchMain
+ * -------------------
+ * Entry point of the bench subcommand. Loads or generates the corpus, runs the selected engines, and
+ * prints one report per engine.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on bad options or an unreadable corpus.
+ */
+
+int benchMain(int argc, char *argv[]) {
+    size_t count = BENCH_DEFAULT_GRIDS;
+    uint64_t seed = 1;
+    bool json = false;
+    bool selected[NUM_ENGINES];
+    const char *corpusFile = NULL;
+
+    for (size_t e = 0; e < NUM_ENGINES; e++) {
+        selected[e] = e < NUM_VALIDATION_ENGINES;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--grids") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *format = argv[++i];
+            if (strcmp(format, "json") == 0) {
+                json = true;
+            } else if (strcmp(format, "csv") != 0) {
+                benchUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--engines") == 0 && i + 1 < argc) {
+            char *list = argv[++i];
+            for (size_t e = 0; e < NUM_ENGINES; e++) {
+                selected[e] = false;
+            }
+            for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+                size_t e = 0;
+                while (e < NUM_ENGINES && strcmp(name, engineNames[e]) != 0) {
+                    e++;
+                }
+                if (e == NUM_ENGINES) {
+                    fprintf(stderr, "Unknown engine: %s\n", name);
+                    benchUsage();
+                    return EXIT_FAILURE;
+                }
+                selected[e] = true;
+            }
+        } else if (argv[i][0] != '-' && !corpusFile) {
+            corpusFile = argv[i];
+        } else {
+            benchUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    gridCell (*grids)[SIZE][SIZE];
+    if (corpusFile) {
+        grids = loadCorpus(corpusFile, &count);
+        if (!grids) {
+            perror("Error loading corpus");
+            return EXIT_FAILURE;
+        }
+    } else {
+        grids = malloc((count ? count : 1) * sizeof(*grids));
+        if (!grids) {
+            perror("Error allocating corpus");
+            return EXIT_FAILURE;
+        }
+        generateCorpus(grids, count, seed);
+    }
+
+    unsigned char *verdicts = malloc(count ? count : 1);
+    uint64_t *samples = malloc((count ? count : 1) * sizeof(*samples));
+    gridShape shape = {BOX_ROWS, BOX_COLS, SIZE};
+    dlxSolver *dlx = selected[ENGINE_DLX] ? dlxCreate(&shape) : NULL;
+    if (!verdicts || !samples || (selected[ENGINE_DLX] && !dlx)) {
+        perror("Error allocating benchmark buffers");
+        free(grids);
+        free(verdicts);
+        free(samples);
+        dlxDestroy(dlx);
+        return EXIT_FAILURE;
+    }
+
+    benchReport reports[NUM_ENGINES];
+    size_t numReports = 0;
+    for (size_t e = 0; e < NUM_ENGINES; e++) {
+        if (selected[e]) {
+            reports[numReports++] = runEngine(e, (const gridCell (*)[SIZE][SIZE])grids, count, verdicts, samples, dlx);
+        }
+    }
+
+    benchCorpus corpus = {corpusFile, count, seed, BENCH_DEFECT_NAME, BENCH_DEFECT_PERCENT};
+    printReports(reports, numReports, json, &corpus);
+
+    free(grids);
+    free(verdicts);
+    free(samples);
+    dlxDestroy(dlx);
+    return EXIT_SUCCESS;
+}
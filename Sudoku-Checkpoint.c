@@ -0,0 +1,134 @@
+/*
+ * File: Sudoku-Checkpoint.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Checkpoints for long batch runs. A checkpoint is a short text file recording how far a
+ *              run got: the grids done and their counts, where the next grid starts in the corpus, and
+ *              how many verdict bytes are safely on disk. It is replaced atomically, so a crash leaves
+ *              either the old checkpoint or the new one, never a torn one.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// First line of every checkpoint; the number is the format version.
+#define CHECKPOINT_MAGIC "sudoku-batch-checkpoint 1"
+
+
+/*
+ * Function: syncDirectory
+ * -----------------------
+ * Flushes a directory entry change, such as a rename, to disk.
+ *
+ * path: A file in the directory.
+ *
+ * Returns: true on success, false otherwise.
+ */
+
+static bool syncDirectory(const char *path) {
+    char copy[4096];
+
+    snprintf(copy, sizeof(copy), "%s", path);
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+
+/*
+ * Function: checkpointSave
+ * ------------------------
+ * Writes a checkpoint next to its final path, syncs it, and renames it into place. The caller must have
+ * synced the verdicts the checkpoint counts before calling this.
+ *
+ * path: Where the checkpoint lives.
+ * checkpoint: The progress to record.
+ *
+ * Returns: true on success, false with errno set otherwise (any previous checkpoint is left in place).
+ */
+
+bool checkpointSave(const char *path, const batchCheckpoint *checkpoint) {
+    char temporary[4096 + 8];
+
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE *file = fopen(temporary, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file,
+            CHECKPOINT_MAGIC "\n"
+            "corpus %" PRIu64 " %" PRId64 "\n"
+            "options %d %d %d %d %d\n"
+            "grids %" PRIu64 "\n"
+            "valid %" PRIu64 "\n"
+            "input %" PRId64 "\n"
+            "output %" PRIu64 "\n",
+            checkpoint->corpusSize, checkpoint->corpusModified, checkpoint->mode, checkpoint->puzzle,
+            checkpoint->variant, checkpoint->boxRows, checkpoint->boxCols, checkpoint->grids, checkpoint->valid,
+            checkpoint->input, checkpoint->output);
+
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    int error = errno;
+    if (fclose(file) != 0 && ok) {
+        ok = false;
+        error = errno;
+    }
+    if (ok && rename(temporary, path) != 0) {
+        ok = false;
+        error = errno;
+    }
+    if (!ok) {
+        unlink(temporary);
+        errno = error;
+        return false;
+    }
+    return syncDirectory(path);
+}
+
+
+/*
+ * Function: checkpointLoad
+ * ------------------------
+ * Reads a checkpoint written by checkpointSave.
+ *
+ * path: The checkpoint file.
+ * checkpoint: Receives the recorded progress.
+ *
+ * Returns: true on success, false with errno set otherwise: ENOENT if there is no checkpoint, EINVAL if
+ *          the file is not a checkpoint of this format.
+ */
+
+bool checkpointLoad(const char *path, batchCheckpoint *checkpoint) {
+    char magic[64];
+    FILE *file = fopen(path, "r");
+
+    if (!file) {
+        return false;
+    }
+    bool ok = fgets(magic, sizeof(magic), file) && strcmp(magic, CHECKPOINT_MAGIC "\n") == 0 &&
+              fscanf(file,
+                     " corpus %" SCNu64 " %" SCNd64 " options %d %d %d %d %d grids %" SCNu64 " valid %" SCNu64
+                     " input %" SCNd64 " output %" SCNu64,
+                     &checkpoint->corpusSize, &checkpoint->corpusModified, &checkpoint->mode, &checkpoint->puzzle,
+                     &checkpoint->variant, &checkpoint->boxRows, &checkpoint->boxCols, &checkpoint->grids,
+                     &checkpoint->valid, &checkpoint->input, &checkpoint->output) == 11 &&
+              checkpoint->valid <= checkpoint->grids;
+    fclose(file);
+    if (!ok) {
+        errno = EINVAL;
+    }
+    return ok;
+}
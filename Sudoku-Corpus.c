@@ -0,0 +1,686 @@
+/*
+ * File: Sudoku-Corpus.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Streaming corpus reader. Corpora may be plain or compressed with gzip or zstd; the
+ *              compression is detected from the magic bytes. Compressed input is inflated on its own
+ *              thread into a fixed-size ring that the parser drains, so decompression overlaps with
+ *              validation and memory stays bounded no matter how large the archive is.
+ *
+ *              gzip support needs -DHAVE_ZLIB -lz and zstd support needs -DHAVE_ZSTD -lzstd.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Sudoku-Validator.h"
+
+// Decompressed bytes buffered between the decompressor thread and the parser.
+#define CORPUS_RING_BYTES (1024 * 1024)
+
+// Bytes handed to the parser per refill, and read from disk per decompressor step.
+#define CORPUS_CHUNK_BYTES (64 * 1024)
+
+// Compression formats recognised by their leading bytes.
+typedef enum {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD
+} compressionKind;
+
+// Struct for an open corpus.
+struct corpusStream {
+    int fd;
+    compressionKind compression;
+
+    // Ring of decompressed bytes, filled by the decompressor thread
+    pthread_t decompressor;
+    bool threaded;
+    unsigned char *ring;
+    size_t ringHead;
+    size_t ringCount;
+    bool ringEnd;            // Decompressor finished (or failed)
+    bool cancelled;          // Reader closed early; decompressor should stop
+    int ringError;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+
+    // Parser input
+    unsigned char buffer[CORPUS_CHUNK_BYTES];
+    size_t position;
+    size_t length;
+    bool inputEnd;
+    int error;
+    uint64_t consumed;       // Bytes read from the file so far, when it is not compressed
+    uint64_t stop;           // Offset where input ends early, set by corpusRange
+    bool limited;
+    bool lines;              // Text must end a grid at every line end, set by corpusRange
+
+    // Parser state, kept across refills and calls
+    bool binary;
+    gridCell cells[SIZE * SIZE]; // Grid being assembled
+    int cell;
+    int value;
+    bool inNumber;
+    bool negative;
+    unsigned char token[SIZE * SIZE]; // Digits of the current number, in case it is a one-line grid
+    int tokenLength;
+    bool compact;            // Current token is a one-line grid: one cell per character
+};
+
+
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+/*
+ * Function: ringPush
+ * ------------------
+ * Appends decompressed bytes to the ring, waiting while it is full.
+ *
+ * Returns: false if the reader was closed and the decompressor should stop.
+ */
+
+static bool ringPush(corpusStream *stream, const unsigned char *data, size_t length) {
+    pthread_mutex_lock(&stream->lock);
+    while (length > 0 && !stream->cancelled) {
+        while (stream->ringCount == CORPUS_RING_BYTES && !stream->cancelled) {
+            pthread_cond_wait(&stream->notFull, &stream->lock);
+        }
+        size_t tail = (stream->ringHead + stream->ringCount) % CORPUS_RING_BYTES;
+        size_t space = CORPUS_RING_BYTES - stream->ringCount;
+        size_t run = CORPUS_RING_BYTES - tail < space ? CORPUS_RING_BYTES - tail : space;
+        size_t n = length < run ? length : run;
+        memcpy(stream->ring + tail, data, n);
+        stream->ringCount += n;
+        data += n;
+        length -= n;
+        pthread_cond_signal(&stream->notEmpty);
+    }
+    bool keepGoing = !stream->cancelled;
+    pthread_mutex_unlock(&stream->lock);
+    return keepGoing;
+}
+#endif
+
+
+/*
+ * Function: ringFinish
+ * --------------------
+ * Marks the end of the decompressed data, recording an errno value if decompression failed.
+ */
+
+static void ringFinish(corpusStream *stream, int error) {
+    pthread_mutex_lock(&stream->lock);
+    stream->ringEnd = true;
+    stream->ringError = error;
+    pthread_cond_broadcast(&stream->notEmpty);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+
+/*
+ * Function: readInput
+ * -------------------
+ * Reads raw bytes from the corpus file, retrying interrupted calls.
+ *
+ * Returns: Bytes read, 0 at end of file, or -1 with errno set.
+ */
+
+static ssize_t readInput(int fd, void *data, size_t length) {
+    ssize_t n;
+    while ((n = read(fd, data, length)) < 0 && errno == EINTR) {
+    }
+    return n;
+}
+
+
+#ifdef HAVE_ZLIB
+/*
+ * Function: inflateGzip
+ * ---------------------
+ * Decompresses a gzip stream, including files made of several concatenated gzip members.
+ *
+ * Returns: 0 on success, or an errno value.
+ */
+
+static int inflateGzip(corpusStream *stream, unsigned char *in, unsigned char *out) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, 15 + 32) != Z_OK) {
+        return ENOMEM;
+    }
+
+    int error = 0;
+    bool inputDone = false;
+    bool memberEnded = false; // The last member finished; only trailing input decides if another follows
+    while (!error) {
+        if (z.avail_in == 0 && !inputDone) {
+            ssize_t n = readInput(stream->fd, in, CORPUS_CHUNK_BYTES);
+            if (n < 0) {
+                error = errno;
+                break;
+            }
+            inputDone = n == 0;
+            if (inputDone && memberEnded) {
+                break;
+            }
+            z.next_in = in;
+            z.avail_in = (uInt)n;
+        }
+        z.next_out = out;
+        z.avail_out = CORPUS_CHUNK_BYTES;
+        int rc = inflate(&z, Z_NO_FLUSH);
+        if (!ringPush(stream, out, CORPUS_CHUNK_BYTES - z.avail_out)) {
+            break;
+        }
+        memberEnded = rc == Z_STREAM_END;
+        if (memberEnded) {
+            if (z.avail_in == 0 && inputDone) {
+                break;
+            }
+            inflateReset(&z); // Another member may follow
+        } else if (rc == Z_BUF_ERROR && inputDone && z.avail_in == 0) {
+            error = EPROTO; // Truncated archive
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            error = EPROTO;
+        }
+    }
+    inflateEnd(&z);
+    return error;
+}
+#endif
+
+
+#ifdef HAVE_ZSTD
+/*
+ * Function: inflateZstd
+ * ---------------------
+ * Decompresses a zstd stream, including files made of several concatenated frames.
+ *
+ * Returns: 0 on success, or an errno value.
+ */
+
+static int inflateZstd(corpusStream *stream, unsigned char *in, unsigned char *out) {
+    ZSTD_DStream *z = ZSTD_createDStream();
+    if (!z) {
+        return ENOMEM;
+    }
+    ZSTD_initDStream(z);
+
+    int error = 0;
+    size_t lastResult = 0;
+    ssize_t n;
+    while (!error && (n = readInput(stream->fd, in, CORPUS_CHUNK_BYTES)) != 0) {
+        if (n < 0) {
+            error = errno;
+            break;
+        }
+        ZSTD_inBuffer input = {in, (size_t)n, 0};
+        bool outputFull = false;
+        while (input.pos < input.size || outputFull) {
+            ZSTD_outBuffer output = {out, CORPUS_CHUNK_BYTES, 0};
+            lastResult = ZSTD_decompressStream(z, &output, &input);
+            if (ZSTD_isError(lastResult)) {
+                error = EPROTO;
+                break;
+            }
+            if (!ringPush(stream, out, output.pos)) {
+                ZSTD_freeDStream(z);
+                return 0;
+            }
+            outputFull = output.pos == output.size; // More may be buffered inside the decoder
+        }
+    }
+    if (!error && lastResult != 0) {
+        error = EPROTO; // Input ended inside a frame
+    }
+    ZSTD_freeDStream(z);
+    return error;
+}
+#endif
+
+
+/*
+ * Function: decompressorThread
+ * ----------------------------
+ * Inflates the whole corpus into the ring, then marks its end.
+ *
+ * arg: The corpusStream.
+ *
+ * Returns: NULL.
+ */
+
+static void *decompressorThread(void *arg) {
+    corpusStream *stream = (corpusStream *)arg;
+    unsigned char *in = malloc(CORPUS_CHUNK_BYTES);
+    unsigned char *out = malloc(CORPUS_CHUNK_BYTES);
+    int error = ENOMEM;
+
+    if (in && out) {
+#ifdef HAVE_ZLIB
+        if (stream->compression == COMPRESSION_GZIP) {
+            error = inflateGzip(stream, in, out);
+        }
+#endif
+#ifdef HAVE_ZSTD
+        if (stream->compression == COMPRESSION_ZSTD) {
+            error = inflateZstd(stream, in, out);
+        }
+#endif
+    }
+    free(in);
+    free(out);
+    ringFinish(stream, error);
+    return NULL;
+}
+
+
+/*
+ * Function: refill
+ * ----------------
+ * Moves any unparsed bytes to the front of the parser's input and appends the next (decompressed)
+ * corpus bytes after them.
+ *
+ * Returns: false if no new bytes were added: end of input, or an error (stream->error set).
+ */
+
+static bool refill(corpusStream *stream) {
+    size_t kept = stream->length - stream->position;
+    memmove(stream->buffer, stream->buffer + stream->position, kept);
+    stream->position = 0;
+    stream->length = kept;
+    if (stream->inputEnd) {
+        return false;
+    }
+    size_t space = sizeof(stream->buffer) - kept;
+
+    if (!stream->threaded) {
+        if (stream->limited) {
+            space = stream->stop - stream->consumed < space ? (size_t)(stream->stop - stream->consumed) : space;
+        }
+        ssize_t n = space > 0 ? readInput(stream->fd, stream->buffer + kept, space) : 0;
+        if (n <= 0) {
+            stream->inputEnd = true;
+            stream->error = n < 0 ? errno : 0;
+            return false;
+        }
+        stream->length += (size_t)n;
+        stream->consumed += (uint64_t)n;
+        return true;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    while (stream->ringCount == 0 && !stream->ringEnd) {
+        pthread_cond_wait(&stream->notEmpty, &stream->lock);
+    }
+    while (stream->ringCount > 0 && stream->length < sizeof(stream->buffer)) {
+        size_t run = CORPUS_RING_BYTES - stream->ringHead;
+        size_t n = stream->ringCount < run ? stream->ringCount : run;
+        if (n > sizeof(stream->buffer) - stream->length) {
+            n = sizeof(stream->buffer) - stream->length;
+        }
+        memcpy(stream->buffer + stream->length, stream->ring + stream->ringHead, n);
+        stream->length += n;
+        stream->ringHead = (stream->ringHead + n) % CORPUS_RING_BYTES;
+        stream->ringCount -= n;
+    }
+    bool added = stream->length > kept;
+    if (!added) {
+        stream->inputEnd = true;
+        stream->error = stream->ringError;
+    }
+    pthread_cond_signal(&stream->notFull);
+    pthread_mutex_unlock(&stream->lock);
+    return added;
+}
+
+
+/*
+ * Function: corpusOpen
+ * --------------------
+ * Opens a corpus file, detects gzip or zstd compression from its magic bytes, starts the decompressor
+ * thread when needed, and detects the binary corpus header.
+ *
+ * filename: Path to the corpus.
+ *
+ * Returns: A new stream, or NULL with errno set (EPROTONOSUPPORT for a compression format this build
+ *          cannot read, EINVAL for a binary corpus of another version or grid size).
+ */
+
+corpusStream *corpusOpen(const char *filename) {
+    corpusStream *stream = calloc(1, sizeof(*stream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (stream->fd < 0) {
+        free(stream);
+        return NULL;
+    }
+
+    unsigned char magic[4] = {0};
+    ssize_t got = pread(stream->fd, magic, sizeof(magic), 0);
+    if (got >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        stream->compression = COMPRESSION_GZIP;
+    } else if (got == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        stream->compression = COMPRESSION_ZSTD;
+    }
+
+    if (stream->compression != COMPRESSION_NONE) {
+#ifndef HAVE_ZLIB
+        if (stream->compression == COMPRESSION_GZIP) {
+            fprintf(stderr, "%s: gzip support not compiled in (build with -DHAVE_ZLIB -lz)\n", filename);
+            corpusClose(stream);
+            errno = EPROTONOSUPPORT;
+            return NULL;
+        }
+#endif
+#ifndef HAVE_ZSTD
+        if (stream->compression == COMPRESSION_ZSTD) {
+            fprintf(stderr, "%s: zstd support not compiled in (build with -DHAVE_ZSTD -lzstd)\n", filename);
+            corpusClose(stream);
+            errno = EPROTONOSUPPORT;
+            return NULL;
+        }
+#endif
+        stream->ring = malloc(CORPUS_RING_BYTES);
+        pthread_mutex_init(&stream->lock, NULL);
+        pthread_cond_init(&stream->notEmpty, NULL);
+        pthread_cond_init(&stream->notFull, NULL);
+        if (!stream->ring || pthread_create(&stream->decompressor, NULL, decompressorThread, stream) != 0) {
+            pthread_mutex_destroy(&stream->lock);
+            pthread_cond_destroy(&stream->notEmpty);
+            pthread_cond_destroy(&stream->notFull);
+            corpusClose(stream);
+            errno = ENOMEM;
+            return NULL;
+        }
+        stream->threaded = true;
+    }
+
+    // Detect the binary header at the start of the (decompressed) data
+    while (stream->length < CORPUS_HEADER_SIZE && refill(stream)) {
+    }
+    if (stream->length >= CORPUS_HEADER_SIZE && memcmp(stream->buffer, CORPUS_MAGIC, 4) == 0) {
+        if (stream->buffer[4] != CORPUS_VERSION || stream->buffer[5] != SIZE) {
+            corpusClose(stream);
+            errno = EINVAL;
+            return NULL;
+        }
+        stream->binary = true;
+        stream->position = CORPUS_HEADER_SIZE;
+    }
+    return stream;
+}
+
+
+/*
+ * Function: pushCell
+ * ------------------
+ * Adds one cell to the grid being assembled and stores the grid once it is complete.
+ *
+ * stream: The corpus.
+ * value: The cell's number.
+ * grids, n: Output array and the number of grids stored in it so far.
+ *
+ * Returns: void.
+ */
+
+static void pushCell(corpusStream *stream, int value, gridCell (*grids)[SIZE][SIZE], size_t *n) {
+    stream->cells[stream->cell++] = toCell(value);
+    if (stream->cell == SIZE * SIZE) {
+        memcpy(grids[(*n)++], stream->cells, sizeof(stream->cells));
+        stream->cell = 0;
+    }
+}
+
+
+/*
+ * Function: endToken
+ * ------------------
+ * Finishes the current text token. A run of exactly SIZE*SIZE digits is a one-line grid and yields one
+ * cell per digit; any other run of digits is a single number. A token holding '.' blanks has already
+ * been split into cells as it was read. Completes at most one grid.
+ *
+ * stream: The corpus.
+ * grids, n: Output array and the number of grids stored in it so far.
+ *
+ * Returns: void.
+ */
+
+static void endToken(corpusStream *stream, gridCell (*grids)[SIZE][SIZE], size_t *n) {
+    if (stream->inNumber && !stream->compact) {
+        if (stream->tokenLength == SIZE * SIZE && !stream->negative) {
+            for (int i = 0; i < SIZE * SIZE; i++) {
+                pushCell(stream, stream->token[i] - '0', grids, n);
+            }
+        } else {
+            pushCell(stream, stream->negative ? -stream->value : stream->value, grids, n);
+        }
+    }
+    stream->value = stream->tokenLength = 0;
+    stream->inNumber = stream->negative = stream->compact = false;
+}
+
+
+/*
+ * Function: corpusNext
+ * --------------------
+ * Parses up to `max` further grids. Text corpora hold SIZE*SIZE whitespace-separated numbers per grid,
+ * or one-line grids of SIZE*SIZE characters where '.' (like 0) marks an empty cell; binary corpora hold
+ * SIZE*SIZE bytes per grid. Text parsing stops at the first character that cannot be part of a number
+ * or a one-line grid, as fscanf would.
+ *
+ * stream: The corpus.
+ * grids: Output array with room for max grids.
+ * max: Most grids to return.
+ *
+ * Returns: The number of grids stored; 0 at the end of the corpus. corpusError reports whether the end
+ *          was caused by an error.
+ */
+
+size_t corpusNext(corpusStream *stream, gridCell (*grids)[SIZE][SIZE], size_t max) {
+    size_t n = 0;
+
+    while (n < max) {
+        if (stream->position == stream->length && !refill(stream)) {
+            break;
+        }
+        const unsigned char *p = stream->buffer + stream->position;
+        const unsigned char *end = stream->buffer + stream->length;
+
+        while (p < end && n < max) {
+            if (stream->binary) {
+                // Binary grids already have the in-memory layout; whole ones are copied straight out
+                if (stream->cell == 0 && (size_t)(end - p) >= SIZE * SIZE) {
+                    memcpy(grids[n++], p, SIZE * SIZE);
+                    p += SIZE * SIZE;
+                } else {
+                    pushCell(stream, *p++, grids, &n);
+                }
+                continue;
+            }
+            unsigned char c = *p++;
+            if (c >= '0' && c <= '9') {
+                if (stream->compact) {
+                    pushCell(stream, c - '0', grids, &n);
+                    continue;
+                }
+                stream->value = stream->value < 1000000 ? stream->value * 10 + (c - '0') : stream->value;
+                if (stream->tokenLength < SIZE * SIZE) {
+                    stream->token[stream->tokenLength] = c;
+                }
+                stream->tokenLength += stream->tokenLength <= SIZE * SIZE;
+                stream->inNumber = true;
+                continue;
+            }
+            if (c == '.' && !stream->negative && stream->tokenLength < SIZE * SIZE) {
+                // A blank: the token is a one-line grid, so the digits before it are cells too
+                if (!stream->compact) {
+                    for (int i = 0; i < stream->tokenLength; i++) {
+                        pushCell(stream, stream->token[i] - '0', grids, &n);
+                    }
+                    stream->compact = stream->inNumber = true;
+                }
+                pushCell(stream, 0, grids, &n);
+                continue;
+            }
+            if (c == '-' && !stream->inNumber && !stream->negative) {
+                stream->negative = true;
+                continue;
+            }
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+                // Stop at the first stray character; a number right before it still counts. A range
+                // cannot stop there, as the ranges after it would carry on
+                stream->inputEnd = true;
+                stream->error = stream->lines ? EINVAL : 0;
+                p = end = stream->buffer;
+                stream->length = 0;
+                break;
+            }
+            if (stream->inNumber) {
+                endToken(stream, grids, &n);
+            }
+            if (c == '\n' && stream->lines && stream->cell != 0) {
+                stream->inputEnd = true;
+                stream->error = EINVAL;
+                p = end = stream->buffer;
+                stream->length = 0;
+                break;
+            }
+        }
+        stream->position = (size_t)(p - stream->buffer);
+        if (stream->inputEnd && stream->length == 0) {
+            break;
+        }
+    }
+
+    // A number that runs into the end of the input still counts
+    if (n < max && stream->inputEnd) {
+        endToken(stream, grids, &n);
+        if (stream->lines && stream->cell != 0 && stream->error == 0) {
+            stream->error = EINVAL;
+        }
+    }
+    return n;
+}
+
+
+/*
+ * Function: corpusOffset
+ * ----------------------
+ * Reports where the next grid starts in the file, so a later run can seek straight to it. Only possible
+ * for an uncompressed corpus read up to a grid boundary, with no partly parsed token pending.
+ *
+ * Returns: The byte offset, or -1 if the position cannot be resumed by seeking.
+ */
+
+int64_t corpusOffset(const corpusStream *stream) {
+    // A one-line grid that just ended is as good as a finished token if whitespace follows it
+    unsigned char next = stream->position < stream->length ? stream->buffer[stream->position] : 0;
+    bool tokenDone = !stream->inNumber ||
+                     (stream->compact && (next == ' ' || next == '\t' || next == '\n' || next == '\r'));
+    if (stream->threaded || stream->inputEnd || stream->cell != 0 || !tokenDone || stream->negative) {
+        return -1;
+    }
+    return (int64_t)(stream->consumed - (stream->length - stream->position));
+}
+
+
+/*
+ * Function: corpusSeek
+ * --------------------
+ * Continues parsing at an offset returned by corpusOffset for the same file.
+ *
+ * stream: The corpus.
+ * offset: Byte offset of a grid boundary.
+ *
+ * Returns: true on success, false if the corpus is compressed or the seek failed.
+ */
+
+bool corpusSeek(corpusStream *stream, int64_t offset) {
+    if (stream->threaded || offset < 0 || lseek(stream->fd, (off_t)offset, SEEK_SET) < 0) {
+        return false;
+    }
+    stream->position = stream->length = 0;
+    stream->consumed = (uint64_t)offset;
+    stream->inputEnd = false;
+    stream->error = 0;
+    stream->cell = stream->value = stream->tokenLength = 0;
+    stream->inNumber = stream->negative = stream->compact = false;
+    return true;
+}
+
+
+/*
+ * Function: corpusRange
+ * ---------------------
+ * Restricts an uncompressed corpus to a byte range, so that several readers can split one file. Both
+ * ends must fall on grid boundaries. A text range is split at line starts, so every line in it must end
+ * on a grid boundary and hold nothing but grids; otherwise reading it fails with EINVAL.
+ *
+ * stream: The corpus, freshly opened.
+ * start, end: The range, from the start of the file.
+ *
+ * Returns: true on success, false if the corpus is compressed or the seek failed.
+ */
+
+bool corpusRange(corpusStream *stream, int64_t start, int64_t end) {
+    if (end < start || !corpusSeek(stream, start)) {
+        return false;
+    }
+    stream->stop = (uint64_t)end;
+    stream->limited = true;
+    stream->lines = !stream->binary;
+    return true;
+}
+
+
+/*
+ * Function: corpusError
+ * ---------------------
+ * Reports an I/O or decompression error that ended the corpus early.
+ *
+ * Returns: 0 if the corpus ended normally, or an errno value.
+ */
+
+int corpusError(const corpusStream *stream) {
+    return stream->error;
+}
+
+
+/*
+ * Function: corpusClose
+ * ---------------------
+ * Stops the decompressor (if still running), closes the file, and frees the stream.
+ */
+
+void corpusClose(corpusStream *stream) {
+    if (stream->threaded) {
+        pthread_mutex_lock(&stream->lock);
+        stream->cancelled = true;
+        pthread_cond_broadcast(&stream->notFull);
+        pthread_mutex_unlock(&stream->lock);
+        pthread_join(stream->decompressor, NULL);
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->notEmpty);
+        pthread_cond_destroy(&stream->notFull);
+    }
+    if (stream->fd >= 0) {
+        close(stream->fd);
+    }
+    free(stream->ring);
+    free(stream);
+}
@@ -0,0 +1,498 @@
+/*
+ * File: Sudoku-DLX.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Exact-cover solver (Knuth's Algorithm X with dancing links) for grids of any shape:
+ *              6x6, 9x9, 12x12, 16x16, 25x25, and so on. Each solver owns one contiguous arena holding the full
+ *              constraint matrix, built once; a puzzle's givens are covered before the search and
+ *              uncovered after it, so solving allocates nothing. Also provides the DLX side of the
+ *              solve subcommand.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// Puzzles per worker chunk in the solve subcommand.
+#define DLX_CHUNK_GRIDS 256
+
+// Struct for a solver. Nodes 1..columns are the column headers and node 0 is the root; every matrix
+// row (a number placed in a cell) follows as four consecutive nodes, one per constraint it meets.
+struct dlxSolver {
+    gridShape shape;
+    int order;
+    int columns;         // 4 * order^2 constraints: cell filled, number in row, in column, in box
+    int *left, *right, *up, *down;
+    int *column;         // Column header of each node
+    int *size;           // Nodes remaining in each column
+    int *stack;          // Rows chosen so far, one per cell
+    gridCell *grid;      // Scratch grid each solution is checked in
+    gridCell *first;     // First solution found
+    int depth;
+    int found;
+    int limit;
+};
+
+// Struct describing the chunk one DLX worker is responsible for.
+typedef struct {
+    const gridShape *shape;
+    const gridCell *grids; // count grids of order^2 cells each
+    size_t count;
+    int limit;
+    signed char *outcomes;
+    gridCell *solutions;
+    dlxSolver **solvers; // Slot 0 for the submitting thread, then one per pool worker; built on first use
+    bool failed;         // The worker's solver could not be allocated
+} dlxTask;
+
+/*
+ * Function: dlxCreate
+ * -------------------
+ * Allocates a solver for one grid shape and builds its constraint matrix.
+ *
+ * shape: The box shape (3x3 for 9x9, 2x3 for 6x6, 3x4 for 12x12, ...).
+ *
+ * Returns: The solver, or NULL if the shape is out of range or allocation fails.
+ */
+
+dlxSolver *dlxCreate(const gridShape *shape) {
+    if (shape->order < 1 || shape->order > MAX_ORDER || shape->boxRows * shape->boxCols != shape->order) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int order = shape->order, cells = order * order;
+    int boxesPerBand = order / shape->boxCols;
+    int columns = 4 * cells, rows = cells * order;
+    int nodes = 1 + columns + 4 * rows;
+    size_t ints = 5 * (size_t)nodes + (size_t)columns + 1 + (size_t)cells;
+    ints += (2 * (size_t)cells + sizeof(int) - 1) / sizeof(int); // The two grids
+
+    dlxSolver *dlx = malloc(sizeof(*dlx) + ints * sizeof(int));
+    if (!dlx) {
+        return NULL;
+    }
+    int *links = (int *)(dlx + 1);
+    dlx->left = links;
+    dlx->right = dlx->left + nodes;
+    dlx->up = dlx->right + nodes;
+    dlx->down = dlx->up + nodes;
+    dlx->column = dlx->down + nodes;
+    dlx->size = dlx->column + nodes;
+    dlx->stack = dlx->size + columns + 1;
+    dlx->grid = (gridCell *)(dlx->stack + cells);
+    dlx->first = dlx->grid + cells;
+    dlx->shape = *shape;
+    dlx->order = order;
+    dlx->columns = columns;
+
+    // Root and column headers in one circular list
+    for (int c = 0; c <= columns; c++) {
+        dlx->left[c] = c == 0 ? columns : c - 1;
+        dlx->right[c] = c == columns ? 0 : c + 1;
+        dlx->up[c] = dlx->down[c] = dlx->column[c] = c;
+        dlx->size[c] = 0;
+    }
+
+    // One row per (cell, number), in row-major cell order
+    int node = columns + 1;
+    for (int r = 0; r < order; r++) {
+        for (int c = 0; c < order; c++) {
+            int b = (r / shape->boxRows) * boxesPerBand + c / shape->boxCols;
+            for (int n = 0; n < order; n++) {
+                int hit[4] = {1 + r * order + c, 1 + cells + r * order + n, 1 + 2 * cells + c * order + n,
+                              1 + 3 * cells + b * order + n};
+                for (int k = 0; k < 4; k++, node++) {
+                    int col = hit[k];
+                    dlx->left[node] = k == 0 ? node + 3 : node - 1;
+                    dlx->right[node] = k == 3 ? node - 3 : node + 1;
+                    dlx->column[node] = col;
+                    dlx->up[node] = dlx->up[col];
+                    dlx->down[node] = col;
+                    dlx->down[dlx->up[col]] = node;
+                    dlx->up[col] = node;
+                    dlx->size[col]++;
+                }
+            }
+        }
+    }
+    return dlx;
+}
+
+
+/*
+ * Function: dlxDestroy
+ * --------------------
+ * Frees a solver and its arena.
+ */
+
+void dlxDestroy(dlxSolver *dlx) {
+    free(dlx);
+}
+
+
+/*
+ * Function: dlxOrder
+ * ------------------
+ * Returns: The side length of the grids a solver handles.
+ */
+
+int dlxOrder(const dlxSolver *dlx) {
+    return dlx->order;
+}
+
+
+/*
+ * Function: cover
+ * ---------------
+ * Removes a column from the header list and every row that meets it from the other columns.
+ */
+
+static void cover(dlxSolver *dlx, int c) {
+    dlx->right[dlx->left[c]] = dlx->right[c];
+    dlx->left[dlx->right[c]] = dlx->left[c];
+    for (int i = dlx->down[c]; i != c; i = dlx->down[i]) {
+        for (int j = dlx->right[i]; j != i; j = dlx->right[j]) {
+            dlx->down[dlx->up[j]] = dlx->down[j];
+            dlx->up[dlx->down[j]] = dlx->up[j];
+            dlx->size[dlx->column[j]]--;
+        }
+    }
+}
+
+
+/*
+ * Function: uncover
+ * -----------------
+ * Exactly undoes cover, restoring links in reverse order.
+ */
+
+static void uncover(dlxSolver *dlx, int c) {
+    for (int i = dlx->up[c]; i != c; i = dlx->up[i]) {
+        for (int j = dlx->left[i]; j != i; j = dlx->left[j]) {
+            dlx->size[dlx->column[j]]++;
+            dlx->down[dlx->up[j]] = j;
+            dlx->up[dlx->down[j]] = j;
+        }
+    }
+    dlx->right[dlx->left[c]] = c;
+    dlx->left[dlx->right[c]] = c;
+}
+
+
+/*
+ * Function: search
+ * ----------------
+ * Algorithm X: picks the column with the fewest rows left and tries each of its rows in turn. Each
+ * solution is counted only after shapeValidate confirms it, so a matrix bug can never report a grid
+ * that is not a valid solution.
+ */
+
+static void search(dlxSolver *dlx) {
+    if (dlx->right[0] == 0) {
+        int order = dlx->order;
+        for (int i = 0; i < dlx->depth; i++) {
+            int row = (dlx->stack[i] - dlx->columns - 1) / 4;
+            dlx->grid[row / order] = (gridCell)(row % order + 1);
+        }
+        if (!shapeValidate(&dlx->shape, dlx->grid, false)) {
+            return;
+        }
+        if (dlx->found++ == 0) {
+            memcpy(dlx->first, dlx->grid, (size_t)order * (size_t)order);
+        }
+        return;
+    }
+
+    int best = dlx->right[0];
+    for (int c = dlx->right[best]; c != 0 && dlx->size[best] > 1; c = dlx->right[c]) {
+        if (dlx->size[c] < dlx->size[best]) {
+            best = c;
+        }
+    }
+    if (dlx->size[best] == 0) {
+        return;
+    }
+
+    cover(dlx, best);
+    for (int r = dlx->down[best]; r != best && dlx->found < dlx->limit; r = dlx->down[r]) {
+        dlx->stack[dlx->depth++] = r;
+        for (int j = dlx->right[r]; j != r; j = dlx->right[j]) {
+            cover(dlx, dlx->column[j]);
+        }
+        search(dlx);
+        for (int j = dlx->left[r]; j != r; j = dlx->left[j]) {
+            uncover(dlx, dlx->column[j]);
+        }
+        dlx->depth--;
+    }
+    uncover(dlx, best);
+}
+
+
+/*
+ * Function: isCovered
+ * -------------------
+ * Reports whether a column has been taken out of the header list.
+ */
+
+static bool isCovered(const dlxSolver *dlx, int c) {
+    return dlx->right[dlx->left[c]] != c;
+}
+
+
+/*
+ * Function: dlxSolve
+ * ------------------
+ * Solves one puzzle. The givens are selected as matrix rows up front, the search fills in the rest,
+ * and everything is uncovered again before returning, leaving the matrix ready for the next puzzle.
+ *
+ * params:
+ *      dlx: The solver.
+ *      puzzle: order^2 cells in row-major order, 0 for an empty cell.
+ *      solution: Receives the first solution found; may be NULL. Untouched if there is none.
+ *      limit: Stop searching once this many solutions have been found (at least 1).
+ *
+ * Returns: The number of solutions found, at most limit; 0 if the puzzle has none or its givens are
+ *          out of range or conflict.
+ */
+
+int dlxSolve(dlxSolver *dlx, const gridCell *puzzle, gridCell *solution, int limit) {
+    int order = dlx->order, cells = order * order;
+    bool conflict = false;
+
+    dlx->depth = dlx->found = 0;
+    dlx->limit = limit > 0 ? limit : 1;
+
+    for (int cell = 0; cell < cells && !conflict; cell++) {
+        unsigned value = (unsigned)puzzle[cell];
+        if (value == 0) {
+            continue;
+        }
+        if (value > (unsigned)order) {
+            conflict = true;
+            break;
+        }
+        int row = dlx->columns + 1 + 4 * (cell * order + (int)value - 1);
+        for (int k = 0; k < 4; k++) {
+            conflict = conflict || isCovered(dlx, dlx->column[row + k]);
+        }
+        if (!conflict) {
+            dlx->stack[dlx->depth++] = row;
+            for (int k = 0; k < 4; k++) {
+                cover(dlx, dlx->column[row + k]);
+            }
+        }
+    }
+
+    int givens = dlx->depth;
+    if (!conflict) {
+        search(dlx);
+    }
+
+    // Undo the givens in reverse order
+    for (int g = givens - 1; g >= 0; g--) {
+        for (int k = 3; k >= 0; k--) {
+            uncover(dlx, dlx->column[dlx->stack[g] + k]);
+        }
+    }
+
+    if (conflict) {
+        return 0;
+    }
+    if (dlx->found > 0 && solution) {
+        memcpy(solution, dlx->first, (size_t)cells);
+    }
+    return dlx->found < dlx->limit ? dlx->found : dlx->limit;
+}
+
+
+/*
+ * Function: dlxWorker
+ * -------------------
+ * Solves one chunk of puzzles with the solver of the pool worker running it, building that solver the
+ * first time the worker needs it. The submitting thread runs a task itself when poolSubmit cannot queue
+ * it, and then uses slot 0.
+ *
+ * arg: Pointer to a dlxTask.
+ *
+ * Returns: NULL.
+ */
+
+static void *dlxWorker(void *arg) {
+    dlxTask *task = (dlxTask *)arg;
+    dlxSolver **slot = &task->solvers[poolWorkerIndex() + 1];
+    int cells = task->shape->order * task->shape->order;
+
+    if (!*slot) {
+        *slot = dlxCreate(task->shape);
+    }
+    dlxSolver *dlx = *slot;
+    task->failed = !dlx;
+    for (size_t n = 0; dlx && n < task->count; n++) {
+        task->outcomes[n] = (signed char)dlxSolve(dlx, task->grids + n * cells, task->solutions + n * cells,
+                                                 task->limit);
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: formatGrid
+ * --------------------
+ * Appends one solved grid on a single line: digits for 9x9 and smaller, space-separated numbers otherwise.
+ */
+
+static void formatGrid(outputBuffer *out, const gridCell *cells, int order) {
+    for (int i = 0; i < order * order; i++) {
+        if (order > 9 && i > 0) {
+            outputBytes(out, " ", 1);
+        }
+        outputUnsigned(out, (uint64_t)cells[i]);
+    }
+    outputBytes(out, "\n", 1);
+}
+
+
+/*
+ * Function: dlxSolveFile
+ * ----------------------
+ * The solve subcommand with the DLX engine. 9x9 corpora go through the shared corpus reader (so binary
+ * and compressed corpora work); larger grids are read as text. Puzzles are solved a round at a time,
+ * one chunk per worker, and written in order.
+ *
+ * params:
+ *      path: The puzzle file.
+ *      shape: Box shape of the grids.
+ *      threads: Worker threads.
+ *      placement: CPUs for the workers and for the calling thread, which reads and writes.
+ *      unique: Whether to require exactly one solution.
+ *      verdictOnly: Whether to print a verdict word instead of the solution.
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on an unreadable file or a write error.
+ */
+
+int dlxSolveFile(const char *path, const gridShape *shape, unsigned threads, const cpuPlacement *placement,
+                 bool unique, bool verdictOnly) {
+    int order = shape->order, cells = order * order;
+    corpusStream *stream = NULL;
+    FILE *file = NULL;
+
+    workPool *pool = poolCreate(threads, placement);
+    if (!placeIoThread(placement)) {
+        perror("Error placing the I/O thread");
+    }
+    if (order == SIZE) {
+        stream = corpusOpen(path);
+    } else {
+        file = fopen(path, "r");
+    }
+    if (!stream && !file) {
+        perror("Error opening puzzles");
+        poolDestroy(pool);
+        return EXIT_FAILURE;
+    }
+
+    size_t roundGrids = (size_t)threads * DLX_CHUNK_GRIDS;
+    dlxSolver **solvers = calloc(threads + 1, sizeof(*solvers));
+    dlxTask *tasks = calloc(threads, sizeof(*tasks));
+    gridCell *grids = malloc(roundGrids * (size_t)cells);
+    gridCell *solutions = malloc(roundGrids * (size_t)cells);
+    signed char *outcomes = malloc(roundGrids);
+    outputBuffer out = {0};
+    bool ok = pool && solvers && tasks && grids && solutions && outcomes &&
+              outputInit(&out, STDOUT_FILENO, DLX_CHUNK_GRIDS * (size_t)cells * 3);
+    if (!ok) {
+        perror("Error allocating solver buffers");
+    }
+
+    size_t count = 0, tally[3] = {0}, loaded;
+    for (;;) {
+        if (!ok) {
+            break;
+        }
+        if (stream) {
+            loaded = corpusNext(stream, (gridCell (*)[SIZE][SIZE])grids, roundGrids);
+        } else {
+            for (loaded = 0; loaded < roundGrids && readGridText(file, order, grids + loaded * cells); loaded++) {
+            }
+        }
+        if (loaded == 0) {
+            break;
+        }
+
+        unsigned started = 0;
+        for (size_t next = 0; next < loaded; started++) {
+            dlxTask *task = &tasks[started];
+            task->shape = shape;
+            task->grids = grids + next * cells;
+            task->count = loaded - next < DLX_CHUNK_GRIDS ? loaded - next : DLX_CHUNK_GRIDS;
+            task->limit = unique ? 2 : 1;
+            task->outcomes = outcomes + next;
+            task->solutions = solutions + next * cells;
+            task->solvers = solvers;
+            next += task->count;
+            poolSubmit(pool, dlxWorker, task);
+        }
+        poolWait(pool);
+        for (unsigned t = 0; t < started; t++) {
+            if (tasks[t].failed) {
+                perror("Error allocating solver");
+                ok = false;
+            }
+        }
+
+        for (size_t n = 0; ok && n < loaded; n++) {
+            tally[outcomes[n]]++;
+            if (outcomes[n] == 0) {
+                outputString(&out, "UNSOLVABLE\n");
+            } else if (unique && outcomes[n] > 1) {
+                outputString(&out, "MULTIPLE\n");
+            } else if (verdictOnly) {
+                outputString(&out, unique ? "unique\n" : "solvable\n");
+            } else {
+                formatGrid(&out, solutions + n * cells, order);
+            }
+        }
+        count += loaded;
+        if (ok && !outputFlush(&out)) {
+            perror("Error writing solutions");
+            ok = false;
+        }
+    }
+
+    outputFree(&out);
+    free(outcomes);
+    free(solutions);
+    free(grids);
+    free(tasks);
+    poolDestroy(pool);
+    for (unsigned t = 0; solvers && t <= threads; t++) {
+        dlxDestroy(solvers[t]);
+    }
+    free(solvers);
+
+    if (stream) {
+        if (ok && corpusError(stream)) {
+            errno = corpusError(stream);
+            perror("Error reading puzzles");
+            ok = false;
+        }
+        corpusClose(stream);
+    } else {
+        fclose(file);
+    }
+
+    if (ok && unique) {
+        fprintf(stderr, "%s: %zu puzzles, %zu unique, %zu MULTIPLE, %zu UNSOLVABLE\n", path, count, tally[1],
+                tally[2], tally[0]);
+    } else if (ok) {
+        fprintf(stderr, "%s: %zu puzzles, %zu solved, %zu UNSOLVABLE\n", path, count, tally[1], tally[0]);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
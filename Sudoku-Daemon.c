@@ -0,0 +1,1322 @@
+/*
+ * File: Sudoku-Daemon.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Validation daemon on a Unix domain socket. Clients send one grid per line and get one
+ *              verdict line back per grid, in order. Requests arrive a grid at a time, but the batch
+ *              kernels want dozens at once, so the I/O thread holds requests in a micro-batch until it is
+ *              full or its latency deadline passes. When waiting has recently not gathered more
+ *              requests, a batch goes as soon as the input is drained instead. Worker threads validate
+ *              whole batches in one pass, and the I/O thread fans the verdicts back out. Interactive and
+ *              bulk requests travel in separate lanes, and workers always empty the interactive lane
+ *              before taking the next bulk batch, so a large submission cannot starve single checks.
+ */
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// Default time a request may wait for others to join its micro-batch, in microseconds.
+#define DAEMON_DEFAULT_DEADLINE_US 50
+
+// Most grids in one micro-batch.
+#define DAEMON_MAX_BATCH 64
+
+// Longest request line; longer ones are answered with an error.
+#define DAEMON_LINE_MAX 1024
+
+// Requests a connection may have awaiting responses before the daemon stops reading from it.
+#define DAEMON_MAX_OUTSTANDING 4096
+
+// Response bytes a connection may have waiting to be sent before the daemon stops reading from it.
+#define DAEMON_MAX_BACKLOG (256 * 1024)
+
+// Initial size of a connection's output backlog.
+#define DAEMON_OUTPUT_CHUNK 4096
+
+// Room for one stats or metrics response, far more than writeStats or writeMetrics writes.
+#define DAEMON_STATS_MAX 16384
+
+// Latency histograms are exported with one bucket per power of two of nanoseconds between these.
+#define METRICS_LATENCY_FIRST 10
+#define METRICS_LATENCY_LAST 30
+
+// How often a stopping daemon checks whether its clients have taken their last responses, and how
+// long it waits for them in all, in milliseconds.
+#define DAEMON_STOP_POLL_MS 100
+#define DAEMON_STOP_DRAIN_MS 1000
+
+// Events handled per epoll_wait call.
+#define DAEMON_MAX_EVENTS 64
+
+// One request, in the fixed-point unit of the waiting gain (sixteenths).
+#define GAIN_ONE 16
+
+// While waiting does not pay, every this many batches still waits, to notice when load picks up.
+#define DAEMON_PROBE_INTERVAL 16
+
+// Latency histograms have four buckets per power of two of nanoseconds.
+#define LATENCY_BUCKETS 256
+
+// Why a micro-batch was closed.
+typedef enum {
+    FLUSH_FULL,      // It reached the batch size
+    FLUSH_DEADLINE,  // Its oldest request waited the whole deadline
+    FLUSH_EARLY,     // Recent waits gathered no more requests, so it went once the input was drained
+    NUM_FLUSH_REASONS
+} flushReason;
+
+static const char *flushNames[NUM_FLUSH_REASONS] = {"full", "deadline", "early"};
+
+// Priority lanes, highest first. Each has its own micro-batch, queue, and counters.
+typedef enum {
+    LANE_INTERACTIVE,
+    LANE_BULK,
+    NUM_LANES
+} laneId;
+
+static const char *laneNames[NUM_LANES] = {"interactive", "bulk"};
+
+typedef enum {
+    REQUEST_GRID,
+    REQUEST_MALFORMED,
+    REQUEST_STATS,
+    REQUEST_METRICS
+} requestKind;
+
+typedef struct daemonConnection daemonConnection;
+
+// Struct for one request line, kept until its response is written.
+typedef struct daemonRequest {
+    daemonConnection *connection;
+    struct daemonRequest *next;  // Next request on the same connection, or on the free list
+    uint64_t arrival;            // When its line was read
+    requestKind kind;
+    laneId lane;
+    bool done;
+    bool valid;
+} daemonRequest;
+
+// Struct for a client connection. Responses go out in request order, so a request is answered only
+// once every earlier request on the connection is done. The socket never blocks: responses the client
+// is not ready for wait in the output backlog until epoll reports it writable.
+struct daemonConnection {
+    int fd;
+    char *output;                // Output backlog; bytes [sent, queued) are still to be sent
+    size_t sent, queued, capacity;
+    daemonRequest *first, *last; // Requests awaiting a response, oldest first
+    daemonConnection *prev, *next;
+    uint64_t serial;             // Last finished batch that touched the connection
+    size_t outstanding;          // Requests awaiting a response
+    laneId lane;                 // Lane of the grids it sends, chosen with a "lane" line
+    uint32_t events;             // Events epoll watches for
+    bool registered;             // In the epoll set
+    bool hangup;                 // No more requests; retired once every response is written
+    bool failed;                 // Output cannot be delivered; responses are discarded
+    bool retired;                // Closed; freed once the current round of events is handled
+    bool discarding;             // Skipping the rest of an overlong line
+    size_t length;
+    char line[DAEMON_LINE_MAX];
+};
+
+// Struct for a micro-batch: the grids are copied side by side for the batch kernel.
+typedef struct daemonBatch {
+    struct daemonBatch *next;
+    laneId lane;
+    size_t count;
+    uint64_t opened;             // Arrival of its first request
+    size_t drained;              // Size when the input was first drained, or 0 before that
+    daemonRequest *requests[DAEMON_MAX_BATCH];
+    gridCell grids[DAEMON_MAX_BATCH][SIZE][SIZE];
+    unsigned char verdicts[DAEMON_MAX_BATCH];
+} daemonBatch;
+
+// Struct for a latency distribution.
+typedef struct {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[LATENCY_BUCKETS];
+} latencyHistogram;
+
+// Struct for the I/O thread's side of one lane.
+typedef struct {
+    daemonBatch *open;           // Batch being filled, if any
+    int64_t gain;                // Moving average of requests gained by waiting, in sixteenths
+    unsigned probe;
+    uint64_t grids, valid;
+    uint64_t batched;            // Grids handed to the workers
+    uint64_t flushes[NUM_FLUSH_REASONS];
+    uint64_t batchSizes[DAEMON_MAX_BATCH + 1];
+    latencyHistogram batching;   // Arrival to dispatch: what waiting for the batch adds
+    latencyHistogram response;   // Arrival to response
+} daemonLane;
+
+// Struct for the state of the I/O thread; the workers only see the batch queue.
+typedef struct {
+    int listenFd, epollFd, timerFd, signalFd;
+    uint64_t deadline;           // Nanoseconds
+    uint64_t armed;              // When the timer is set to fire, or 0
+    size_t maxBatch;
+    bool stopping;
+    daemonConnection *connections;
+    daemonConnection *retired;   // Closed connections; later events of the same round may still name them
+    uint64_t stopBy;             // When a stopping daemon gives up on clients that do not read
+    daemonBatch *spare;
+    daemonRequest *spareRequests;
+    uint64_t inFlight;           // Batches handed to the workers
+    uint64_t serial;
+    uint64_t malformed, accepted;
+    daemonLane lanes[NUM_LANES];
+} daemonState;
+
+// Batches go from the I/O thread to the workers on a pending list per lane, and come back on finished.
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    daemonBatch *pending[NUM_LANES], *pendingLast[NUM_LANES];
+    daemonBatch *finished;
+    bool closed;
+    bool puzzle;
+    int wakeFd;                  // eventfd the I/O thread polls for finished batches
+    cpuPlacement placement;      // Applied by each worker as it starts
+} queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .notEmpty = PTHREAD_COND_INITIALIZER,
+    .wakeFd = -1,
+};
+
+
+/*
+ * Function: latencyRecord
+ * -----------------------
+ * Adds a sample to a histogram. Buckets split each power of two in four, so percentiles read from them
+ * are within 25% of the true value.
+ */
+
+static void latencyRecord(latencyHistogram *histogram, uint64_t nanos) {
+    int bucket = (int)nanos;
+
+    if (nanos >= 4) {
+        int bits = 63 - __builtin_clzll(nanos);
+        bucket = bits * 4 + (int)((nanos >> (bits - 2)) & 3);
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total += nanos;
+    if (nanos > histogram->max) {
+        histogram->max = nanos;
+    }
+}
+
+
+/*
+ * Function: latencyPercentile
+ * ---------------------------
+ * Returns: The upper edge of the bucket holding the given percentile, capped at the largest sample.
+ */
+
+static uint64_t latencyPercentile(const latencyHistogram *histogram, unsigned percent) {
+    uint64_t rank = (histogram->count * percent + 99) / 100, seen = 0;
+
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank && seen > 0) {
+            uint64_t upper = bucket < 4 ? (uint64_t)bucket
+                                        : ((uint64_t)(4 + bucket % 4 + 1) << (bucket / 4 - 2)) - 1;
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * Function: writeLatency
+ * ----------------------
+ * Writes one line summarising a latency histogram, in microseconds.
+ */
+
+static void writeLatency(outputBuffer *out, const char *name, const latencyHistogram *histogram) {
+    char line[256];
+
+    snprintf(line, sizeof(line), "%s latency mean %.1fus p50 %.1fus p99 %.1fus max %.1fus\n", name,
+             histogram->count ? histogram->total / 1e3 / histogram->count : 0.0,
+             latencyPercentile(histogram, 50) / 1e3, latencyPercentile(histogram, 99) / 1e3, histogram->max / 1e3);
+    outputString(out, line);
+}
+
+
+/*
+ * Function: writeStats
+ * --------------------
+ * Writes the daemon's counters, then for each lane: grids served, how micro-batches were closed, how
+ * large they were (in power-of-two ranges), and the latency batching adds next to the full response
+ * latency.
+ */
+
+static void writeStats(const daemonState *state, outputBuffer *out) {
+    char line[512];
+
+    snprintf(line, sizeof(line), "malformed %llu connections %llu\n", (unsigned long long)state->malformed,
+             (unsigned long long)state->accepted);
+    outputString(out, line);
+
+    for (int id = 0; id < NUM_LANES; id++) {
+        const daemonLane *lane = &state->lanes[id];
+        const char *name = laneNames[id];
+        uint64_t batches = 0;
+
+        for (int reason = 0; reason < NUM_FLUSH_REASONS; reason++) {
+            batches += lane->flushes[reason];
+        }
+        snprintf(line, sizeof(line),
+                 "%s grids %llu valid %llu\n"
+                 "%s batches %llu mean size %.1f closed %s %llu %s %llu %s %llu\n",
+                 name, (unsigned long long)lane->grids, (unsigned long long)lane->valid, name,
+                 (unsigned long long)batches, batches ? (double)lane->batched / batches : 0.0,
+                 flushNames[FLUSH_FULL], (unsigned long long)lane->flushes[FLUSH_FULL], flushNames[FLUSH_DEADLINE],
+                 (unsigned long long)lane->flushes[FLUSH_DEADLINE], flushNames[FLUSH_EARLY],
+                 (unsigned long long)lane->flushes[FLUSH_EARLY]);
+        outputString(out, line);
+
+        outputString(out, name);
+        outputString(out, " batch sizes");
+        for (size_t low = 1; low <= state->maxBatch; low *= 2) {
+            size_t high = low * 2 - 1 < state->maxBatch ? low * 2 - 1 : state->maxBatch;
+            uint64_t count = 0;
+            for (size_t size = low; size <= high; size++) {
+                count += lane->batchSizes[size];
+            }
+            if (low == high) {
+                snprintf(line, sizeof(line), " %zu:%llu", low, (unsigned long long)count);
+            } else {
+                snprintf(line, sizeof(line), " %zu-%zu:%llu", low, high, (unsigned long long)count);
+            }
+            outputString(out, line);
+        }
+        outputString(out, "\n");
+        snprintf(line, sizeof(line), "%s batching", name);
+        writeLatency(out, line, &lane->batching);
+        snprintf(line, sizeof(line), "%s response", name);
+        writeLatency(out, line, &lane->response);
+    }
+}
+
+
+/*
+ * Function: writeMetricsHistogram
+ * -------------------------------
+ * Writes the samples of one lane's latency histogram in Prometheus format, in seconds. Exported buckets
+ * end at powers of two of nanoseconds, which fall on edges of the histogram's own buckets, so each
+ * counts exactly the samples below its edge.
+ */
+
+static void writeMetricsHistogram(outputBuffer *out, const char *metric, const char *lane,
+                                  const latencyHistogram *histogram) {
+    char line[256];
+    uint64_t cumulative = 0;
+    int bucket = 0;
+
+    for (int bits = METRICS_LATENCY_FIRST; bits <= METRICS_LATENCY_LAST; bits++) {
+        for (; bucket < bits * 4; bucket++) {
+            cumulative += histogram->buckets[bucket];
+        }
+        snprintf(line, sizeof(line), "%s_bucket{lane=\"%s\",le=\"%.9g\"} %llu\n", metric, lane,
+                 (double)(1ull << bits) / 1e9, (unsigned long long)cumulative);
+        outputString(out, line);
+    }
+    snprintf(line, sizeof(line),
+             "%s_bucket{lane=\"%s\",le=\"+Inf\"} %llu\n%s_sum{lane=\"%s\"} %.9f\n%s_count{lane=\"%s\"} %llu\n",
+             metric, lane, (unsigned long long)histogram->count, metric, lane, histogram->total / 1e9, metric, lane,
+             (unsigned long long)histogram->count);
+    outputString(out, line);
+}
+
+
+/*
+ * Function: writeMetrics
+ * ----------------------
+ * Writes the counters and histograms of writeStats in Prometheus text exposition format, with a lane
+ * label on every per-lane sample, so a scraper can poll the daemon over its socket.
+ */
+
+static void writeMetrics(const daemonState *state, outputBuffer *out) {
+    char line[512];
+
+    snprintf(line, sizeof(line),
+             "# HELP sudoku_daemon_connections_total Client connections accepted.\n"
+             "# TYPE sudoku_daemon_connections_total counter\n"
+             "sudoku_daemon_connections_total %llu\n"
+             "# HELP sudoku_daemon_malformed_total Request lines that were not a grid or a command.\n"
+             "# TYPE sudoku_daemon_malformed_total counter\n"
+             "sudoku_daemon_malformed_total %llu\n",
+             (unsigned long long)state->accepted, (unsigned long long)state->malformed);
+    outputString(out, line);
+
+    outputString(out, "# HELP sudoku_daemon_grids_total Grids validated.\n"
+                      "# TYPE sudoku_daemon_grids_total counter\n");
+    for (int id = 0; id < NUM_LANES; id++) {
+        snprintf(line, sizeof(line), "sudoku_daemon_grids_total{lane=\"%s\"} %llu\n", laneNames[id],
+                 (unsigned long long)state->lanes[id].grids);
+        outputString(out, line);
+    }
+    outputString(out, "# HELP sudoku_daemon_valid_total Grids found valid.\n"
+                      "# TYPE sudoku_daemon_valid_total counter\n");
+    for (int id = 0; id < NUM_LANES; id++) {
+        snprintf(line, sizeof(line), "sudoku_daemon_valid_total{lane=\"%s\"} %llu\n", laneNames[id],
+                 (unsigned long long)state->lanes[id].valid);
+        outputString(out, line);
+    }
+    outputString(out, "# HELP sudoku_daemon_batches_total Micro-batches, by why they were closed.\n"
+                      "# TYPE sudoku_daemon_batches_total counter\n");
+    for (int id = 0; id < NUM_LANES; id++) {
+        for (int reason = 0; reason < NUM_FLUSH_REASONS; reason++) {
+            snprintf(line, sizeof(line), "sudoku_daemon_batches_total{lane=\"%s\",reason=\"%s\"} %llu\n",
+                     laneNames[id], flushNames[reason], (unsigned long long)state->lanes[id].flushes[reason]);
+            outputString(out, line);
+        }
+    }
+
+    outputString(out, "# HELP sudoku_daemon_batch_size Grids per micro-batch.\n"
+                      "# TYPE sudoku_daemon_batch_size histogram\n");
+    for (int id = 0; id < NUM_LANES; id++) {
+        const daemonLane *lane = &state->lanes[id];
+        uint64_t cumulative = 0;
+        for (size_t size = 1, edge = 1; size <= state->maxBatch; size++) {
+            cumulative += lane->batchSizes[size];
+            if (size == edge || size == state->maxBatch) {
+                snprintf(line, sizeof(line), "sudoku_daemon_batch_size_bucket{lane=\"%s\",le=\"%zu\"} %llu\n",
+                         laneNames[id], size, (unsigned long long)cumulative);
+                outputString(out, line);
+                edge *= 2;
+            }
+        }
+        snprintf(line, sizeof(line),
+                 "sudoku_daemon_batch_size_bucket{lane=\"%s\",le=\"+Inf\"} %llu\n"
+                 "sudoku_daemon_batch_size_sum{lane=\"%s\"} %llu\n"
+                 "sudoku_daemon_batch_size_count{lane=\"%s\"} %llu\n",
+                 laneNames[id], (unsigned long long)cumulative, laneNames[id], (unsigned long long)lane->batched,
+                 laneNames[id], (unsigned long long)cumulative);
+        outputString(out, line);
+    }
+
+    outputString(out, "# HELP sudoku_daemon_batching_seconds Time from a request's arrival to its dispatch.\n"
+                      "# TYPE sudoku_daemon_batching_seconds histogram\n");
+    for (int id = 0; id < NUM_LANES; id++) {
+        writeMetricsHistogram(out, "sudoku_daemon_batching_seconds", laneNames[id], &state->lanes[id].batching);
+    }
+    outputString(out, "# HELP sudoku_daemon_response_seconds Time from a request's arrival to its response.\n"
+                      "# TYPE sudoku_daemon_response_seconds histogram\n");
+    for (int id = 0; id < NUM_LANES; id++) {
+        writeMetricsHistogram(out, "sudoku_daemon_response_seconds", laneNames[id], &state->lanes[id].response);
+    }
+}
+
+
+/*
+ * Function: newRequest
+ * --------------------
+ * Queues a request at the end of a connection's list, reusing a released one where possible.
+ *
+ * Returns: The request, or NULL if memory ran out.
+ */
+
+static daemonRequest *newRequest(daemonState *state, daemonConnection *connection, requestKind kind, uint64_t arrival) {
+    daemonRequest *request = state->spareRequests;
+
+    if (request) {
+        state->spareRequests = request->next;
+    } else if (!(request = malloc(sizeof(*request)))) {
+        return NULL;
+    }
+    request->connection = connection;
+    request->next = NULL;
+    request->arrival = arrival;
+    request->kind = kind;
+    request->lane = connection->lane;
+    request->done = kind != REQUEST_GRID;
+    request->valid = false;
+    if (connection->last) {
+        connection->last->next = request;
+    } else {
+        connection->first = request;
+    }
+    connection->last = request;
+    connection->outstanding++;
+    return request;
+}
+
+
+/*
+ * Function: closeConnection
+ * -------------------------
+ * Takes a connection with no requests left off the live list. It is only freed by freeRetired, since
+ * the events epoll_wait returned alongside the one that closed it may still point at it.
+ */
+
+static void closeConnection(daemonState *state, daemonConnection *connection) {
+    if (connection->registered) {
+        epoll_ctl(state->epollFd, EPOLL_CTL_DEL, connection->fd, NULL);
+    }
+    if (connection->prev) {
+        connection->prev->next = connection->next;
+    } else {
+        state->connections = connection->next;
+    }
+    if (connection->next) {
+        connection->next->prev = connection->prev;
+    }
+    connection->retired = true;
+    connection->next = state->retired;
+    state->retired = connection;
+}
+
+
+/*
+ * Function: freeRetired
+ * ---------------------
+ * Closes and frees the connections retired while handling a round of events.
+ */
+
+static void freeRetired(daemonState *state) {
+    while (state->retired) {
+        daemonConnection *connection = state->retired;
+        state->retired = connection->next;
+        free(connection->output);
+        close(connection->fd);
+        free(connection);
+    }
+}
+
+
+/*
+ * Function: queueOutput
+ * ---------------------
+ * Appends response bytes to a connection's output backlog, growing it as needed. Output for a failed
+ * connection is dropped.
+ *
+ * Returns: true, or false if memory ran out.
+ */
+
+static bool queueOutput(daemonConnection *connection, const char *data, size_t length) {
+    if (connection->failed) {
+        return true;
+    }
+    if (connection->queued + length > connection->capacity) {
+        if (connection->sent > 0) {
+            memmove(connection->output, connection->output + connection->sent, connection->queued - connection->sent);
+            connection->queued -= connection->sent;
+            connection->sent = 0;
+        }
+        size_t capacity = connection->capacity ? connection->capacity : DAEMON_OUTPUT_CHUNK;
+        while (connection->queued + length > capacity) {
+            capacity *= 2;
+        }
+        if (capacity != connection->capacity) {
+            char *grown = realloc(connection->output, capacity);
+            if (!grown) {
+                return false;
+            }
+            connection->output = grown;
+            connection->capacity = capacity;
+        }
+    }
+    memcpy(connection->output + connection->queued, data, length);
+    connection->queued += length;
+    return true;
+}
+
+
+/*
+ * Function: sendOutput
+ * --------------------
+ * Sends as much of a connection's output backlog as the socket takes without blocking. A send error
+ * marks the connection failed: a client that is gone gets no more responses.
+ */
+
+static void sendOutput(daemonConnection *connection) {
+    while (!connection->failed && connection->sent < connection->queued) {
+        ssize_t n = send(connection->fd, connection->output + connection->sent, connection->queued - connection->sent,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            connection->failed = errno != EAGAIN && errno != EWOULDBLOCK;
+            break;
+        }
+        connection->sent += (size_t)n;
+    }
+    if (connection->failed || connection->sent == connection->queued) {
+        connection->sent = connection->queued = 0;
+    }
+}
+
+
+/*
+ * Function: updateConnection
+ * --------------------------
+ * Sends what it can of a connection's backlog, then sets which events epoll watches for. Input is
+ * watched unless the client hung up or is too far ahead: reading stops at DAEMON_MAX_OUTSTANDING
+ * requests awaiting responses or DAEMON_MAX_BACKLOG bytes of unsent output, and resumes once both are
+ * down by half. Output is watched while a backlog remains. A hung-up connection with nothing left to
+ * answer or send is closed.
+ */
+
+static void updateConnection(daemonState *state, daemonConnection *connection) {
+    sendOutput(connection);
+    if (connection->failed) {
+        connection->hangup = true;
+    }
+    size_t backlog = connection->queued - connection->sent;
+    if (connection->hangup && !connection->first && backlog == 0) {
+        closeConnection(state, connection);
+        return;
+    }
+
+    bool reading = connection->events & EPOLLIN;
+    if (connection->hangup || connection->outstanding >= DAEMON_MAX_OUTSTANDING || backlog >= DAEMON_MAX_BACKLOG) {
+        reading = false;
+    } else if (connection->outstanding <= DAEMON_MAX_OUTSTANDING / 2 && backlog <= DAEMON_MAX_BACKLOG / 2) {
+        reading = true;
+    }
+    uint32_t events = (reading ? EPOLLIN : 0) | (backlog > 0 ? EPOLLOUT : 0);
+    struct epoll_event event = {.events = events, .data.ptr = connection};
+
+    // A hung-up connection waiting on the workers leaves the set, where a reset would keep reporting errors
+    if (connection->hangup && events == 0) {
+        if (connection->registered && epoll_ctl(state->epollFd, EPOLL_CTL_DEL, connection->fd, NULL) == 0) {
+            connection->registered = false;
+        }
+    } else if (!connection->registered) {
+        if (epoll_ctl(state->epollFd, EPOLL_CTL_ADD, connection->fd, &event) == 0) {
+            connection->registered = true;
+            connection->events = events;
+        }
+    } else if (events != connection->events &&
+               epoll_ctl(state->epollFd, EPOLL_CTL_MOD, connection->fd, &event) == 0) {
+        connection->events = events;
+    }
+}
+
+
+/*
+ * Function: dropConnection
+ * ------------------------
+ * Gives up on a connection whose output cannot be delivered, or that ran out of memory. It is closed
+ * once the workers are done with its requests.
+ */
+
+static void dropConnection(daemonState *state, daemonConnection *connection) {
+    connection->failed = true;
+    connection->sent = connection->queued = 0;
+    updateConnection(state, connection);
+}
+
+
+/*
+ * Function: respond
+ * -----------------
+ * Queues the responses of a connection's finished requests, stopping at the first one still being
+ * validated, releases those requests, and sends what the client will take. May close the connection.
+ */
+
+static void respond(daemonState *state, daemonConnection *connection) {
+    uint64_t now = 0;
+    bool ok = true;
+
+    while (connection->first && connection->first->done) {
+        daemonRequest *request = connection->first;
+        switch (request->kind) {
+        case REQUEST_GRID:
+            ok &= queueOutput(connection, request->valid ? "valid\n" : "INVALID\n", request->valid ? 6 : 8);
+            now = now ? now : nowNanos();
+            latencyRecord(&state->lanes[request->lane].response, now - request->arrival);
+            break;
+        case REQUEST_MALFORMED:
+            ok &= queueOutput(connection, "ERROR malformed grid\n", 21);
+            break;
+        case REQUEST_STATS:
+        case REQUEST_METRICS: {
+            char text[DAEMON_STATS_MAX];
+            outputBuffer stats;
+            outputAttach(&stats, -1, text, sizeof(text));
+            if (request->kind == REQUEST_STATS) {
+                writeStats(state, &stats);
+            } else {
+                writeMetrics(state, &stats);
+            }
+            outputString(&stats, "\n");
+            ok &= queueOutput(connection, text, stats.length);
+            break;
+        }
+        }
+        connection->first = request->next;
+        connection->outstanding--;
+        request->next = state->spareRequests;
+        state->spareRequests = request;
+    }
+    if (!connection->first) {
+        connection->last = NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Out of memory; dropping a connection\n");
+        dropConnection(state, connection);
+        return;
+    }
+    updateConnection(state, connection);
+}
+
+
+/*
+ * Function: dispatchBatch
+ * -----------------------
+ * Hands a lane's open micro-batch to the workers.
+ */
+
+static void dispatchBatch(daemonState *state, laneId id, flushReason reason) {
+    daemonLane *lane = &state->lanes[id];
+    daemonBatch *batch = lane->open;
+    uint64_t now = nowNanos();
+
+    lane->open = NULL;
+    if (batch->drained > 0 && reason != FLUSH_EARLY) {
+        int64_t gained = (int64_t)(batch->count - batch->drained) * GAIN_ONE;
+        lane->gain += (gained - lane->gain) / 8;
+    }
+    for (size_t i = 0; i < batch->count; i++) {
+        latencyRecord(&lane->batching, now - batch->requests[i]->arrival);
+    }
+    lane->flushes[reason]++;
+    lane->batchSizes[batch->count]++;
+    lane->batched += batch->count;
+    state->inFlight++;
+
+    batch->next = NULL;
+    batch->lane = id;
+    pthread_mutex_lock(&queue.lock);
+    if (queue.pendingLast[id]) {
+        queue.pendingLast[id]->next = batch;
+    } else {
+        queue.pending[id] = batch;
+    }
+    queue.pendingLast[id] = batch;
+    pthread_cond_signal(&queue.notEmpty);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+
+/*
+ * Function: handleLine
+ * --------------------
+ * Turns one request line into a request: a grid joins its lane's open micro-batch, "stats" asks for
+ * the counters and "metrics" for the same in Prometheus format, "lane interactive" or "lane bulk" picks
+ * the lane of the connection's later grids (with no response), and anything else is malformed.
+ *
+ * Returns: true, or false if memory ran out.
+ */
+
+static bool handleLine(daemonState *state, daemonConnection *connection, const char *line, size_t length,
+                       uint64_t now) {
+    gridCell grid[SIZE][SIZE];
+
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t')) {
+        length--;
+    }
+    if (length == 0) {
+        return true;
+    }
+    if (length == 5 && memcmp(line, "stats", 5) == 0) {
+        return newRequest(state, connection, REQUEST_STATS, now) != NULL;
+    }
+    if (length == 7 && memcmp(line, "metrics", 7) == 0) {
+        return newRequest(state, connection, REQUEST_METRICS, now) != NULL;
+    }
+    for (int id = 0; id < NUM_LANES; id++) {
+        if (length == 5 + strlen(laneNames[id]) && memcmp(line, "lane ", 5) == 0 &&
+            memcmp(line + 5, laneNames[id], length - 5) == 0) {
+            connection->lane = (laneId)id;
+            return true;
+        }
+    }
+    if (!parseSudoku(line, length, grid)) {
+        state->malformed++;
+        return newRequest(state, connection, REQUEST_MALFORMED, now) != NULL;
+    }
+
+    daemonLane *lane = &state->lanes[connection->lane];
+    if (!lane->open) {
+        if (state->spare) {
+            lane->open = state->spare;
+            state->spare = state->spare->next;
+        } else if (!(lane->open = malloc(sizeof(daemonBatch)))) {
+            return false;
+        }
+        lane->open->count = 0;
+        lane->open->drained = 0;
+    }
+    daemonBatch *batch = lane->open;
+    daemonRequest *request = newRequest(state, connection, REQUEST_GRID, now);
+    if (!request) {
+        return false;
+    }
+    if (batch->count == 0) {
+        batch->opened = now;
+    }
+    batch->requests[batch->count] = request;
+    memcpy(batch->grids[batch->count], grid, sizeof(grid));
+    lane->grids++;
+    if (++batch->count == state->maxBatch) {
+        dispatchBatch(state, connection->lane, FLUSH_FULL);
+    }
+    return true;
+}
+
+
+/*
+ * Function: readConnection
+ * ------------------------
+ * Reads what a client has sent and handles every complete line. Lines split across reads are collected
+ * in the connection; lines that arrive whole are parsed where they lie.
+ */
+
+static void readConnection(daemonState *state, daemonConnection *connection) {
+    char data[1 << 16];
+    ssize_t got = recv(connection->fd, data, sizeof(data), MSG_DONTWAIT);
+
+    if (got < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (got <= 0) {
+        // After an end of input the client may still be reading; after an error it is not
+        if (got < 0) {
+            connection->failed = true;
+        }
+        connection->hangup = true;
+        updateConnection(state, connection);
+        return;
+    }
+
+    uint64_t now = nowNanos();
+    const char *p = data, *end = data + got;
+    while (p < end) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        size_t take = (size_t)((newline ? newline : end) - p);
+        bool ok = true;
+
+        // The length limit applies however the line was split between reads
+        if (connection->discarding || connection->length + take > DAEMON_LINE_MAX) {
+            connection->discarding = true;
+        } else if (newline && connection->length == 0) {
+            ok = handleLine(state, connection, p, take, now);
+        } else {
+            memcpy(connection->line + connection->length, p, take);
+            connection->length += take;
+        }
+        p += take;
+        if (!newline) {
+            break;
+        }
+        p++;
+        if (connection->discarding) {
+            state->malformed++;
+            ok = newRequest(state, connection, REQUEST_MALFORMED, now) != NULL;
+        } else if (connection->length > 0) {
+            ok = handleLine(state, connection, connection->line, connection->length, now);
+        }
+        connection->length = 0;
+        connection->discarding = false;
+        if (!ok) {
+            fprintf(stderr, "Out of memory; dropping a connection\n");
+            dropConnection(state, connection);
+            return;
+        }
+    }
+    respond(state, connection);
+}
+
+
+/*
+ * Function: serviceConnection
+ * ---------------------------
+ * Handles the events epoll reported for a connection: sends more of its backlog when it is writable
+ * and reads its requests when it is readable. An error or hangup means responses can no longer be
+ * delivered.
+ */
+
+static void serviceConnection(daemonState *state, daemonConnection *connection, uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        dropConnection(state, connection);
+        return;
+    }
+    if (events & EPOLLOUT) {
+        updateConnection(state, connection);
+    }
+    if ((events & EPOLLIN) && !connection->retired && !connection->hangup) {
+        readConnection(state, connection);
+    }
+}
+
+
+/*
+ * Function: acceptConnections
+ * ---------------------------
+ * Accepts every pending client. Client sockets are non-blocking, so a client that does not read its
+ * responses can never stall the I/O thread.
+ */
+
+static void acceptConnections(daemonState *state) {
+    int fd;
+
+    while ((fd = accept4(state->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        daemonConnection *connection = calloc(1, sizeof(*connection));
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+        if (!connection || epoll_ctl(state->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            perror("Error accepting connection");
+            free(connection);
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        connection->registered = true;
+        connection->next = state->connections;
+        if (connection->next) {
+            connection->next->prev = connection;
+        }
+        state->connections = connection;
+        state->accepted++;
+    }
+}
+
+
+/*
+ * Function: finishBatches
+ * -----------------------
+ * Collects the batches the workers have validated and sends their verdicts, once per connection a
+ * batch touched.
+ */
+
+static void finishBatches(daemonState *state) {
+    uint64_t wakes;
+
+    if (read(queue.wakeFd, &wakes, sizeof(wakes)) < 0 && errno != EAGAIN) {
+        perror("Error reading wakeup");
+    }
+    pthread_mutex_lock(&queue.lock);
+    daemonBatch *batch = queue.finished;
+    queue.finished = NULL;
+    pthread_mutex_unlock(&queue.lock);
+
+    while (batch) {
+        daemonBatch *next = batch->next;
+        daemonConnection *touched[DAEMON_MAX_BATCH];
+        size_t count = 0;
+
+        // Connections are listed before any response goes out, since responding may close them
+        state->serial++;
+        for (size_t i = 0; i < batch->count; i++) {
+            daemonRequest *request = batch->requests[i];
+            request->valid = batch->verdicts[i];
+            request->done = true;
+            state->lanes[batch->lane].valid += batch->verdicts[i];
+            if (request->connection->serial != state->serial) {
+                request->connection->serial = state->serial;
+                touched[count++] = request->connection;
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            respond(state, touched[i]);
+        }
+        batch->next = state->spare;
+        state->spare = batch;
+        state->inFlight--;
+        batch = next;
+    }
+}
+
+
+/*
+ * Function: scheduleFlush
+ * -----------------------
+ * Decides, once the I/O thread has handled every ready event, whether each lane's open micro-batch
+ * should go. A batch goes once its oldest request has waited the deadline. It goes at once if recent
+ * waits in its lane gained less than one request on average, as with a few clients each waiting for
+ * its last answer: holding their requests only adds latency. Each batch that waits updates that
+ * average, and the timer is set for the earliest deadline still pending.
+ */
+
+static void scheduleFlush(daemonState *state) {
+    uint64_t now = nowNanos(), earliest = UINT64_MAX;
+
+    for (int id = 0; id < NUM_LANES; id++) {
+        daemonLane *lane = &state->lanes[id];
+        daemonBatch *batch = lane->open;
+        if (!batch || batch->count == 0) {
+            continue;
+        }
+        uint64_t due = batch->opened + state->deadline;
+        if (now >= due) {
+            dispatchBatch(state, (laneId)id, FLUSH_DEADLINE);
+            continue;
+        }
+        if (batch->drained == 0) {
+            batch->drained = batch->count;
+            if (lane->gain < GAIN_ONE && ++lane->probe % DAEMON_PROBE_INTERVAL != 0) {
+                dispatchBatch(state, (laneId)id, FLUSH_EARLY);
+                continue;
+            }
+        }
+        earliest = due < earliest ? due : earliest;
+    }
+    if (earliest != UINT64_MAX && earliest != state->armed) {
+        struct itimerspec timer = {.it_value = {.tv_sec = earliest / 1000000000u, .tv_nsec = earliest % 1000000000u}};
+        timerfd_settime(state->timerFd, TFD_TIMER_ABSTIME, &timer, NULL);
+        state->armed = earliest;
+    }
+}
+
+
+/*
+ * Function: stopDaemon
+ * ----------------------
+ * Begins shutdown: no new connections or requests are taken, and the open batch goes to the workers
+ * so every request already read still gets its response. Clients get DAEMON_STOP_DRAIN_MS to read
+ * them.
+ */
+
+static void stopDaemon(daemonState *state) {
+    state->stopping = true;
+    state->stopBy = nowNanos() + DAEMON_STOP_DRAIN_MS * 1000000ull;
+    epoll_ctl(state->epollFd, EPOLL_CTL_DEL, state->listenFd, NULL);
+    for (daemonConnection *connection = state->connections, *next; connection; connection = next) {
+        next = connection->next;
+        connection->hangup = true;
+        updateConnection(state, connection);
+    }
+    for (int id = 0; id < NUM_LANES; id++) {
+        if (state->lanes[id].open && state->lanes[id].open->count > 0) {
+            dispatchBatch(state, (laneId)id, FLUSH_DEADLINE);
+        }
+    }
+}
+
+
+/*
+ * Function: daemonWorker
+ * ----------------------
+ * Worker thread: validates micro-batches in one pass of the batch kernel and hands them back to the
+ * I/O thread. It takes the first pending batch of the highest lane, so bulk work, which arrives in
+ * batches of at most --max-batch grids, yields to interactive work after every batch.
+ *
+ * arg: The worker's index, for its CPU placement.
+ *
+ * Returns: NULL.
+ */
+
+static void *daemonWorker(void *arg) {
+    if (!placeWorkerThread(&queue.placement, (unsigned)(uintptr_t)arg)) {
+        perror("Error placing a daemon worker");
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&queue.lock);
+        while (!queue.pending[LANE_INTERACTIVE] && !queue.pending[LANE_BULK] && !queue.closed) {
+            pthread_cond_wait(&queue.notEmpty, &queue.lock);
+        }
+        daemonBatch *batch = NULL;
+        for (int id = 0; id < NUM_LANES && !batch; id++) {
+            batch = queue.pending[id];
+            if (batch) {
+                queue.pending[id] = batch->next;
+                if (!queue.pending[id]) {
+                    queue.pendingLast[id] = NULL;
+                }
+            }
+        }
+        pthread_mutex_unlock(&queue.lock);
+        if (!batch) {
+            return NULL;
+        }
+
+        if (queue.puzzle) {
+            validatePuzzleBatch((const gridCell (*)[SIZE][SIZE])batch->grids, batch->count, batch->verdicts);
+        } else {
+            validateBatch((const gridCell (*)[SIZE][SIZE])batch->grids, batch->count, batch->verdicts);
+        }
+
+        pthread_mutex_lock(&queue.lock);
+        batch->next = queue.finished;
+        queue.finished = batch;
+        pthread_mutex_unlock(&queue.lock);
+        uint64_t one = 1;
+        if (write(queue.wakeFd, &one, sizeof(one)) < 0) {
+            perror("Error waking the I/O thread");
+        }
+    }
+}
+
+
+/*
+ * Function: listenSocket
+ * ----------------------
+ * Binds a listening Unix domain socket. A socket file left behind by a daemon that died is replaced;
+ * one that still accepts connections is not.
+ *
+ * Returns: The non-blocking listening socket, or -1 with errno set.
+ */
+
+static int listenSocket(const char *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    bool bound = bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+    if (!bound && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (!live && unlink(path) == 0) {
+            bound = bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+        } else {
+            errno = EADDRINUSE;
+        }
+    }
+    if (!bound || listen(fd, SOMAXCONN) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+
+/*
+ * Function: daemonUsage
+ * ---------------------
+ * Prints the options accepted by the daemon subcommand.
+ */
+
+static void daemonUsage(void) {
+    fprintf(stderr,
+            "Usage: daemon [--deadline US] [--max-batch N] [--threads T] [--puzzle]\n"
+            "              [--cpus LIST | --cpuset LIST] [--io-cpus LIST] <socket_path>\n"
+            "  --deadline US   Longest a request waits for its micro-batch to fill, in microseconds\n"
+            "                  (default %d; 0 batches only requests that arrive together)\n"
+            "  --max-batch N   Most grids per micro-batch, up to %d (default %d)\n"
+            "  --threads T     Worker threads validating batches (default: one per usable CPU but one)\n"
+            "  --puzzle        Check unsolved puzzles: only the givens must not conflict\n"
+            "  --cpus LIST     Pin worker i to the i-th CPU of LIST, e.g. 0-3,8 (cycling when T is larger)\n"
+            "  --cpuset LIST   Let the workers share the CPUs of LIST\n"
+            "  --io-cpus LIST  Run the thread that serves the socket on LIST\n",
+            DAEMON_DEFAULT_DEADLINE_US, DAEMON_MAX_BATCH, DAEMON_MAX_BATCH);
+}
+
+
+/*
+ * Function: daemonMain
+ * --------------------
+ * Entry point of the daemon subcommand. Serves requests on a Unix domain socket until SIGINT or
+ * SIGTERM, then answers every request already read, prints its counters to stderr, and removes the
+ * socket.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on bad options or a socket that cannot be set up.
+ */
+
+int daemonMain(int argc, char *argv[]) {
+    unsigned long deadlineMicros = DAEMON_DEFAULT_DEADLINE_US, maxBatch = DAEMON_MAX_BATCH;
+    unsigned threads = 0;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--deadline") == 0 && i + 1 < argc) {
+            deadlineMicros = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-batch") == 0 && i + 1 < argc) {
+            maxBatch = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--puzzle") == 0) {
+            queue.puzzle = true;
+        } else if (isPlacementOption(argv[i]) && i + 1 < argc) {
+            if (!parsePlacementOption(&queue.placement, argv[i], argv[i + 1])) {
+                fprintf(stderr, "%s: not a list of CPUs this process may use: %s\n", argv[i], argv[i + 1]);
+                return EXIT_FAILURE;
+            }
+            i++;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            daemonUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!path || maxBatch == 0 || maxBatch > DAEMON_MAX_BATCH || deadlineMicros > 1000000) {
+        daemonUsage();
+        return EXIT_FAILURE;
+    }
+    if (threads == 0) {
+        threads = defaultThreads(&queue.placement);
+        threads = threads > 1 ? threads - 1 : 1;
+    }
+
+    daemonState state = {
+        .deadline = deadlineMicros * 1000,
+        .maxBatch = maxBatch,
+        .lanes = {{.gain = 4 * GAIN_ONE}, {.gain = 4 * GAIN_ONE}},
+    };
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    // Blocked before any thread starts, so only the signalfd sees them
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    state.listenFd = listenSocket(path);
+    if (state.listenFd < 0) {
+        fprintf(stderr, "%s: %s\n", path, errno == EADDRINUSE ? "a daemon is already listening" : strerror(errno));
+        return EXIT_FAILURE;
+    }
+    state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    state.timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    state.signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    queue.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event events[DAEMON_MAX_EVENTS];
+    bool ok = state.epollFd >= 0 && state.timerFd >= 0 && state.signalFd >= 0 && queue.wakeFd >= 0;
+    int *watched[] = {&state.listenFd, &state.timerFd, &state.signalFd, &queue.wakeFd};
+    for (size_t i = 0; ok && i < sizeof(watched) / sizeof(watched[0]); i++) {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = watched[i]};
+        ok = epoll_ctl(state.epollFd, EPOLL_CTL_ADD, *watched[i], &event) == 0;
+    }
+
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    unsigned started = 0;
+    ok = ok && workers;
+    while (ok && started < threads &&
+           pthread_create(&workers[started], NULL, daemonWorker, (void *)(uintptr_t)started) == 0) {
+        started++;
+    }
+    if (!ok || started < threads) {
+        perror("Error starting daemon");
+        ok = false;
+    } else {
+        // The workers are started before this thread moves to the I/O CPUs, so they do not inherit them
+        if (!placeIoThread(&queue.placement)) {
+            perror("Error placing the I/O thread");
+        }
+        fprintf(stderr, "%s: listening with %u workers, %lu us deadline, batches of up to %lu\n", path, threads,
+                deadlineMicros, maxBatch);
+    }
+
+    while (ok && !(state.stopping && state.inFlight == 0 && (!state.connections || nowNanos() >= state.stopBy))) {
+        int ready = epoll_wait(state.epollFd, events, DAEMON_MAX_EVENTS, state.stopping ? DAEMON_STOP_POLL_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error waiting for events");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            void *source = events[i].data.ptr;
+            if (source == &state.listenFd) {
+                acceptConnections(&state);
+            } else if (source == &queue.wakeFd) {
+                finishBatches(&state);
+            } else if (source == &state.timerFd) {
+                uint64_t expirations;
+                if (read(state.timerFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                    perror("Error reading timer");
+                }
+                state.armed = 0;
+            } else if (source == &state.signalFd) {
+                struct signalfd_siginfo info;
+                if (read(state.signalFd, &info, sizeof(info)) < 0 && errno != EAGAIN) {
+                    perror("Error reading signal");
+                }
+                if (!state.stopping) {
+                    stopDaemon(&state);
+                }
+            } else if (!((daemonConnection *)source)->retired) {
+                serviceConnection(&state, (daemonConnection *)source, events[i].events);
+            }
+        }
+        scheduleFlush(&state);
+        freeRetired(&state);
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    queue.closed = true;
+    pthread_cond_broadcast(&queue.notEmpty);
+    pthread_mutex_unlock(&queue.lock);
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    outputBuffer report;
+    if (ok && outputInit(&report, STDERR_FILENO, 4096)) {
+        writeStats(&state, &report);
+        outputFlush(&report);
+        outputFree(&report);
+    }
+
+    while (state.connections) {
+        daemonConnection *connection = state.connections;
+        while (connection->first) {
+            daemonRequest *request = connection->first;
+            connection->first = request->next;
+            free(request);
+        }
+        closeConnection(&state, connection);
+    }
+    freeRetired(&state);
+    for (int id = 0; id < NUM_LANES; id++) {
+        free(state.lanes[id].open);
+    }
+    for (daemonBatch *batch = state.spare, *next; batch; batch = next) {
+        next = batch->next;
+        free(batch);
+    }
+    for (daemonRequest *request = state.spareRequests, *next; request; request = next) {
+        next = request->next;
+        free(request);
+    }
+    int fds[] = {state.epollFd, state.timerFd, state.signalFd, queue.wakeFd, state.listenFd};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    unlink(path);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
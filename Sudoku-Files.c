@@ -0,0 +1,590 @@
+/*
+ * File: Sudoku-Files.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Validation of many puzzle files at once. One thread expands the command-line paths
+ *              (files, directories walked recursively, glob patterns, and @list files) into a bounded
+ *              queue while a pool of workers reads, parses, and validates the files it contains. Workers
+ *              read through io_uring when the kernel supports it and with plain read calls otherwise.
+ */
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// Paths the enumerator may queue ahead of the workers.
+#define PATH_QUEUE_CAPACITY 4096
+
+// Size of each worker's output buffer; it is flushed once it holds this much.
+#define FILES_OUTPUT_BYTES (64 * 1024)
+
+// Files each io_uring worker keeps in flight.
+#define FILES_URING_DEPTH 32
+
+// Struct for the bounded queue of paths between the enumerator and the workers.
+typedef struct {
+    char *slots[PATH_QUEUE_CAPACITY];
+    size_t head;
+    size_t count;
+    bool closed;            // Set by the enumerator once every path has been queued
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} pathQueue;
+
+// Struct holding one worker's private state and counts, summed after the run.
+typedef struct {
+    pthread_t tid;
+    ioBackend backend;
+    outputBuffer out;
+    char *data;             // Read buffer, grown as needed and reused across files
+    size_t capacity;
+    size_t valid;
+    size_t invalid;
+    size_t unreadable;
+} fileWorker;
+
+// Struct for the arguments of the enumerator thread.
+typedef struct {
+    char **paths;
+    int count;
+    size_t unreadable;      // Paths that could not be expanded
+} enumeratorArgs;
+
+static pathQueue queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .notEmpty = PTHREAD_COND_INITIALIZER,
+    .notFull = PTHREAD_COND_INITIALIZER,
+};
+
+// Mutex that keeps flushes from different workers from interleaving on stdout.
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * Function: isMultiPath
+ * ---------------------
+ * Decides whether a lone command-line path needs the multi-file pipeline rather than the classic
+ * single-grid report: directories, glob patterns, and @list files do.
+ *
+ * path: The path argument.
+ *
+ * Returns: true if the path expands to a set of files.
+ */
+
+bool isMultiPath(const char *path) {
+    struct stat st;
+    if (path[0] == '@' || strpbrk(path, "*?[") != NULL) {
+        return true;
+    }
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+/*
+ * Function: queuePush
+ * -------------------
+ * Adds a path to the queue, waiting while it is full. The queue takes ownership of the string.
+ */
+
+static void queuePush(char *path) {
+    pthread_mutex_lock(&queue.lock);
+    while (queue.count == PATH_QUEUE_CAPACITY) {
+        pthread_cond_wait(&queue.notFull, &queue.lock);
+    }
+    queue.slots[(queue.head + queue.count++) % PATH_QUEUE_CAPACITY] = path;
+    pthread_cond_signal(&queue.notEmpty);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+
+/*
+ * Function: queueNext
+ * -------------------
+ * Takes the next path.
+ *
+ * wait: Whether to wait while the queue is empty but still open.
+ * done: Set to true once the queue is closed and drained.
+ *
+ * Returns: A path the caller must free, or NULL if none is available.
+ */
+
+static char *queueNext(bool wait, bool *done) {
+    pthread_mutex_lock(&queue.lock);
+    while (wait && queue.count == 0 && !queue.closed) {
+        pthread_cond_wait(&queue.notEmpty, &queue.lock);
+    }
+    char *path = NULL;
+    if (queue.count > 0) {
+        path = queue.slots[queue.head];
+        queue.head = (queue.head + 1) % PATH_QUEUE_CAPACITY;
+        queue.count--;
+        pthread_cond_signal(&queue.notFull);
+    }
+    *done = queue.count == 0 && queue.closed;
+    pthread_mutex_unlock(&queue.lock);
+    return path;
+}
+
+
+/*
+ * Function: queueClose
+ * --------------------
+ * Marks the end of the input and wakes every waiting worker.
+ */
+
+static void queueClose(void) {
+    pthread_mutex_lock(&queue.lock);
+    queue.closed = true;
+    pthread_cond_broadcast(&queue.notEmpty);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+
+/*
+ * Function: reportUnreadable
+ * --------------------------
+ * Prints why a path could not be used and counts it.
+ */
+
+static void reportUnreadable(const char *path, int error, size_t *unreadable) {
+    fprintf(stderr, "%s: %s\n", path, strerror(error));
+    (*unreadable)++;
+}
+
+
+static void expandPath(const char *path, size_t *unreadable);
+
+
+/*
+ * Function: walkDirectory
+ * -----------------------
+ * Queues every regular file below a directory, descending into subdirectories. Symlinks to files are
+ * followed, but symlinks to directories are not, so a link back up the tree cannot make the walk visit
+ * files over and over.
+ *
+ * dirPath: The directory to walk.
+ * unreadable: Counter for entries that could not be read.
+ *
+ * Returns: void.
+ */
+
+static void walkDirectory(const char *dirPath, size_t *unreadable) {
+    DIR *dir = opendir(dirPath);
+    if (!dir) {
+        reportUnreadable(dirPath, errno, unreadable);
+        return;
+    }
+
+    size_t baseLength = strlen(dirPath);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        size_t length = baseLength + 1 + strlen(entry->d_name) + 1;
+        char *child = malloc(length);
+        if (!child) {
+            reportUnreadable(entry->d_name, ENOMEM, unreadable);
+            continue;
+        }
+        snprintf(child, length, "%s%s%s", dirPath, dirPath[baseLength - 1] == '/' ? "" : "/", entry->d_name);
+
+        if (entry->d_type == DT_REG) {
+            queuePush(child);
+        } else if (entry->d_type == DT_DIR) {
+            walkDirectory(child, unreadable);
+            free(child);
+        } else {
+            // Symlinks and file systems without d_type need a stat
+            struct stat st;
+            bool link = lstat(child, &st) == 0 && S_ISLNK(st.st_mode);
+            if ((link ? stat(child, &st) : lstat(child, &st)) != 0) {
+                reportUnreadable(child, errno, unreadable);
+                free(child);
+            } else if (S_ISREG(st.st_mode)) {
+                queuePush(child);
+            } else {
+                if (S_ISDIR(st.st_mode) && !link) {
+                    walkDirectory(child, unreadable);
+                }
+                free(child);
+            }
+        }
+    }
+    closedir(dir);
+}
+
+
+/*
+ * Function: expandPath
+ * --------------------
+ * Queues the files a single path stands for: itself if it is a file, everything below it if it is
+ * a directory.
+ *
+ * path: The path to expand.
+ * unreadable: Counter for paths that could not be used.
+ *
+ * Returns: void.
+ */
+
+static void expandPath(const char *path, size_t *unreadable) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        reportUnreadable(path, errno, unreadable);
+    } else if (S_ISDIR(st.st_mode)) {
+        walkDirectory(path, unreadable);
+    } else if (S_ISREG(st.st_mode)) {
+        char *copy = strdup(path);
+        if (copy) {
+            queuePush(copy);
+        } else {
+            reportUnreadable(path, ENOMEM, unreadable);
+        }
+    }
+}
+
+
+/*
+ * Function: expandArgument
+ * ------------------------
+ * Expands one command-line argument. "@FILE" reads further arguments from FILE, one per line; an
+ * argument with glob characters is matched with glob(3); anything else is a plain path.
+ *
+ * arg: The argument text.
+ * unreadable: Counter for arguments that could not be used.
+ *
+ * Returns: void.
+ */
+
+static void expandArgument(const char *arg, size_t *unreadable) {
+    if (arg[0] == '@') {
+        FILE *list = fopen(arg + 1, "r");
+        if (!list) {
+            reportUnreadable(arg + 1, errno, unreadable);
+            return;
+        }
+        char *line = NULL;
+        size_t size = 0;
+        ssize_t length;
+        while ((length = getline(&line, &size, list)) > 0) {
+            while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+                line[--length] = '\0';
+            }
+            if (length > 0 && line[0] != '@') {
+                expandArgument(line, unreadable);
+            }
+        }
+        free(line);
+        fclose(list);
+        return;
+    }
+
+    if (strpbrk(arg, "*?[") == NULL) {
+        expandPath(arg, unreadable);
+        return;
+    }
+
+    glob_t matches;
+    int status = glob(arg, 0, NULL, &matches);
+    if (status == GLOB_NOMATCH) {
+        reportUnreadable(arg, ENOENT, unreadable);
+    } else if (status != 0) {
+        reportUnreadable(arg, EIO, unreadable);
+    } else {
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            expandPath(matches.gl_pathv[i], unreadable);
+        }
+    }
+    globfree(&matches);
+}
+
+
+/*
+ * Function: enumeratorThread
+ * --------------------------
+ * Expands every argument into the queue, then closes it.
+ *
+ * arg: Pointer to an enumeratorArgs.
+ *
+ * Returns: NULL.
+ */
+
+static void *enumeratorThread(void *arg) {
+    enumeratorArgs *args = (enumeratorArgs *)arg;
+    for (int i = 0; i < args->count; i++) {
+        expandArgument(args->paths[i], &args->unreadable);
+    }
+    queueClose();
+    return NULL;
+}
+
+
+/*
+ * Function: readWholeFile
+ * -----------------------
+ * Reads a file into a reusable buffer with plain open/read/close.
+ *
+ * path: The file to read.
+ * data, capacity: The caller's buffer, grown with realloc when the file does not fit.
+ * length: Receives the number of bytes read.
+ *
+ * Returns: 0 on success, or an errno value.
+ */
+
+int readWholeFile(const char *path, char **data, size_t *capacity, size_t *length) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+
+    *length = 0;
+    while (true) {
+        if (*length == *capacity) {
+            size_t grown = *capacity ? *capacity * 2 : 4096;
+            char *bigger = realloc(*data, grown);
+            if (!bigger) {
+                close(fd);
+                return ENOMEM;
+            }
+            *data = bigger;
+            *capacity = grown;
+        }
+        ssize_t n = read(fd, *data + *length, *capacity - *length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int error = errno;
+            close(fd);
+            return error;
+        }
+        if (n == 0) {
+            break;
+        }
+        *length += (size_t)n;
+    }
+    close(fd);
+    return 0;
+}
+
+
+/*
+ * Function: flushWorkerOutput
+ * ---------------------------
+ * Writes a worker's buffered lines to stdout while holding the output lock, so lines from different
+ * workers never interleave.
+ */
+
+static void flushWorkerOutput(fileWorker *worker) {
+    pthread_mutex_lock(&outputLock);
+    outputFlush(&worker->out);
+    pthread_mutex_unlock(&outputLock);
+}
+
+
+/*
+ * Function: recordVerdict
+ * -----------------------
+ * Appends the verdict line for one file to the worker's buffer and counts it. Shared with the other
+ * ingestion backends so every backend reports in the same format.
+ *
+ * worker: The worker that validated the file.
+ * path: The file.
+ * text, length: The file contents.
+ *
+ * Returns: void.
+ */
+
+static void recordVerdict(fileWorker *worker, const char *path, const char *text, size_t length) {
+    gridCell sudoku[SIZE][SIZE];
+
+    if (!parseSudoku(text, length, sudoku)) {
+        fprintf(stderr, "%s: not a %dx%d grid\n", path, SIZE, SIZE);
+        worker->unreadable++;
+        return;
+    }
+
+    bool valid = validateBitmask(sudoku);
+
+    if (valid) {
+        worker->valid++;
+    } else {
+        worker->invalid++;
+    }
+    if (worker->out.length + strlen(path) + 40 > worker->out.capacity) {
+        flushWorkerOutput(worker);
+    }
+    outputString(&worker->out, path);
+    outputString(&worker->out, valid ? " contains a valid solution\n" : " contains an INVALID solution\n");
+}
+
+
+/*
+ * Function: readAndRecord
+ * -----------------------
+ * Reads a file with plain system calls, validates it, and frees its path.
+ */
+
+static void readAndRecord(fileWorker *worker, char *path) {
+    size_t length;
+    int error = readWholeFile(path, &worker->data, &worker->capacity, &length);
+
+    if (error) {
+        reportUnreadable(path, error, &worker->unreadable);
+    } else {
+        recordVerdict(worker, path, worker->data, length);
+    }
+    free(path);
+}
+
+
+/*
+ * Function: uringSink
+ * -------------------
+ * Receives a file read by the io_uring backend and validates it.
+ */
+
+static void uringSink(void *context, char *path, const char *data, size_t length, int error) {
+    fileWorker *worker = (fileWorker *)context;
+    if (error) {
+        reportUnreadable(path, error, &worker->unreadable);
+    } else {
+        recordVerdict(worker, path, data, length);
+    }
+    free(path);
+}
+
+
+/*
+ * Function: fileWorkerThread
+ * --------------------------
+ * Reads, parses, and validates queued files until the queue is drained. An io_uring worker batches
+ * its reads through a private ring; if the ring cannot be created the worker reads files itself.
+ *
+ * arg: Pointer to the worker's fileWorker.
+ *
+ * Returns: NULL.
+ */
+
+static void *fileWorkerThread(void *arg) {
+    fileWorker *worker = (fileWorker *)arg;
+
+    if (worker->backend != IO_THREADS) {
+        uringReader *reader = uringCreate(FILES_URING_DEPTH);
+        if (reader) {
+            bool ok = uringIngest(reader, queueNext, uringSink, worker);
+            // Files the ring dropped are read here; the rest of the queue goes the same way below
+            char *unfinished;
+            while (!ok && (unfinished = uringTakeUnfinished(reader)) != NULL) {
+                readAndRecord(worker, unfinished);
+            }
+            uringDestroy(reader);
+            if (ok) {
+                flushWorkerOutput(worker);
+                return NULL;
+            }
+        } else if (worker->backend == IO_URING) {
+            fprintf(stderr, "io_uring unavailable (%s); using the thread-based reader\n", strerror(errno));
+        }
+    }
+
+    char *path;
+    bool done = false;
+    while (!done) {
+        path = queueNext(true, &done);
+        if (path) {
+            readAndRecord(worker, path);
+        }
+    }
+    flushWorkerOutput(worker);
+    return NULL;
+}
+
+
+/*
+ * Function: validatePaths
+ * -----------------------
+ * Validates every file named by the arguments across a worker pool and prints one verdict line per file
+ * followed by a consolidated summary.
+ *
+ * paths: Files, directories, glob patterns, or @list files.
+ * count: Number of arguments.
+ * threads: Worker threads, or 0 for one per usable CPU within any cgroup CPU quota.
+ * backend: How workers read files; IO_AUTO uses io_uring where available.
+ *
+ * Returns: EXIT_ALL_VALID if every file holds a valid solution, EXIT_SOME_INVALID if any holds an invalid
+ *          one, or EXIT_SOME_UNREADABLE if any path could not be read or parsed.
+ */
+
+int validatePaths(char *paths[], int count, unsigned threads, ioBackend backend) {
+    if (threads == 0) {
+        threads = defaultThreads(NULL);
+    }
+
+    fileWorker *workers = calloc(threads, sizeof(*workers));
+    if (!workers) {
+        perror("Error allocating workers");
+        return EXIT_SOME_UNREADABLE;
+    }
+
+    enumeratorArgs args = {.paths = paths, .count = count};
+    pthread_t enumerator;
+    int error = pthread_create(&enumerator, NULL, enumeratorThread, &args);
+    if (error != 0) {
+        fprintf(stderr, "Error starting path enumerator: %s\n", strerror(error));
+        free(workers);
+        return EXIT_SOME_UNREADABLE;
+    }
+
+    unsigned started = 0;
+    for (; started < threads; started++) {
+        workers[started].backend = backend;
+        if (!outputInit(&workers[started].out, STDOUT_FILENO, FILES_OUTPUT_BYTES) ||
+            pthread_create(&workers[started].tid, NULL, fileWorkerThread, &workers[started]) != 0) {
+            outputFree(&workers[started].out);
+            break;
+        }
+    }
+    if (started == 0) {
+        // Nobody will drain the queue; do it here so the enumerator can finish
+        fileWorker *self = &workers[0];
+        self->backend = IO_THREADS;
+        if (outputInit(&self->out, STDOUT_FILENO, FILES_OUTPUT_BYTES)) {
+            fileWorkerThread(self);
+            started = 1;
+        }
+    }
+
+    pthread_join(enumerator, NULL);
+    size_t valid = 0, invalid = 0, unreadable = args.unreadable;
+    for (unsigned t = 0; t < threads; t++) {
+        if (t < started && workers[t].tid) {
+            pthread_join(workers[t].tid, NULL);
+        }
+        valid += workers[t].valid;
+        invalid += workers[t].invalid;
+        unreadable += workers[t].unreadable;
+        outputFree(&workers[t].out);
+        free(workers[t].data);
+    }
+    free(workers);
+
+    printf("%zu files: %zu valid, %zu INVALID, %zu unreadable\n", valid + invalid + unreadable, valid, invalid,
+           unreadable);
+
+    if (unreadable > 0) {
+        return EXIT_SOME_UNREADABLE;
+    }
+    return invalid > 0 ? EXIT_SOME_INVALID : EXIT_ALL_VALID;
+}
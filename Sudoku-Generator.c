@@ -0,0 +1,438 @@
+/*
+ * File: Sudoku-Generator.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Corpus generator for load testing. Every grid is a seed solution put through random
+ *              validity-preserving symmetry transforms, optionally followed by one controlled defect.
+ *              Grids are derived from (seed, index) alone, so output is identical for any thread count.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+// The seed grid, the band and stack permutations, and the defects below are written for 9x9 grids.
+#if BOX_ROWS != 3 || BOX_COLS != 3
+#error "Sudoku-Generator.c supports only 3x3 boxes"
+#endif
+
+// Grids each generator thread produces per round before the round is written out.
+#define GEN_ROUND_GRIDS 16384
+
+// Upper bound on the text form of one grid: two characters and a separator per cell, plus a blank line.
+#define GEN_TEXT_GRID_BYTES (SIZE * SIZE * 3 + 1)
+
+// Solved grid every generated grid is derived from.
+static const gridCell seedGrid[SIZE][SIZE] = {
+    {6, 2, 4, 5, 3, 9, 1, 8, 7},
+    {5, 1, 9, 7, 2, 8, 6, 3, 4},
+    {8, 3, 7, 6, 1, 4, 2, 9, 5},
+    {1, 4, 3, 8, 6, 5, 7, 2, 9},
+    {9, 5, 8, 2, 4, 7, 3, 6, 1},
+    {7, 6, 2, 3, 9, 1, 4, 5, 8},
+    {3, 7, 1, 9, 5, 6, 8, 4, 2},
+    {4, 9, 6, 1, 8, 2, 5, 7, 3},
+    {2, 8, 5, 4, 7, 3, 9, 1, 6},
+};
+
+// Names accepted by --invalid, indexed by invalidKind.
+static const char *invalidNames[] = {"none", "swap", "range", "row", "column", "subgrid", "mixed"};
+
+// Struct describing the slice of a round one generator thread is responsible for.
+typedef struct {
+    uint64_t seed;
+    uint64_t first;       // Index of the first grid in the slice
+    size_t count;         // Number of grids in the slice
+    invalidKind kind;
+    unsigned percent;     // Share of grids that receive a defect
+    bool binary;
+    unsigned char *buffer;
+    size_t length;        // Bytes written to buffer
+} generatorTask;
+
+
+/*
+ * Function: splitMix
+ * ------------------
+ * Advances a splitmix64 generator. Used to derive an independent stream for every grid index.
+ *
+ * state: Generator state, updated in place.
+ *
+ * Returns: The next pseudo-random value.
+ */
+
+static uint64_t splitMix(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+
+/*
+ * Function: shuffle
+ * -----------------
+ * Fisher-Yates shuffle of a small int array.
+ */
+
+static void shuffle(int *values, int n, uint64_t *state) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(splitMix(state) % (uint64_t)(i + 1));
+        int tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+
+/*
+ * Function: parseInvalidKind
+ * --------------------------
+ * Maps a --invalid argument to its invalidKind.
+ *
+ * name: The argument text.
+ *
+ * Returns: The matching kind, or -1 if the name is unknown.
+ */
+
+int parseInvalidKind(const char *name) {
+    for (size_t i = 0; i < sizeof(invalidNames) / sizeof(invalidNames[0]); i++) {
+        if (strcmp(name, invalidNames[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+
+/*
+ * Function: injectDefect
+ * ----------------------
+ * Breaks a valid grid in one controlled way.
+ *
+ * grid: The grid to modify.
+ * kind: Which defect to introduce. INVALID_MIXED picks one of the others at random.
+ * state: Generator state.
+ *
+ * Returns: void.
+ */
+
+static void injectDefect(gridCell grid[SIZE][SIZE], invalidKind kind, uint64_t *state) {
+    if (kind == INVALID_MIXED) {
+        kind = (invalidKind)(INVALID_SWAP + splitMix(state) % (INVALID_MIXED - INVALID_SWAP));
+    }
+
+    int r = (int)(splitMix(state) % SIZE);
+    int c = (int)(splitMix(state) % SIZE);
+    int other = (int)(1 + splitMix(state) % (SIZE - 1)); // Offset to a second, distinct cell of the unit
+
+    switch (kind) {
+        case INVALID_SWAP: {
+            // Swap two cells of one row; the row stays a permutation but two columns break
+            int c2 = (c + other) % SIZE;
+            int tmp = grid[r][c];
+            grid[r][c] = grid[r][c2];
+            grid[r][c2] = tmp;
+            break;
+        }
+        case INVALID_RANGE:
+            grid[r][c] = (splitMix(state) & 1) ? 0 : SIZE + 1;
+            break;
+        case INVALID_ROW:
+            grid[r][c] = grid[r][(c + other) % SIZE];
+            break;
+        case INVALID_COLUMN:
+            grid[r][c] = grid[(r + other) % SIZE][c];
+            break;
+        case INVALID_SUBGRID: {
+            // Walk to another cell of the same 3x3 subgrid
+            int cell = (r % 3) * 3 + c % 3;
+            int target = (cell + other) % SIZE;
+            grid[r][c] = grid[r - r % 3 + target / 3][c - c % 3 + target % 3];
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+
+/*
+ * Function: generateGrid
+ * ----------------------
+ * Produces grid number `index` of the stream identified by `seed`. The seed solution is relabelled,
+ * its bands, stacks, rows within bands and columns within stacks are permuted, and it is transposed
+ * half of the time; all of these keep the grid valid. A defect is then injected into `percent` percent
+ * of the grids when `kind` is not INVALID_NONE.
+ *
+ * grid: Receives the generated grid.
+ * seed: Stream seed.
+ * index: Position of the grid in the stream.
+ * kind: Defect to inject into the selected grids.
+ * percent: Share of grids (0..100) that receive a defect.
+ *
+ * Returns: void.
+ */
+
+void generateGrid(gridCell grid[SIZE][SIZE], uint64_t seed, uint64_t index, invalidKind kind, unsigned percent) {
+    uint64_t state = seed ^ (index * 0xD1B54A32D192ED03ull);
+    int relabel[SIZE], bands[3], stacks[3], rowMap[SIZE], colMap[SIZE];
+
+    for (int i = 0; i < SIZE; i++) {
+        relabel[i] = i + 1;
+    }
+    shuffle(relabel, SIZE, &state);
+
+    for (int i = 0; i < 3; i++) {
+        bands[i] = i;
+        stacks[i] = i;
+    }
+    shuffle(bands, 3, &state);
+    shuffle(stacks, 3, &state);
+
+    for (int b = 0; b < 3; b++) {
+        int rows[3] = {0, 1, 2}, cols[3] = {0, 1, 2};
+        shuffle(rows, 3, &state);
+        shuffle(cols, 3, &state);
+        for (int i = 0; i < 3; i++) {
+            rowMap[b * 3 + i] = bands[b] * 3 + rows[i];
+            colMap[b * 3 + i] = stacks[b] * 3 + cols[i];
+        }
+    }
+
+    bool transpose = splitMix(&state) & 1;
+    for (int r = 0; r < SIZE; r++) {
+        for (int c = 0; c < SIZE; c++) {
+            int value = transpose ? seedGrid[colMap[c]][rowMap[r]] : seedGrid[rowMap[r]][colMap[c]];
+            grid[r][c] = relabel[value - 1];
+        }
+    }
+
+    if (kind != INVALID_NONE && splitMix(&state) % 100 < percent) {
+        injectDefect(grid, kind, &state);
+    }
+}
+
+
+/*
+ * Function: writeCorpusHeader
+ * ---------------------------
+ * Writes the header that starts a binary corpus file.
+ *
+ * file: Destination stream.
+ *
+ * Returns: true on success, false on a write error.
+ */
+
+bool writeCorpusHeader(FILE *file) {
+    unsigned char header[CORPUS_HEADER_SIZE] = {'S', 'D', 'K', 'B', CORPUS_VERSION, SIZE, 0, 0};
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+
+/*
+ * Function: generatorThread
+ * -------------------------
+ * Generates one slice of a round and serialises it into the task's private buffer, so threads never
+ * share output state and the main thread can write the buffers back in index order.
+ *
+ * arg: Pointer to a generatorTask.
+ *
+ * Returns: NULL.
+ */
+
+static void *generatorThread(void *arg) {
+    generatorTask *task = (generatorTask *)arg;
+    unsigned char *out = task->buffer;
+    gridCell grid[SIZE][SIZE];
+
+    for (size_t n = 0; n < task->count; n++) {
+        generateGrid(grid, task->seed, task->first + n, task->kind, task->percent);
+
+        // The binary layout is the in-memory one
+        if (task->binary) {
+            memcpy(out, grid, sizeof(grid));
+            out += sizeof(grid);
+            continue;
+        }
+        for (int r = 0; r < SIZE; r++) {
+            for (int c = 0; c < SIZE; c++) {
+                int value = grid[r][c];
+                if (value >= 10) {
+                    *out++ = (unsigned char)('0' + value / 10);
+                }
+                *out++ = (unsigned char)('0' + value % 10);
+                *out++ = c + 1 < SIZE ? ' ' : '\n';
+            }
+        }
+        *out++ = '\n';
+    }
+
+    task->length = (size_t)(out - task->buffer);
+    return NULL;
+}
+
+
+/*
+ * Function: genUsage
+ * ------------------
+ * Prints the options accepted by the gen subcommand.
+ */
+
+static void genUsage(void) {
+    fprintf(stderr,
+            "Usage: gen [--count N] [--seed S] [--threads T] [--invalid KIND] [--invalid-percent P]\n"
+            "           [--format text|binary] [-o FILE] [--cpus LIST | --cpuset LIST] [--io-cpus LIST]\n"
+            "  --count N            Number of grids to generate (default 1000)\n"
+            "  --seed S             Stream seed; the same seed always yields the same corpus (default 1)\n"
+            "  --threads T          Generator threads (default: one per usable CPU, within any cgroup CPU quota)\n"
+            "  --invalid KIND       Defect to inject: none, swap, range, row, column, subgrid, mixed\n"
+            "  --invalid-percent P  Share of grids that receive the defect (default 50)\n"
+            "  --format F           text (default) or binary\n"
+            "  -o FILE              Output file (default stdout)\n"
+            "  --cpus LIST          Pin thread i to the i-th CPU of LIST, e.g. 0-3,8 (cycling when T is larger)\n"
+            "  --cpuset LIST        Let the generator threads share the CPUs of LIST\n"
+            "  --io-cpus LIST       Run the thread that writes the corpus on LIST\n");
+}
+
+
+/*
+ * Function: genMain
+ * -----------------
+ * Entry point of the gen subcommand. Generates the corpus in rounds: each round every thread fills its
+ * own buffer, then the buffers are written out in order. Memory stays bounded by the round size.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on bad options or an output error.
+ */
+
+int genMain(int argc, char *argv[]) {
+    uint64_t count = 1000, seed = 1;
+    unsigned threads = 0, percent = 50;
+    cpuPlacement placement = {0};
+    invalidKind kind = INVALID_NONE;
+    bool binary = false;
+    const char *outputFile = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (threads == 0) {
+                genUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (isPlacementOption(argv[i]) && i + 1 < argc) {
+            if (!parsePlacementOption(&placement, argv[i], argv[i + 1])) {
+                fprintf(stderr, "%s: not a list of CPUs this process may use: %s\n", argv[i], argv[i + 1]);
+                return EXIT_FAILURE;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--invalid-percent") == 0 && i + 1 < argc) {
+            percent = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--invalid") == 0 && i + 1 < argc) {
+            int parsed = parseInvalidKind(argv[++i]);
+            if (parsed < 0) {
+                fprintf(stderr, "Unknown defect kind: %s\n", argv[i]);
+                genUsage();
+                return EXIT_FAILURE;
+            }
+            kind = (invalidKind)parsed;
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *format = argv[++i];
+            if (strcmp(format, "binary") == 0) {
+                binary = true;
+            } else if (strcmp(format, "text") != 0) {
+                genUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else {
+            genUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (percent > 100) {
+        genUsage();
+        return EXIT_FAILURE;
+    }
+    if (threads == 0) {
+        threads = defaultThreads(&placement);
+    }
+
+    FILE *out = outputFile ? fopen(outputFile, "wb") : stdout;
+    if (!out) {
+        perror("Error opening output file");
+        return EXIT_FAILURE;
+    }
+    if (binary && !writeCorpusHeader(out)) {
+        perror("Error writing output");
+        if (outputFile) {
+            fclose(out);
+        }
+        return EXIT_FAILURE;
+    }
+
+    size_t gridBytes = binary ? SIZE * SIZE : GEN_TEXT_GRID_BYTES;
+    workPool *pool = poolCreate(threads, &placement);
+    if (!placeIoThread(&placement)) {
+        perror("Error placing the I/O thread");
+    }
+    generatorTask *tasks = calloc(threads, sizeof(*tasks));
+    bool ok = pool && tasks;
+    for (unsigned t = 0; ok && t < threads; t++) {
+        tasks[t].buffer = malloc(GEN_ROUND_GRIDS * gridBytes);
+        ok = tasks[t].buffer != NULL;
+    }
+    if (!ok) {
+        perror("Error allocating generator buffers");
+    }
+
+    for (uint64_t next = 0; ok && next < count;) {
+        unsigned started = 0;
+        for (; started < threads && next < count; started++) {
+            generatorTask *task = &tasks[started];
+            task->seed = seed;
+            task->first = next;
+            task->count = count - next < GEN_ROUND_GRIDS ? (size_t)(count - next) : GEN_ROUND_GRIDS;
+            task->kind = kind;
+            task->percent = percent;
+            task->binary = binary;
+            next += task->count;
+            poolSubmit(pool, generatorThread, task);
+        }
+        poolWait(pool);
+        for (unsigned t = 0; t < started; t++) {
+            if (ok && fwrite(tasks[t].buffer, 1, tasks[t].length, out) != tasks[t].length) {
+                perror("Error writing output");
+                ok = false;
+            }
+        }
+    }
+
+    if (tasks) {
+        for (unsigned t = 0; t < threads; t++) {
+            free(tasks[t].buffer);
+        }
+    }
+    free(tasks);
+    poolDestroy(pool);
+    bool written = fflush(out) == 0;
+    if (outputFile && fclose(out) != 0) {
+        written = false;
+    }
+    if (!written) {
+        perror("Error writing output");
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,263 @@
+/*
+ * File: Sudoku-Incremental.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Incremental validation for grids that change one cell at a time. Each row, column, and
+ *              subgrid keeps occupancy counters, so setting a cell touches only the three units it
+ *              belongs to instead of re-running all 27 checks. Also provides the edit subcommand, which
+ *              applies "row col value" edits read from stdin and reports the grid state after each one.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+#define ALL_NUMBERS ((1u << SIZE) - 1)
+
+
+/*
+ * Function: incrementalInit
+ * -------------------------
+ * Resets a grid to all cells empty.
+ *
+ * grid: The grid to reset.
+ *
+ * Returns: void.
+ */
+
+void incrementalInit(incrementalGrid *grid) {
+    memset(grid, 0, sizeof(*grid));
+}
+
+
+/*
+ * Function: unitAdd
+ * -----------------
+ * Records one more occurrence of a number in a unit.
+ */
+
+static void unitAdd(incrementalGrid *grid, int unit, int value) {
+    if (grid->counts[unit][value]++ > 0) {
+        grid->duplicates[unit]++;
+        grid->totalDuplicates++;
+    }
+    grid->present[unit] |= (uint16_t)(1u << (value - 1));
+}
+
+
+/*
+ * Function: unitRemove
+ * --------------------
+ * Records one occurrence fewer of a number in a unit.
+ */
+
+static void unitRemove(incrementalGrid *grid, int unit, int value) {
+    if (--grid->counts[unit][value] > 0) {
+        grid->duplicates[unit]--;
+        grid->totalDuplicates--;
+    } else {
+        grid->present[unit] &= (uint16_t)~(1u << (value - 1));
+    }
+}
+
+
+/*
+ * Function: incrementalSetCell
+ * ----------------------------
+ * Places a number in a cell, replacing whatever was there, and updates the row, column, and subgrid
+ * counters of that cell.
+ *
+ * params:
+ *      grid: The grid to update.
+ *      row, col: Zero-based cell coordinates.
+ *      value: The number to place (1..SIZE), or 0 to clear the cell.
+ *
+ * Returns: true on success, false if the coordinates or the number are out of range (the grid is unchanged).
+ */
+
+bool incrementalSetCell(incrementalGrid *grid, int row, int col, int value) {
+    if ((unsigned)row >= SIZE || (unsigned)col >= SIZE || (unsigned)value > SIZE) {
+        return false;
+    }
+
+    const unsigned char *units = cellUnits[row * SIZE + col];
+    int old = grid->cells[row][col];
+    if (old == value) {
+        return true;
+    }
+    if (old) {
+        for (int i = 0; i < 3; i++) {
+            unitRemove(grid, units[i], old);
+        }
+        grid->filled--;
+    }
+    if (value) {
+        for (int i = 0; i < 3; i++) {
+            unitAdd(grid, units[i], value);
+        }
+        grid->filled++;
+    }
+    grid->cells[row][col] = (unsigned char)value;
+    return true;
+}
+
+
+/*
+ * Function: incrementalLoad
+ * -------------------------
+ * Resets a grid and fills it from a full grid, where 0 marks an empty cell.
+ *
+ * params:
+ *      grid: The grid to fill.
+ *      sudoku: The 9x9 source grid.
+ *
+ * Returns: true on success, false if a cell holds a number outside 0..SIZE (that cell is left empty).
+ */
+
+bool incrementalLoad(incrementalGrid *grid, const gridCell sudoku[SIZE][SIZE]) {
+    bool ok = true;
+
+    incrementalInit(grid);
+    for (int r = 0; r < SIZE; r++) {
+        for (int c = 0; c < SIZE; c++) {
+            ok = incrementalSetCell(grid, r, c, sudoku[r][c]) && ok;
+        }
+    }
+    return ok;
+}
+
+
+/*
+ * Function: incrementalUnitValid
+ * ------------------------------
+ * Reports whether one row, column, or subgrid holds every number exactly once, the same condition
+ * checkRow, checkColumn, and checkSubgrid test.
+ *
+ * grid: The grid to inspect.
+ * unit: Unit index in results order (rows, then columns, then subgrids).
+ *
+ * Returns: true if the unit is complete and free of duplicates, false otherwise.
+ */
+
+bool incrementalUnitValid(const incrementalGrid *grid, int unit) {
+    return grid->present[unit] == ALL_NUMBERS && grid->duplicates[unit] == 0;
+}
+
+
+/*
+ * Function: incrementalConsistent
+ * -------------------------------
+ * Reports whether no number repeats within any row, column, or subgrid. Empty cells are allowed.
+ */
+
+bool incrementalConsistent(const incrementalGrid *grid) {
+    return grid->totalDuplicates == 0;
+}
+
+
+/*
+ * Function: incrementalComplete
+ * -----------------------------
+ * Reports whether every cell is filled and the grid is consistent, i.e. it is a valid solution.
+ */
+
+bool incrementalComplete(const incrementalGrid *grid) {
+    return grid->filled == SIZE * SIZE && grid->totalDuplicates == 0;
+}
+
+
+/*
+ * Function: printState
+ * --------------------
+ * Prints the state of the grid after an edit: complete, consistent, or the units holding duplicates.
+ *
+ * grid: The grid to report on.
+ *
+ * Returns: void.
+ */
+
+static void printState(const incrementalGrid *grid) {
+    static const char *kinds[3] = {"row", "column", "subgrid"};
+
+    if (incrementalComplete(grid)) {
+        printf("complete\n");
+    } else if (incrementalConsistent(grid)) {
+        printf("consistent (%d/%d filled)\n", grid->filled, SIZE * SIZE);
+    } else {
+        const char *separator = ":";
+        printf("INCONSISTENT (%d/%d filled)", grid->filled, SIZE * SIZE);
+        for (int unit = 0; unit < NUM_THREADS; unit++) {
+            if (grid->duplicates[unit]) {
+                printf("%s %s %d", separator, kinds[unit / SIZE], unit % SIZE + 1);
+                separator = ",";
+            }
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+
+/*
+ * Function: editMain
+ * ------------------
+ * Entry point of the edit subcommand. Starts from an empty grid, or from a puzzle file where 0 or '.'
+ * marks an empty cell, then reads one "row col value" edit per line from stdin (1-based coordinates; value 0
+ * clears the cell) and prints the grid state after each edit. Blank lines and lines starting with '#'
+ * are ignored.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS if the grid is a valid solution at end of input, EXIT_FAILURE otherwise.
+ */
+
+int editMain(int argc, char *argv[]) {
+    incrementalGrid grid;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: edit [<sudoku_puzzle_file>] < edits\n"
+                        "  Each edit is a line \"row col value\" (1-based; value 0 clears the cell)\n");
+        return EXIT_FAILURE;
+    }
+    if (argc == 2) {
+        gridCell sudoku[SIZE][SIZE];
+        char *data = NULL;
+        size_t capacity = 0, length;
+        int error = readWholeFile(argv[1], &data, &capacity, &length);
+        bool parsed = !error && parseSudoku(data, length, sudoku);
+        free(data);
+        if (error) {
+            fprintf(stderr, "%s: %s\n", argv[1], strerror(error));
+            return EXIT_FAILURE;
+        }
+        if (!parsed || !incrementalLoad(&grid, sudoku)) {
+            fprintf(stderr, "%s: expected %d numbers between 0 and %d ('.' for an empty cell)\n", argv[1],
+                    SIZE * SIZE, SIZE);
+            return EXIT_FAILURE;
+        }
+    } else {
+        incrementalInit(&grid);
+    }
+    printState(&grid);
+
+    char line[256];
+    for (unsigned long lineNo = 1; fgets(line, sizeof(line), stdin); lineNo++) {
+        int row, col, value;
+        char extra;
+        if (line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%d %d %d %c", &row, &col, &value, &extra) != 3 ||
+            !incrementalSetCell(&grid, row - 1, col - 1, value)) {
+            fprintf(stderr, "stdin:%lu: expected \"row col value\" with row and col in 1..%d, value in 0..%d\n",
+                    lineNo, SIZE, SIZE);
+            continue;
+        }
+        printState(&grid);
+    }
+    return incrementalComplete(&grid) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
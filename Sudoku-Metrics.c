@@ -0,0 +1,181 @@
+/*
+ * File: Sudoku-Metrics.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Low-overhead run metrics exported in Prometheus text format. Phase times and the grid
+ *              latency histogram are recorded by the coordinating thread; every worker thread writes
+ *              only its own cache-line-sized slot, so nothing is locked and slots are summed at export.
+ *              Building with -DSUDOKU_NO_METRICS removes all of it.
+ */
+
+
+#ifndef SUDOKU_NO_METRICS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+// Latency histogram buckets are powers of two from 2^METRICS_FIRST_BUCKET ns upwards.
+#define METRICS_FIRST_BUCKET 6
+#define METRICS_BUCKETS 20
+
+static const char *metricPhaseNames[NUM_METRIC_PHASES] = {"load", "thread_setup", "check", "print"};
+
+// Struct holding one worker's counters, padded so neighbouring workers never share a cache line.
+typedef struct {
+    uint64_t unitsChecked;
+    uint64_t unitsInvalid;
+    uint64_t checkNanos;
+    char pad[64 - 3 * sizeof(uint64_t)];
+} metricSlot;
+
+bool metricsOn = false;
+
+static metricSlot slots[METRICS_MAX_SLOTS] __attribute__((aligned(64)));
+static uint64_t phaseNanos[NUM_METRIC_PHASES];
+static uint64_t latencyBuckets[METRICS_BUCKETS + 1]; // Last bucket is +Inf
+static uint64_t latencySum;
+static uint64_t latencyCount;
+
+
+/*
+ * Function: metricsEnable
+ * -----------------------
+ * Turns recording on. Until this is called every recording call returns immediately.
+ *
+ * Returns: void.
+ */
+
+void metricsEnable(void) {
+    metricsOn = true;
+}
+
+
+/*
+ * Function: metricsPhaseAdd
+ * -------------------------
+ * Adds time to a pipeline phase. Called only from the coordinating thread.
+ *
+ * phase: The phase the time was spent in.
+ * nanos: Elapsed nanoseconds.
+ *
+ * Returns: void.
+ */
+
+void metricsPhaseAdd(metricPhase phase, uint64_t nanos) {
+    if (metricsOn) {
+        phaseNanos[phase] += nanos;
+    }
+}
+
+
+/*
+ * Function: metricsUnitChecked
+ * ----------------------------
+ * Records one unit check in the calling worker's slot. Each slot must have a single writer.
+ *
+ * slot: The worker's slot index.
+ * valid: Whether the unit passed.
+ * nanos: Time the check took.
+ *
+ * Returns: void.
+ */
+
+void metricsUnitChecked(int slot, bool valid, uint64_t nanos) {
+    if (!metricsOn) {
+        return;
+    }
+    metricSlot *s = &slots[slot % METRICS_MAX_SLOTS];
+    s->unitsChecked++;
+    s->unitsInvalid += !valid;
+    s->checkNanos += nanos;
+}
+
+
+/*
+ * Function: metricsGridLatency
+ * ----------------------------
+ * Adds one end-to-end grid validation time to the latency histogram.
+ *
+ * nanos: Elapsed nanoseconds.
+ *
+ * Returns: void.
+ */
+
+void metricsGridLatency(uint64_t nanos) {
+    if (!metricsOn) {
+        return;
+    }
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS && nanos > (1ull << (METRICS_FIRST_BUCKET + bucket))) {
+        bucket++;
+    }
+    latencyBuckets[bucket]++;
+    latencySum += nanos;
+    latencyCount++;
+}
+
+
+/*
+ * Function: metricsWrite
+ * ----------------------
+ * Writes every metric in Prometheus text exposition format. The file is written under a temporary name
+ * and renamed into place so a collector never scrapes a half-written file.
+ *
+ * path: Destination file.
+ *
+ * Returns: true on success, false on an I/O error (errno set).
+ */
+
+bool metricsWrite(const char *path) {
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *out = fopen(tmpPath, "w");
+    if (!out) {
+        return false;
+    }
+
+    fprintf(out, "# HELP sudoku_phase_seconds_total Time spent in each pipeline phase.\n");
+    fprintf(out, "# TYPE sudoku_phase_seconds_total counter\n");
+    for (int p = 0; p < NUM_METRIC_PHASES; p++) {
+        fprintf(out, "sudoku_phase_seconds_total{phase=\"%s\"} %.9f\n", metricPhaseNames[p], (double)phaseNanos[p] / 1e9);
+    }
+
+    uint64_t checked = 0, invalid = 0, checkNanos = 0;
+    for (int i = 0; i < METRICS_MAX_SLOTS; i++) {
+        checked += slots[i].unitsChecked;
+        invalid += slots[i].unitsInvalid;
+        checkNanos += slots[i].checkNanos;
+    }
+    fprintf(out, "# HELP sudoku_units_checked_total Rows, columns, and subgrids checked.\n");
+    fprintf(out, "# TYPE sudoku_units_checked_total counter\n");
+    fprintf(out, "sudoku_units_checked_total %llu\n", (unsigned long long)checked);
+    fprintf(out, "# HELP sudoku_units_invalid_total Rows, columns, and subgrids found invalid.\n");
+    fprintf(out, "# TYPE sudoku_units_invalid_total counter\n");
+    fprintf(out, "sudoku_units_invalid_total %llu\n", (unsigned long long)invalid);
+    fprintf(out, "# HELP sudoku_unit_check_seconds_total Time worker threads spent inside unit checks.\n");
+    fprintf(out, "# TYPE sudoku_unit_check_seconds_total counter\n");
+    fprintf(out, "sudoku_unit_check_seconds_total %.9f\n", (double)checkNanos / 1e9);
+
+    fprintf(out, "# HELP sudoku_grid_latency_seconds End-to-end validation time per grid.\n");
+    fprintf(out, "# TYPE sudoku_grid_latency_seconds histogram\n");
+    uint64_t cumulative = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        cumulative += latencyBuckets[b];
+        fprintf(out, "sudoku_grid_latency_seconds_bucket{le=\"%.9g\"} %llu\n",
+                (double)(1ull << (METRICS_FIRST_BUCKET + b)) / 1e9, (unsigned long long)cumulative);
+    }
+    cumulative += latencyBuckets[METRICS_BUCKETS];
+    fprintf(out, "sudoku_grid_latency_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+    fprintf(out, "sudoku_grid_latency_seconds_sum %.9f\n", (double)latencySum / 1e9);
+    fprintf(out, "sudoku_grid_latency_seconds_count %llu\n", (unsigned long long)latencyCount);
+
+    if (fclose(out) != 0) {
+        return false;
+    }
+    return rename(tmpPath, path) == 0;
+}
+
+#endif
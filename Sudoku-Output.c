@@ -0,0 +1,302 @@
+/*
+ * File: Sudoku-Output.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Buffered output writer. Text is formatted into a large in-memory buffer and handed to
+ *              the kernel with write/writev in big chunks instead of one stdio call per line. Several
+ *              buffers (one per worker) can be flushed together, in order, with a single writev.
+ */
+
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static const char *verdictModeNames[] = {"full", "verdict", "byte", "bitmap"};
+
+
+/*
+ * Function: parseVerdictMode
+ * --------------------------
+ * Maps an --output argument to its verdictMode.
+ *
+ * name: The argument text.
+ *
+ * Returns: The matching mode, or -1 if the name is unknown.
+ */
+
+int parseVerdictMode(const char *name) {
+    for (size_t i = 0; i < sizeof(verdictModeNames) / sizeof(verdictModeNames[0]); i++) {
+        if (strcmp(name, verdictModeNames[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+
+/*
+ * Function: outputInit
+ * --------------------
+ * Prepares a buffer that flushes to a file descriptor.
+ *
+ * out: The buffer to initialise.
+ * fd: Destination file descriptor.
+ * capacity: Buffer size in bytes; the buffer flushes itself whenever it fills up.
+ *
+ * Returns: true on success, false if the buffer could not be allocated.
+ */
+
+bool outputInit(outputBuffer *out, int fd, size_t capacity) {
+    out->fd = fd;
+    out->length = 0;
+    out->capacity = capacity;
+    out->failed = false;
+    out->data = malloc(capacity);
+    return out->data != NULL;
+}
+
+
+/*
+ * Function: outputAttach
+ * ----------------------
+ * Prepares a buffer over memory the caller owns, such as an arena allocation. Such a buffer must not
+ * be passed to outputFree.
+ *
+ * out: The buffer to initialise.
+ * fd: Destination file descriptor.
+ * data: The memory to format into.
+ * capacity: Size of data in bytes.
+ */
+
+void outputAttach(outputBuffer *out, int fd, char *data, size_t capacity) {
+    out->fd = fd;
+    out->length = 0;
+    out->capacity = capacity;
+    out->failed = false;
+    out->data = data;
+}
+
+
+/*
+ * Function: outputFree
+ * --------------------
+ * Releases a buffer without flushing it.
+ */
+
+void outputFree(outputBuffer *out) {
+    free(out->data);
+    out->data = NULL;
+    out->length = out->capacity = 0;
+}
+
+
+/*
+ * Function: writeAll
+ * ------------------
+ * Writes a whole byte range, retrying short writes and interrupted calls.
+ *
+ * fd: Destination file descriptor.
+ * data, length: The bytes to write.
+ *
+ * Returns: true on success, false on a write error (errno set).
+ */
+
+static bool writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+
+/*
+ * Function: outputFlush
+ * ---------------------
+ * Writes out everything buffered so far. After an error the buffer keeps discarding data and reports
+ * failure, so callers only need to check the final flush.
+ *
+ * out: The buffer to flush.
+ *
+ * Returns: true on success, false if this or any earlier write failed.
+ */
+
+bool outputFlush(outputBuffer *out) {
+    if (!out->failed && out->length > 0 && !writeAll(out->fd, out->data, out->length)) {
+        out->failed = true;
+    }
+    out->length = 0;
+    return !out->failed;
+}
+
+
+/*
+ * Function: outputBytes
+ * ---------------------
+ * Appends raw bytes, flushing first if they do not fit. Ranges larger than the whole buffer are
+ * written straight through.
+ */
+
+void outputBytes(outputBuffer *out, const void *data, size_t length) {
+    if (out->length + length > out->capacity) {
+        outputFlush(out);
+        if (length > out->capacity) {
+            if (!out->failed && !writeAll(out->fd, data, length)) {
+                out->failed = true;
+            }
+            return;
+        }
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+
+/*
+ * Function: outputString
+ * ----------------------
+ * Appends a NUL-terminated string.
+ */
+
+void outputString(outputBuffer *out, const char *text) {
+    outputBytes(out, text, strlen(text));
+}
+
+
+/*
+ * Function: outputUnsigned
+ * ------------------------
+ * Appends the decimal form of an unsigned number without going through printf.
+ */
+
+void outputUnsigned(outputBuffer *out, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    outputBytes(out, digits + sizeof(digits) - n, (size_t)n);
+}
+
+
+/*
+ * Function: outputUnitLine
+ * ------------------------
+ * Appends the report line for one row, column, or subgrid, in the same wording the threaded checkers
+ * use, so batch output matches single-grid output line for line.
+ *
+ * out: Destination buffer.
+ * index: Unit index in results order (rows, then columns, then subgrids).
+ * valid: The unit's verdict.
+ *
+ * Returns: void.
+ */
+
+void outputUnitLine(outputBuffer *out, int index, bool valid) {
+    static const char *kinds[3] = {"row", "column", "subgrid"};
+
+    outputNamedUnitLine(out, index, kinds[index / SIZE], index % SIZE + 1, valid);
+}
+
+
+/*
+ * Function: outputNamedUnitLine
+ * -----------------------------
+ * Appends a report line in the outputUnitLine wording for a unit of any kind, such as a variant's
+ * diagonals or regions.
+ *
+ * params:
+ *      out: Destination buffer.
+ *      index: Zero-based position of the unit in the report.
+ *      kind: The unit's kind ("row", "diagonal", ...).
+ *      number: The unit's 1-based number among units of its kind.
+ *      valid: The unit's verdict.
+ *
+ * Returns: void.
+ */
+
+void outputNamedUnitLine(outputBuffer *out, int index, const char *kind, int number, bool valid) {
+    outputString(out, "Thread # ");
+    if (index + 1 < 10) {
+        outputBytes(out, " ", 1); // Right-aligned in two columns, as "%2d" prints it
+    }
+    outputUnsigned(out, (uint64_t)(index + 1));
+    outputString(out, " (");
+    outputString(out, kind);
+    outputString(out, " ");
+    outputUnsigned(out, (uint64_t)number);
+    outputString(out, valid ? ") is valid\n" : ") is INVALID\n");
+}
+
+
+/*
+ * Function: outputFlushAll
+ * ------------------------
+ * Writes several buffers that share a file descriptor, in order, using as few writev calls as possible.
+ * Every buffer is emptied afterwards.
+ *
+ * buffers: The buffers to flush.
+ * count: Number of buffers.
+ *
+ * Returns: true on success, false on a write error (errno set).
+ */
+
+bool outputFlushAll(outputBuffer *buffers, size_t count) {
+    bool ok = true;
+    size_t i = 0;
+
+    while (ok && i < count) {
+        struct iovec iov[IOV_MAX];
+        int fd = buffers[i].fd;
+        int n = 0;
+        for (; i < count && n < IOV_MAX; i++) {
+            if (buffers[i].failed) {
+                ok = false;
+            }
+            if (buffers[i].length > 0) {
+                iov[n].iov_base = buffers[i].data;
+                iov[n].iov_len = buffers[i].length;
+                n++;
+            }
+            buffers[i].length = 0;
+        }
+
+        // writev may stop short; finish the remainder one vector at a time
+        ssize_t written = 0;
+        while (n > 0 && (written = writev(fd, iov, n)) < 0 && errno == EINTR) {
+        }
+        if (written < 0) {
+            return false;
+        }
+        size_t done = (size_t)written;
+        for (int v = 0; v < n; v++) {
+            if (done >= iov[v].iov_len) {
+                done -= iov[v].iov_len;
+                continue;
+            }
+            if (!writeAll(fd, (char *)iov[v].iov_base + done, iov[v].iov_len - done)) {
+                return false;
+            }
+            done = 0;
+        }
+    }
+    return ok;
+}
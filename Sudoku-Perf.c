@@ -0,0 +1,263 @@
+/*
+ * File: Sudoku-Perf.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Optional hardware performance counters around the parse, validate, and report phases.
+ *              Counters are opened with perf_event_open and inherited by the checker threads; each
+ *              phase accumulates the counter deltas observed between perfBegin and perfEnd.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "Sudoku-Validator.h"
+
+// Counters opened by perfOpen, in report order.
+#define NUM_COUNTERS 5
+
+static const char *counterNames[NUM_COUNTERS] = {
+    "cycles", "instructions", "branch_misses", "l1d_read_misses", "llc_misses",
+};
+
+static const char *phaseNames[NUM_PHASES] = {"parse", "validate", "report"};
+
+// Struct to hold the counter state for the whole process.
+typedef struct {
+    int fds[NUM_COUNTERS];            // -1 when the counter could not be opened
+    int openErrors[NUM_COUNTERS];     // errno from perf_event_open for unavailable counters
+    uint64_t start[NUM_COUNTERS];     // Reading taken by the last perfBegin
+    uint64_t totals[NUM_PHASES][NUM_COUNTERS];
+    uint64_t nanos[NUM_PHASES];
+    uint64_t startNanos;
+    bool active;
+} perfState;
+
+static perfState perf = {.fds = {-1, -1, -1, -1, -1}};
+
+
+#ifdef __linux__
+/*
+ * Function: openCounter
+ * ---------------------
+ * Opens one user-space counter for the calling process and every thread it creates afterwards.
+ *
+ * type, config: perf_event_attr type and config of the event.
+ *
+ * Returns: The counter's file descriptor, or -1 with errno set.
+ */
+
+static int openCounter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;        // Count the checker threads too; their totals fold in when they exit
+    attr.exclude_kernel = 1; // Allowed at the default perf_event_paranoid level
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+
+/*
+ * Function: readCounter
+ * ---------------------
+ * Reads a counter, scaling the raw value up when the kernel had to multiplex it.
+ *
+ * fd: The counter's file descriptor.
+ *
+ * Returns: The estimated event count, or 0 if the read failed.
+ */
+
+static uint64_t readCounter(int fd) {
+    uint64_t values[3]; // value, time enabled, time running
+    if (read(fd, values, sizeof(values)) != (ssize_t)sizeof(values)) {
+        return 0;
+    }
+    if (values[2] == 0) {
+        return 0;
+    }
+    if (values[2] < values[1]) {
+        return (uint64_t)((double)values[0] * (double)values[1] / (double)values[2]);
+    }
+    return values[0];
+}
+
+
+/*
+ * Function: perfOpen
+ * ------------------
+ * Opens the hardware counters. Counters that cannot be opened (no PMU in a container, a restrictive
+ * perf_event_paranoid setting, or a non-Linux platform) are reported as unavailable rather than
+ * treated as errors.
+ *
+ * Returns: true if at least one counter is available, false otherwise.
+ */
+
+bool perfOpen(void) {
+#ifdef __linux__
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[NUM_COUNTERS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    };
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        perf.fds[i] = openCounter(events[i].type, events[i].config);
+        if (perf.fds[i] < 0) {
+            perf.openErrors[i] = errno;
+        } else {
+            perf.active = true;
+        }
+    }
+#else
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        perf.openErrors[i] = ENOSYS;
+    }
+#endif
+    return perf.active;
+}
+
+
+/*
+ * Function: perfBegin
+ * -------------------
+ * Marks the start of a phase. Does nothing when perfOpen was not called.
+ *
+ * phase: The phase being entered.
+ *
+ * Returns: void.
+ */
+
+void perfBegin(phaseId phase) {
+    (void)phase;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (perf.fds[i] >= 0) {
+            perf.start[i] = readCounter(perf.fds[i]);
+        }
+    }
+    perf.startNanos = nowNanos();
+}
+
+
+/*
+ * Function: perfEnd
+ * -----------------
+ * Marks the end of a phase and adds the counter deltas since the matching perfBegin to its totals.
+ *
+ * phase: The phase being left.
+ *
+ * Returns: void.
+ */
+
+void perfEnd(phaseId phase) {
+    perf.nanos[phase] += nowNanos() - perf.startNanos;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (perf.fds[i] >= 0) {
+            perf.totals[phase][i] += readCounter(perf.fds[i]) - perf.start[i];
+        }
+    }
+}
+
+
+/*
+ * Function: perfReport
+ * --------------------
+ * Writes the per-phase counters along with IPC and miss rates. Unavailable counters are listed with
+ * the reason they could not be opened and are printed as null in JSON.
+ *
+ * out: Destination stream.
+ * json: true for a JSON document, false for a human-readable table.
+ *
+ * Returns: void.
+ */
+
+void perfReport(FILE *out, bool json) {
+    if (json) {
+        fprintf(out, "{\n  \"available\": %s,\n  \"unavailable\": {", perf.active ? "true" : "false");
+        bool first = true;
+        for (int i = 0; i < NUM_COUNTERS; i++) {
+            if (perf.fds[i] < 0) {
+                fprintf(out, "%s\"%s\": \"%s\"", first ? "" : ", ", counterNames[i], strerror(perf.openErrors[i]));
+                first = false;
+            }
+        }
+        fprintf(out, "},\n  \"phases\": {\n");
+        for (int p = 0; p < NUM_PHASES; p++) {
+            fprintf(out, "    \"%s\": {\"ns\": %llu", phaseNames[p], (unsigned long long)perf.nanos[p]);
+            for (int i = 0; i < NUM_COUNTERS; i++) {
+                if (perf.fds[i] >= 0) {
+                    fprintf(out, ", \"%s\": %llu", counterNames[i], (unsigned long long)perf.totals[p][i]);
+                } else {
+                    fprintf(out, ", \"%s\": null", counterNames[i]);
+                }
+            }
+            fprintf(out, "}%s\n", p + 1 < NUM_PHASES ? "," : "");
+        }
+        fprintf(out, "  }\n}\n");
+        return;
+    }
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (perf.fds[i] < 0) {
+            fprintf(out, "perf: %s unavailable (%s)\n", counterNames[i], strerror(perf.openErrors[i]));
+        }
+    }
+    if (!perf.active) {
+        fprintf(out, "perf: no hardware counters available; phase times only\n");
+    }
+    for (int p = 0; p < NUM_PHASES; p++) {
+        const uint64_t *t = perf.totals[p];
+        fprintf(out, "perf: %-8s %10llu ns", phaseNames[p], (unsigned long long)perf.nanos[p]);
+        for (int i = 0; i < NUM_COUNTERS; i++) {
+            if (perf.fds[i] >= 0) {
+                fprintf(out, "  %s=%llu", counterNames[i], (unsigned long long)t[i]);
+            }
+        }
+        if (perf.fds[0] >= 0 && perf.fds[1] >= 0 && t[0]) {
+            fprintf(out, "  ipc=%.2f", (double)t[1] / (double)t[0]);
+        }
+        if (perf.fds[1] >= 0 && perf.fds[2] >= 0 && t[1]) {
+            fprintf(out, "  branch_miss_per_kinst=%.2f", 1000.0 * (double)t[2] / (double)t[1]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+
+/*
+ * Function: perfClose
+ * -------------------
+ * Releases the counters.
+ *
+ * Returns: void.
+ */
+
+void perfClose(void) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (perf.fds[i] >= 0) {
+            close(perf.fds[i]);
+            perf.fds[i] = -1;
+        }
+    }
+    perf.active = false;
+}
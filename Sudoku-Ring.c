@@ -0,0 +1,862 @@
+/*
+ * File: Sudoku-Ring.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Shared-memory submission interface for producers on the same machine. A validator process
+ *              creates a named shared memory object holding a submission ring of packed grids and one
+ *              completion ring of verdicts per producer. Producers attach to it, each claiming a
+ *              completion ring of its own, and claim submission slots with a compare-and-swap, so while
+ *              both sides are busy no grid costs a system call or a copy through the kernel. A side that
+ *              runs out of work sleeps on a futex in the mapping, and is woken only if it announced that
+ *              it sleeps.
+ */
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// Identifies the mapping; the number after it is the layout version.
+#define RING_MAGIC "SDKR"
+#define RING_VERSION 2
+
+// Default slots per ring; a power of two.
+#define RING_DEFAULT_SLOTS 4096
+
+// Default and largest number of producers attached at once.
+#define RING_DEFAULT_PRODUCERS 16
+#define RING_MAX_PRODUCERS 1024
+
+// Grids the validator takes off the submission ring per pass.
+#define RING_BATCH 64
+
+// Polls of an empty ring, yielding in between, before a side goes to sleep.
+#define RING_IDLE_SPINS 256
+
+// Struct for one submission slot. The sequence numbers make a bounded multi-producer queue: the slot is
+// free for position p while sequence == p, and holds the grid of position p once sequence == p + 1.
+typedef struct {
+    uint64_t sequence;
+    uint64_t tag;                // Chosen by the producer, returned with the verdict
+    uint32_t producer;           // Completion ring the verdict goes to
+    uint32_t generation;         // The producer's attachment that submitted the grid
+    gridCell cells[SIZE * SIZE];
+} __attribute__((aligned(64))) ringSubmission;
+
+// Struct for one completion slot. Each producer has a ring of these to itself, so only the validator
+// fills it and only that producer empties it, and the head and tail indices alone order them.
+typedef struct {
+    uint64_t tag;
+    uint32_t generation;
+    uint32_t valid;
+} ringCompletion;
+
+// Struct for one producer's place in the mapping: its completion ring indices and the futex word it
+// sleeps on. A producer claims a free one when it attaches, by locking its byte of the shared memory
+// object, so the kernel frees it again even if the producer dies without detaching.
+typedef struct {
+    uint32_t generation;         // Bumped on every attach, so verdicts meant for a previous owner are dropped
+    uint32_t waitFor;            // What the producer waits for while asleep (RING_WAIT_* bits)
+    uint64_t head __attribute__((aligned(64)));          // Next position the producer collects
+    uint64_t tail __attribute__((aligned(64)));          // Next position the validator fills
+    uint32_t wake __attribute__((aligned(64)));          // Futex word, bumped before each wake
+    uint32_t sleeping;
+} ringProducer;
+
+// Header at the start of the mapping; the submission slots, the producers, and then each producer's
+// completion slots follow it. Each index sits on its own cache line, so producers and the validator do
+// not disturb each other.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t slots;              // Slots per ring
+    uint32_t producers;          // Producers that can be attached at once
+    uint32_t order;              // Grid side; producers must be built with the same SIZE
+    uint32_t puzzle;             // Grids are checked as puzzles: only the givens must not conflict
+    uint32_t closed;             // Set when the validator shuts down
+    uint64_t submitTail __attribute__((aligned(64)));    // Next position producers claim
+    uint64_t submitHead __attribute__((aligned(64)));    // Next position the validator takes
+    uint32_t validatorWake __attribute__((aligned(64))); // Futex word, bumped before each wake
+    uint32_t validatorSleeping;
+    uint32_t spaceSleepers __attribute__((aligned(64))); // Producers asleep until a submission slot frees
+} ringHeader;
+
+struct ringChannel {
+    ringHeader *header;
+    ringSubmission *submissions;
+    ringProducer *producers;
+    ringCompletion *completions; // Every producer's completion slots, one ring after another
+    ringProducer *self;          // This producer, or NULL for the validator
+    uint32_t id;
+    uint32_t generation;
+    uint64_t outstanding;        // Grids this producer submitted whose verdicts it has not collected
+    int claim;                   // Descriptor holding the lock on this producer's byte, or -1
+    uint64_t mask;
+    size_t bytes;
+    char name[NAME_MAX];
+    bool owner;                  // Created by this process, which removes it on close
+};
+
+// Set by SIGINT or SIGTERM to stop ring serve.
+static volatile sig_atomic_t stopRequested;
+
+
+/*
+ * Function: futexWait
+ * -------------------
+ * Sleeps until the word is woken, unless it no longer holds the expected value. The futex is shared
+ * between processes, so the private variant is not used.
+ */
+
+static void futexWait(uint32_t *word, uint32_t expected) {
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+
+/*
+ * Function: wakeIfSleeping
+ * ------------------------
+ * Wakes the sleepers on a futex word, if any announced themselves. The fence orders the caller's
+ * publication before the check, pairing with the fence in sleepUntil, so a sleeper either sees the new
+ * work before it sleeps or is woken.
+ */
+
+static void wakeIfSleeping(uint32_t *wake, uint32_t *sleeping) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(sleeping, __ATOMIC_RELAXED) > 0) {
+        __atomic_add_fetch(wake, 1, __ATOMIC_SEQ_CST);
+        syscall(SYS_futex, wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+
+/*
+ * Function: sleepUntil
+ * --------------------
+ * Announces a sleeper on a futex word and sleeps, unless the condition already holds. Returns after a
+ * wake, a signal, or a spurious wakeup, so callers re-check their condition.
+ */
+
+static void sleepUntil(uint32_t *wake, uint32_t *sleeping, bool (*ready)(const ringChannel *, unsigned),
+                       const ringChannel *ring, unsigned arg) {
+    uint32_t seen = __atomic_load_n(wake, __ATOMIC_SEQ_CST);
+
+    __atomic_add_fetch(sleeping, 1, __ATOMIC_SEQ_CST);
+    if (!ready(ring, arg)) {
+        futexWait(wake, seen);
+    }
+    __atomic_sub_fetch(sleeping, 1, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Functions: submissionReady, completionSpace, producerReady
+ * -----------------------------------------------------------
+ * Conditions the two sides sleep on: a grid waiting for the validator, room for a verdict in a given
+ * producer's completion ring, and for a producer whichever of a verdict to collect or room for a grid
+ * it asked for (RING_WAIT_* bits).
+ */
+
+static bool submissionReady(const ringChannel *ring, unsigned unused) {
+    uint64_t head = ring->header->submitHead;
+    (void)unused;
+    return __atomic_load_n(&ring->submissions[head & ring->mask].sequence, __ATOMIC_ACQUIRE) == head + 1;
+}
+
+static bool completionSpace(const ringChannel *ring, unsigned producer) {
+    const ringProducer *target = &ring->producers[producer];
+    return target->tail - __atomic_load_n(&target->head, __ATOMIC_ACQUIRE) <= ring->mask;
+}
+
+static bool producerReady(const ringChannel *ring, unsigned waitFor) {
+    const ringProducer *self = ring->self;
+    uint64_t tail = __atomic_load_n(&ring->header->submitTail, __ATOMIC_RELAXED);
+    return __atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE) ||
+           ((waitFor & RING_WAIT_VERDICT) && __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE) != self->head) ||
+           ((waitFor & RING_WAIT_SPACE) &&
+            __atomic_load_n(&ring->submissions[tail & ring->mask].sequence, __ATOMIC_ACQUIRE) == tail);
+}
+
+
+/*
+ * Function: ringBytes
+ * -------------------
+ * Returns: The size of the mapping of a ring with the given slots and producers.
+ */
+
+static size_t ringBytes(unsigned slots, unsigned producers) {
+    return sizeof(ringHeader) + (size_t)slots * sizeof(ringSubmission) +
+           (size_t)producers * (sizeof(ringProducer) + (size_t)slots * sizeof(ringCompletion));
+}
+
+
+/*
+ * Function: mapRing
+ * -----------------
+ * Maps a ring's shared memory object and points the channel at its parts.
+ *
+ * Returns: The channel, or NULL with errno set.
+ */
+
+static ringChannel *mapRing(const char *name, int fd, size_t bytes, unsigned slots, unsigned producers, bool owner) {
+    ringChannel *ring = calloc(1, sizeof(*ring));
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (!ring || memory == MAP_FAILED) {
+        int error = errno;
+        free(ring);
+        if (memory != MAP_FAILED) {
+            munmap(memory, bytes);
+        }
+        errno = error;
+        return NULL;
+    }
+    ring->header = (ringHeader *)memory;
+    ring->submissions = (ringSubmission *)((char *)memory + sizeof(ringHeader));
+    ring->producers = (ringProducer *)(ring->submissions + slots);
+    ring->completions = (ringCompletion *)(ring->producers + producers);
+    ring->claim = -1;
+    ring->mask = slots - 1;
+    ring->bytes = bytes;
+    ring->owner = owner;
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    return ring;
+}
+
+
+/*
+ * Function: ringName
+ * ------------------
+ * Shared memory object names must start with a slash; one is added if missing.
+ */
+
+static void ringName(const char *name, char *out, size_t size) {
+    snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+
+/*
+ * Function: ringCreate
+ * --------------------
+ * Creates a ring for producers to attach to. Fails if a ring of that name already exists.
+ *
+ * name: Name of the shared memory object, such as "sudoku" (visible as /dev/shm/sudoku).
+ * slots: Slots per ring; rounded up to a power of two.
+ * producers: Producers that can be attached at once, each with a completion ring of its own.
+ * puzzle: Check grids as puzzles, where only the givens must not conflict.
+ *
+ * Returns: The channel, or NULL with errno set.
+ */
+
+ringChannel *ringCreate(const char *name, unsigned slots, unsigned producers, bool puzzle) {
+    char path[NAME_MAX];
+    unsigned rounded = 1;
+
+    while (rounded < slots && rounded < (1u << 24)) {
+        rounded <<= 1;
+    }
+    if (producers == 0 || producers > RING_MAX_PRODUCERS) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t bytes = ringBytes(rounded, producers);
+
+    ringName(name, path, sizeof(path));
+    int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    ringChannel *ring = ftruncate(fd, (off_t)bytes) == 0 ? mapRing(path, fd, bytes, rounded, producers, true) : NULL;
+    int error = errno;
+    close(fd);
+    if (!ring) {
+        shm_unlink(path);
+        errno = error;
+        return NULL;
+    }
+
+    ringHeader *header = ring->header;
+    header->version = RING_VERSION;
+    header->slots = rounded;
+    header->producers = producers;
+    header->order = SIZE;
+    header->puzzle = puzzle;
+    for (unsigned i = 0; i < rounded; i++) {
+        ring->submissions[i].sequence = i;
+    }
+    // The magic goes in last, so a producer never attaches to a half-initialised ring
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, RING_MAGIC, 4);
+    return ring;
+}
+
+
+/*
+ * Function: ringAttach
+ * --------------------
+ * Attaches a producer to a ring created by ringCreate, possibly in another process, and claims a
+ * completion ring for it. A channel belongs to one producer thread; each thread attaches on its own.
+ *
+ * name: Name the ring was created with.
+ *
+ * Returns: The channel, or NULL with errno set (EINVAL if the object is not a ring for this grid size,
+ *          EBUSY if as many producers as the ring allows are attached already).
+ */
+
+ringChannel *ringAttach(const char *name) {
+    char path[NAME_MAX];
+    struct stat info;
+
+    ringName(name, path, sizeof(path));
+    int fd = shm_open(path, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ringHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ringHeader header;
+    ssize_t got = pread(fd, &header, sizeof(header), 0);
+    unsigned slots = header.slots, producers = header.producers;
+    size_t bytes = ringBytes(slots, producers);
+    if (got != (ssize_t)sizeof(header) || memcmp(header.magic, RING_MAGIC, 4) != 0 || header.version != RING_VERSION ||
+        header.order != SIZE || slots == 0 || (slots & (slots - 1)) != 0 || producers == 0 ||
+        producers > RING_MAX_PRODUCERS || (size_t)info.st_size != bytes) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    ringChannel *ring = mapRing(path, fd, bytes, slots, producers, false);
+    if (!ring) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+
+    // The locks belong to this open description, so threads of one process each claim their own
+    for (unsigned id = 0; id < producers; id++) {
+        struct flock claim = {.l_type = F_WRLCK, .l_whence = SEEK_SET, .l_start = id, .l_len = 1};
+        if (fcntl(fd, F_OFD_SETLK, &claim) == 0) {
+            ringProducer *producer = &ring->producers[id];
+            ring->self = producer;
+            ring->id = id;
+            ring->claim = fd;
+            ring->generation = __atomic_add_fetch(&producer->generation, 1, __ATOMIC_RELAXED);
+            ring->completions += (size_t)id * slots;
+            return ring;
+        }
+    }
+    int error = errno == EAGAIN || errno == EACCES ? EBUSY : errno;
+    close(fd);
+    munmap(ring->header, ring->bytes);
+    free(ring);
+    errno = error;
+    return NULL;
+}
+
+
+/*
+ * Function: ringSubmit
+ * --------------------
+ * Queues a grid for validation without blocking. Any number of producers may submit at once. A producer
+ * may have at most as many grids outstanding as a ring has slots, so its completion ring never fills.
+ *
+ * ring: The channel.
+ * grid: The grid, copied into the ring.
+ * tag: Returned with the grid's verdict.
+ *
+ * Returns: true if the grid was queued, false if the ring is full or closed, or the producer has a
+ *          ring's worth of verdicts to collect first.
+ */
+
+bool ringSubmit(ringChannel *ring, const gridCell grid[SIZE][SIZE], uint64_t tag) {
+    ringHeader *header = ring->header;
+    uint64_t position = __atomic_load_n(&header->submitTail, __ATOMIC_RELAXED);
+    ringSubmission *slot;
+
+    if (__atomic_load_n(&header->closed, __ATOMIC_RELAXED) || ring->outstanding > ring->mask) {
+        return false;
+    }
+    for (;;) {
+        slot = &ring->submissions[position & ring->mask];
+        int64_t lag = (int64_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+        if (lag == 0) {
+            if (__atomic_compare_exchange_n(&header->submitTail, &position, position + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (lag < 0) {
+            return false; // The validator has not taken the grid a lap ago yet: the ring is full
+        } else {
+            position = __atomic_load_n(&header->submitTail, __ATOMIC_RELAXED);
+        }
+    }
+    slot->tag = tag;
+    slot->producer = ring->id;
+    slot->generation = ring->generation;
+    memcpy(slot->cells, grid, sizeof(slot->cells));
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+    ring->outstanding++;
+    wakeIfSleeping(&header->validatorWake, &header->validatorSleeping);
+    return true;
+}
+
+
+/*
+ * Function: ringReap
+ * ------------------
+ * Collects one of this producer's verdicts without blocking. Verdicts come back in the order the
+ * producer submitted its grids, and never go to another producer.
+ *
+ * ring: The channel.
+ * tag: Receives the tag the grid was submitted with.
+ * valid: Receives the verdict.
+ *
+ * Returns: true if a verdict was collected, false if none is ready.
+ */
+
+bool ringReap(ringChannel *ring, uint64_t *tag, bool *valid) {
+    ringProducer *self = ring->self;
+
+    for (;;) {
+        uint64_t position = self->head;
+        if (__atomic_load_n(&self->tail, __ATOMIC_ACQUIRE) == position) {
+            return false;
+        }
+        const ringCompletion *slot = &ring->completions[position & ring->mask];
+        bool mine = slot->generation == ring->generation;
+        *tag = slot->tag;
+        *valid = slot->valid != 0;
+        __atomic_store_n(&self->head, position + 1, __ATOMIC_RELEASE);
+        wakeIfSleeping(&ring->header->validatorWake, &ring->header->validatorSleeping);
+        if (mine) {
+            ring->outstanding--;
+            return true;
+        }
+        // Left over from a producer that detached before collecting it
+    }
+}
+
+
+/*
+ * Function: ringWait
+ * ------------------
+ * Waits until a producer can make progress on what it asks for: a verdict ready to collect
+ * (RING_WAIT_VERDICT), a free submission slot (RING_WAIT_SPACE), or either. Also returns once the ring
+ * is closed. Polls for a while before sleeping on the producer's own futex word, so a producer waiting
+ * only for verdicts sleeps however much room the submission ring has.
+ */
+
+void ringWait(ringChannel *ring, unsigned waitFor) {
+    ringProducer *self = ring->self;
+
+    for (int spin = 0; spin < RING_IDLE_SPINS; spin++) {
+        if (producerReady(ring, waitFor)) {
+            return;
+        }
+        sched_yield();
+    }
+    __atomic_store_n(&self->waitFor, waitFor, __ATOMIC_RELAXED);
+    if (waitFor & RING_WAIT_SPACE) {
+        __atomic_add_fetch(&ring->header->spaceSleepers, 1, __ATOMIC_SEQ_CST);
+    }
+    sleepUntil(&self->wake, &self->sleeping, producerReady, ring, waitFor);
+    if (waitFor & RING_WAIT_SPACE) {
+        __atomic_sub_fetch(&ring->header->spaceSleepers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+
+/*
+ * Function: ringClosed
+ * --------------------
+ * Returns: true once the validator has shut the ring down.
+ */
+
+bool ringClosed(const ringChannel *ring) {
+    return __atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+
+/*
+ * Function: ringClose
+ * -------------------
+ * Detaches from a ring, freeing a producer's completion ring for the next producer to attach. The
+ * process that created it also marks it closed, wakes any waiting producers, and removes its name.
+ */
+
+void ringClose(ringChannel *ring) {
+    if (ring->claim >= 0) {
+        close(ring->claim);
+    }
+    if (ring->owner) {
+        __atomic_store_n(&ring->header->closed, 1, __ATOMIC_RELEASE);
+        for (unsigned id = 0; id < ring->header->producers; id++) {
+            wakeIfSleeping(&ring->producers[id].wake, &ring->producers[id].sleeping);
+        }
+        shm_unlink(ring->name);
+    }
+    munmap(ring->header, ring->bytes);
+    free(ring);
+}
+
+
+// Struct for a grid the validator took off the submission ring, and where its verdict goes.
+typedef struct {
+    uint64_t tag;
+    uint32_t producer;
+    uint32_t generation;
+} ringTicket;
+
+
+/*
+ * Function: takeSubmission
+ * ------------------------
+ * Takes the next grid off the submission ring. Only the validator consumes submissions, so the head
+ * needs no compare-and-swap.
+ *
+ * Returns: true if a grid was taken, false if the ring is empty.
+ */
+
+static bool takeSubmission(ringChannel *ring, gridCell grid[SIZE][SIZE], ringTicket *ticket) {
+    uint64_t position = ring->header->submitHead;
+    ringSubmission *slot = &ring->submissions[position & ring->mask];
+
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1) {
+        return false;
+    }
+    memcpy(grid, slot->cells, sizeof(slot->cells));
+    ticket->tag = slot->tag;
+    ticket->producer = slot->producer;
+    ticket->generation = slot->generation;
+    __atomic_store_n(&slot->sequence, position + ring->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->header->submitHead, position + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+
+/*
+ * Function: postCompletion
+ * ------------------------
+ * Puts a verdict on the completion ring of the producer that submitted the grid. Only the validator
+ * produces completions.
+ *
+ * Returns: true if it was posted or is not wanted any more (the producer detached), false if the
+ *          producer's completion ring is full.
+ */
+
+static bool postCompletion(ringChannel *ring, const ringTicket *ticket, bool valid) {
+    ringProducer *target = &ring->producers[ticket->producer];
+
+    if (__atomic_load_n(&target->generation, __ATOMIC_RELAXED) != ticket->generation) {
+        return true;
+    }
+    if (!completionSpace(ring, ticket->producer)) {
+        return false;
+    }
+    uint64_t position = target->tail;
+    ringCompletion *slot = &ring->completions[(size_t)ticket->producer * (ring->mask + 1) + (position & ring->mask)];
+    slot->tag = ticket->tag;
+    slot->generation = ticket->generation;
+    slot->valid = valid;
+    __atomic_store_n(&target->tail, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+/*
+ * Function: wakeForSpace
+ * ----------------------
+ * Wakes the producers asleep until a submission slot frees, after the validator took some grids. The
+ * fence pairs with the announcement in ringWait like the one in wakeIfSleeping.
+ */
+
+static void wakeForSpace(ringChannel *ring) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->header->spaceSleepers, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+    for (unsigned id = 0; id < ring->header->producers; id++) {
+        ringProducer *producer = &ring->producers[id];
+        if (__atomic_load_n(&producer->waitFor, __ATOMIC_RELAXED) & RING_WAIT_SPACE) {
+            wakeIfSleeping(&producer->wake, &producer->sleeping);
+        }
+    }
+}
+
+
+/*
+ * Function: requestStop
+ * ---------------------
+ * Signal handler that asks ring serve to shut down.
+ */
+
+static void requestStop(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+
+/*
+ * Function: ringServe
+ * -------------------
+ * Validator loop: takes up to RING_BATCH grids per pass, validates them, and posts each verdict to the
+ * completion ring of the producer that submitted it. Each producer that got verdicts is woken once per
+ * pass, and only if it is asleep. Runs until SIGINT or SIGTERM.
+ *
+ * Returns: The number of grids validated.
+ */
+
+static uint64_t ringServe(ringChannel *ring) {
+    gridCell grids[RING_BATCH][SIZE][SIZE];
+    ringTicket tickets[RING_BATCH];
+    uint32_t woken[RING_BATCH];
+    ringHeader *header = ring->header;
+    bool (*check)(const gridCell[SIZE][SIZE]) = header->puzzle ? validatePuzzle : validateBitmask;
+    uint64_t served = 0;
+    int idle = 0;
+
+    while (!stopRequested) {
+        size_t n = 0;
+        while (n < RING_BATCH && takeSubmission(ring, grids[n], &tickets[n])) {
+            n++;
+        }
+        if (n == 0) {
+            if (++idle < RING_IDLE_SPINS) {
+                sched_yield();
+            } else {
+                sleepUntil(&header->validatorWake, &header->validatorSleeping, submissionReady, ring, 0);
+                idle = 0;
+            }
+            continue;
+        }
+        idle = 0;
+        wakeForSpace(ring);
+
+        size_t wakes = 0;
+        for (size_t i = 0; i < n && !stopRequested; i++) {
+            bool valid = check(grids[i]);
+            if (tickets[i].producer >= header->producers) {
+                continue; // Not from a producer of this ring
+            }
+            ringProducer *target = &ring->producers[tickets[i].producer];
+            while (!postCompletion(ring, &tickets[i], valid) && !stopRequested) {
+                // Only verdicts a detached producer left behind can fill a ring; the new owner drops them
+                wakeIfSleeping(&target->wake, &target->sleeping);
+                sleepUntil(&header->validatorWake, &header->validatorSleeping, completionSpace, ring,
+                           tickets[i].producer);
+            }
+            size_t k = 0;
+            while (k < wakes && woken[k] != tickets[i].producer) {
+                k++;
+            }
+            if (k == wakes) {
+                woken[wakes++] = tickets[i].producer;
+            }
+        }
+        served += n;
+        for (size_t i = 0; i < wakes; i++) {
+            wakeIfSleeping(&ring->producers[woken[i]].wake, &ring->producers[woken[i]].sleeping);
+        }
+    }
+    return served;
+}
+
+
+/*
+ * Function: ringProduce
+ * ---------------------
+ * Producer loop for ring submit: streams a corpus into the ring, keeping it as full as the producer can,
+ * and writes each verdict as it comes back, one line per grid as batch prints them.
+ *
+ * Returns: true on success, false if the ring closed early or output failed.
+ */
+
+static bool ringProduce(ringChannel *ring, corpusStream *stream, size_t *count, size_t *valid) {
+    static gridCell grids[4096][SIZE][SIZE];
+    size_t loaded = 0, next = 0;
+    uint64_t submitted = 0, reaped = 0;
+    bool inputDone = false;
+    outputBuffer out;
+
+    if (!outputInit(&out, STDOUT_FILENO, 1 << 16)) {
+        return false;
+    }
+    while (!inputDone || reaped < submitted) {
+        bool progress = false;
+
+        if (next == loaded && !inputDone) {
+            loaded = corpusNext(stream, grids, sizeof(grids) / sizeof(grids[0]));
+            next = 0;
+            inputDone = loaded == 0;
+        }
+        while (next < loaded && ringSubmit(ring, grids[next], submitted)) {
+            next++;
+            submitted++;
+            progress = true;
+        }
+
+        uint64_t tag;
+        bool verdict;
+        while (ringReap(ring, &tag, &verdict)) {
+            if (tag != reaped) {
+                fprintf(stderr, "Verdict for grid %llu arrived out of order\n",
+                        (unsigned long long)tag);
+                outputFree(&out);
+                return false;
+            }
+            outputString(&out, verdict ? "valid\n" : "INVALID\n");
+            *valid += verdict;
+            reaped++;
+            progress = true;
+        }
+
+        if (!progress) {
+            if (ringClosed(ring)) {
+                fprintf(stderr, "The validator closed the ring with %llu grids outstanding\n",
+                        (unsigned long long)(submitted - reaped));
+                outputFree(&out);
+                return false;
+            }
+            // Room for a grid only helps while there are grids to send and verdicts left to make room for
+            unsigned waitFor = reaped < submitted ? RING_WAIT_VERDICT : 0;
+            if (next < loaded && submitted - reaped <= ring->mask) {
+                waitFor |= RING_WAIT_SPACE;
+            }
+            ringWait(ring, waitFor);
+        }
+    }
+    *count = (size_t)submitted;
+    bool ok = outputFlush(&out);
+    outputFree(&out);
+    return ok;
+}
+
+
+/*
+ * Function: ringUsage
+ * -------------------
+ * Prints the options accepted by the ring subcommand.
+ */
+
+static void ringUsage(void) {
+    fprintf(stderr,
+            "Usage: ring serve [--slots N] [--producers P] [--puzzle] <name>\n"
+            "       ring submit <name> <corpus_file>\n"
+            "  serve          Create shared memory ring <name> and validate grids producers submit to it,\n"
+            "                 until interrupted\n"
+            "  submit         Stream a corpus through ring <name> and print one verdict line per grid\n"
+            "  --slots N      Slots in the submission ring and in each completion ring (default %d)\n"
+            "  --producers P  Producers that can be attached at once, each with its own completion ring\n"
+            "                 (default %d, at most %d)\n"
+            "  --puzzle       Check unsolved puzzles: only the givens must not conflict\n",
+            RING_DEFAULT_SLOTS, RING_DEFAULT_PRODUCERS, RING_MAX_PRODUCERS);
+}
+
+
+/*
+ * Function: ringMain
+ * ------------------
+ * Entry point of the ring subcommand. `ring serve` runs the validator side of a shared memory ring;
+ * `ring submit` is a producer that feeds it a corpus, for testing and benchmarking the interface.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on bad options or a ring that cannot be created or used.
+ */
+
+int ringMain(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "serve") == 0) {
+        unsigned slots = RING_DEFAULT_SLOTS, producers = RING_DEFAULT_PRODUCERS;
+        bool puzzle = false;
+        const char *name = NULL;
+
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--slots") == 0 && i + 1 < argc) {
+                slots = (unsigned)strtoul(argv[++i], NULL, 10);
+            } else if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) {
+                producers = (unsigned)strtoul(argv[++i], NULL, 10);
+            } else if (strcmp(argv[i], "--puzzle") == 0) {
+                puzzle = true;
+            } else if (argv[i][0] != '-' && !name) {
+                name = argv[i];
+            } else {
+                ringUsage();
+                return EXIT_FAILURE;
+            }
+        }
+        if (!name || slots == 0 || producers == 0 || producers > RING_MAX_PRODUCERS) {
+            ringUsage();
+            return EXIT_FAILURE;
+        }
+
+        ringChannel *ring = ringCreate(name, slots, producers, puzzle);
+        if (!ring) {
+            fprintf(stderr, "%s: %s\n", name, errno == EEXIST ? "a ring of that name already exists" : strerror(errno));
+            return EXIT_FAILURE;
+        }
+        struct sigaction action = {0};
+        action.sa_handler = requestStop;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+
+        fprintf(stderr, "%s: serving %u-slot rings for up to %u producers\n", name, ring->header->slots,
+                ring->header->producers);
+        uint64_t served = ringServe(ring);
+        ringClose(ring);
+        fprintf(stderr, "%s: %llu grids validated\n", name, (unsigned long long)served);
+        return EXIT_SUCCESS;
+    }
+
+    if (argc == 4 && strcmp(argv[1], "submit") == 0) {
+        ringChannel *ring = ringAttach(argv[2]);
+        if (!ring) {
+            fprintf(stderr, "%s: %s\n", argv[2],
+                    errno == EINVAL ? "not a sudoku ring for this grid size"
+                    : errno == EBUSY ? "every producer slot of the ring is taken"
+                                     : strerror(errno));
+            return EXIT_FAILURE;
+        }
+        corpusStream *stream = corpusOpen(argv[3]);
+        if (!stream) {
+            perror("Error opening corpus");
+            ringClose(ring);
+            return EXIT_FAILURE;
+        }
+
+        size_t count = 0, valid = 0;
+        bool ok = ringProduce(ring, stream, &count, &valid);
+        if (ok && corpusError(stream)) {
+            errno = corpusError(stream);
+            perror("Error reading corpus");
+            ok = false;
+        }
+        corpusClose(stream);
+        ringClose(ring);
+        if (ok) {
+            fprintf(stderr, "%s: %zu grids, %zu valid, %zu INVALID\n", argv[3], count, valid, count - valid);
+        }
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    ringUsage();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,454 @@
+/*
+ * File: Sudoku-Scheduler.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Work-stealing thread pool shared by the batch validator, the solvers, and the generator.
+ *              Every worker owns a Chase-Lev deque: it pushes and pops tasks at the bottom without
+ *              locking, while idle workers steal from the top of someone else's deque with a single
+ *              compare-and-swap. Tasks submitted from outside the pool go through a small injection
+ *              queue. Idle workers spin briefly, then sleep until new work is submitted.
+ */
+
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+// Slots per worker deque; a power of two. A worker whose deque is full runs new tasks inline.
+#define DEQUE_CAPACITY 1024
+
+// Rounds of looking for work, yielding in between, before an idle worker goes to sleep.
+#define IDLE_SPINS 64
+
+// Struct for one queued task. Fields are accessed atomically, since a thief may read a slot while
+// its owner refills it.
+typedef struct {
+    void *(*fn)(void *);
+    void *arg;
+} workItem;
+
+// Struct for a Chase-Lev deque. The owner works at the bottom, thieves take from the top; top and
+// bottom sit on separate cache lines so the owner's pushes do not disturb thieves.
+typedef struct {
+    int64_t top __attribute__((aligned(64)));
+    int64_t bottom __attribute__((aligned(64)));
+    workItem items[DEQUE_CAPACITY] __attribute__((aligned(64)));
+} workDeque;
+
+// Struct for one worker thread.
+typedef struct {
+    workDeque deque;
+    workPool *pool;
+    int index;
+    uint64_t seed;       // xorshift state for picking steal victims
+    pthread_t tid;
+} poolWorker;
+
+struct workPool {
+    unsigned threads;
+    unsigned started;            // Worker threads running
+    poolWorker *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;         // Signalled when work is submitted to a pool with sleeping workers
+    pthread_cond_t idle;         // Broadcast when the last pending task finishes
+    workItem *injected;          // Ring of tasks submitted from outside the pool, guarded by lock
+    size_t injectedHead;
+    size_t injectedCount;
+    size_t injectedCapacity;
+    int64_t queued;              // Tasks submitted but not yet started
+    int64_t pending;             // Tasks submitted but not yet finished
+    unsigned sleeping;
+    bool stopping;
+    cpuPlacement placement;      // Applied by each worker as it starts
+};
+
+// The pool and worker index of the calling thread; NULL and -1 outside any pool.
+static __thread workPool *currentPool;
+static __thread int currentWorker = -1;
+
+
+/*
+ * Function: dequePush
+ * -------------------
+ * Pushes a task at the bottom of the owner's deque.
+ *
+ * Returns: true on success, false if the deque is full.
+ */
+
+static bool dequePush(workDeque *deque, void *(*fn)(void *), void *arg) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+    if (bottom - top >= DEQUE_CAPACITY) {
+        return false;
+    }
+    workItem *item = &deque->items[bottom & (DEQUE_CAPACITY - 1)];
+    __atomic_store_n(&item->fn, fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&item->arg, arg, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+
+/*
+ * Function: dequeTake
+ * -------------------
+ * Pops the most recently pushed task from the bottom of the owner's deque. Only the last task can be
+ * contended by a thief; the two settle it with a compare-and-swap on top.
+ *
+ * Returns: true if a task was taken, false if the deque is empty.
+ */
+
+static bool dequeTake(workDeque *deque, workItem *out) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    workItem *item = &deque->items[bottom & (DEQUE_CAPACITY - 1)];
+    out->fn = __atomic_load_n(&item->fn, __ATOMIC_RELAXED);
+    out->arg = __atomic_load_n(&item->arg, __ATOMIC_RELAXED);
+    if (top == bottom) {
+        bool won = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST,
+                                               __ATOMIC_RELAXED);
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+
+/*
+ * Function: dequeSteal
+ * --------------------
+ * Takes the oldest task from the top of another worker's deque.
+ *
+ * Returns: true if a task was stolen, false if the deque was empty or another thread got there first.
+ */
+
+static bool dequeSteal(workDeque *deque, workItem *out) {
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom) {
+        return false;
+    }
+    workItem *item = &deque->items[top & (DEQUE_CAPACITY - 1)];
+    out->fn = __atomic_load_n(&item->fn, __ATOMIC_RELAXED);
+    out->arg = __atomic_load_n(&item->arg, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Function: takeInjected
+ * ----------------------
+ * Takes the oldest task submitted from outside the pool.
+ *
+ * Returns: true if a task was taken, false if the injection queue is empty.
+ */
+
+static bool takeInjected(workPool *pool, workItem *out) {
+    bool found = false;
+
+    if (__atomic_load_n(&pool->injectedCount, __ATOMIC_RELAXED) == 0) {
+        return false;
+    }
+    pthread_mutex_lock(&pool->lock);
+    if (pool->injectedCount > 0) {
+        *out = pool->injected[pool->injectedHead];
+        pool->injectedHead = (pool->injectedHead + 1) % pool->injectedCapacity;
+        __atomic_store_n(&pool->injectedCount, pool->injectedCount - 1, __ATOMIC_RELAXED);
+        found = true;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return found;
+}
+
+
+/*
+ * Function: findWork
+ * ------------------
+ * Looks for a task: the worker's own deque first, then the injection queue, then the other workers'
+ * deques starting from a random victim.
+ *
+ * Returns: true if a task was found, false otherwise.
+ */
+
+static bool findWork(poolWorker *worker, workItem *out) {
+    workPool *pool = worker->pool;
+
+    if (dequeTake(&worker->deque, out) || takeInjected(pool, out)) {
+        return true;
+    }
+    worker->seed ^= worker->seed << 13;
+    worker->seed ^= worker->seed >> 7;
+    worker->seed ^= worker->seed << 17;
+    for (unsigned i = 0, start = (unsigned)(worker->seed % pool->threads); i < pool->threads; i++) {
+        poolWorker *victim = &pool->workers[(start + i) % pool->threads];
+        if (victim != worker && dequeSteal(&victim->deque, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+ * Function: runItem
+ * -----------------
+ * Runs a task that has been taken off a queue and wakes poolWait callers once nothing is pending.
+ */
+
+static void runItem(workPool *pool, const workItem *item) {
+    __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    item->fn(item->arg);
+    if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->idle);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+/*
+ * Function: workerThread
+ * ----------------------
+ * Main loop of a worker: runs tasks while there are any, spins for a while when there are none, and
+ * then sleeps until a task is submitted or the pool shuts down.
+ *
+ * arg: Pointer to the poolWorker.
+ *
+ * Returns: NULL.
+ */
+
+static void *workerThread(void *arg) {
+    poolWorker *worker = (poolWorker *)arg;
+    workPool *pool = worker->pool;
+    workItem item;
+
+    currentPool = pool;
+    currentWorker = worker->index;
+    placeWorkerThread(&pool->placement, (unsigned)worker->index);
+    for (;;) {
+        bool found = false;
+        for (int spin = 0; spin < IDLE_SPINS && !found; spin++) {
+            found = findWork(worker, &item);
+            if (!found && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) <= 0) {
+                sched_yield();
+            }
+        }
+        if (found) {
+            runItem(pool, &item);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (!pool->stopping && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) <= 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+        bool stop = pool->stopping && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) <= 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) {
+            return NULL;
+        }
+    }
+}
+
+
+/*
+ * Function: poolCreate
+ * --------------------
+ * Starts a pool of worker threads.
+ *
+ * threads: Number of workers (at least 1).
+ * placement: CPUs to place the workers on, or NULL to leave them to the scheduler.
+ *
+ * Returns: The pool, or NULL if memory or threads could not be obtained.
+ */
+
+workPool *poolCreate(unsigned threads, const cpuPlacement *placement) {
+    workPool *pool = calloc(1, sizeof(*pool));
+    if (!pool || threads == 0) {
+        free(pool);
+        return NULL;
+    }
+    pool->workers = aligned_alloc(64, threads * sizeof(*pool->workers));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+    memset(pool->workers, 0, threads * sizeof(*pool->workers));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    // Every worker may steal from every deque, so all of them exist before the first thread starts
+    pool->threads = threads;
+    if (placement) {
+        pool->placement = *placement;
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        pool->workers[t].pool = pool;
+        pool->workers[t].index = (int)t;
+        pool->workers[t].seed = 0x9E3779B97F4A7C15u * (t + 1);
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        if (pthread_create(&pool->workers[t].tid, NULL, workerThread, &pool->workers[t]) != 0) {
+            pool->started = t;
+            poolDestroy(pool);
+            return NULL;
+        }
+    }
+    pool->started = threads;
+    return pool;
+}
+
+
+/*
+ * Function: poolSize
+ * ------------------
+ * Returns: The number of worker threads in a pool.
+ */
+
+unsigned poolSize(const workPool *pool) {
+    return pool->threads;
+}
+
+
+/*
+ * Function: poolWorkerIndex
+ * -------------------------
+ * Returns: The index (0..poolSize - 1) of the calling worker thread, or -1 outside a pool. A worker
+ *          runs one task at a time, so tasks can use the index to pick per-worker scratch state.
+ */
+
+int poolWorkerIndex(void) {
+    return currentWorker;
+}
+
+
+/*
+ * Function: poolSubmit
+ * --------------------
+ * Queues a task. Called from one of the pool's own workers, the task goes on that worker's deque,
+ * where it runs next unless a thief gets to it first; from any other thread it goes on the injection
+ * queue. If the task cannot be queued it runs on the calling thread before poolSubmit returns.
+ *
+ * params:
+ *      pool: The pool.
+ *      fn: The task; its return value is ignored.
+ *      arg: Argument passed to fn.
+ *
+ * Returns: void.
+ */
+
+void poolSubmit(workPool *pool, void *(*fn)(void *), void *arg) {
+    workItem item = {fn, arg};
+    bool queued;
+
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    if (currentPool == pool) {
+        queued = dequePush(&pool->workers[currentWorker].deque, fn, arg);
+    } else {
+        pthread_mutex_lock(&pool->lock);
+        queued = true;
+        if (pool->injectedCount == pool->injectedCapacity) {
+            size_t capacity = pool->injectedCapacity ? 2 * pool->injectedCapacity : 64;
+            workItem *ring = malloc(capacity * sizeof(*ring));
+            if (ring) {
+                for (size_t i = 0; i < pool->injectedCount; i++) {
+                    ring[i] = pool->injected[(pool->injectedHead + i) % pool->injectedCapacity];
+                }
+                free(pool->injected);
+                pool->injected = ring;
+                pool->injectedHead = 0;
+                pool->injectedCapacity = capacity;
+            } else {
+                queued = false;
+            }
+        }
+        if (queued) {
+            pool->injected[(pool->injectedHead + pool->injectedCount) % pool->injectedCapacity] = item;
+            __atomic_store_n(&pool->injectedCount, pool->injectedCount + 1, __ATOMIC_RELAXED);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    if (!queued) {
+        runItem(pool, &item);
+        return;
+    }
+    if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+/*
+ * Function: poolWantsWork
+ * -----------------------
+ * Reports whether the pool has run out of queued tasks, so a long-running task on one of its workers
+ * should split off part of its work for idle workers to steal.
+ */
+
+bool poolWantsWork(const workPool *pool) {
+    return pool->threads > 1 && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) <= 0;
+}
+
+
+/*
+ * Function: poolWait
+ * ------------------
+ * Blocks until every task submitted so far, and every task those tasks submitted, has finished.
+ * Must be called from outside the pool.
+ */
+
+void poolWait(workPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/*
+ * Function: poolDestroy
+ * ---------------------
+ * Lets the workers finish any queued tasks, stops them, and frees the pool. Accepts NULL.
+ */
+
+void poolDestroy(workPool *pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (unsigned t = 0; t < pool->started; t++) {
+        pthread_join(pool->workers[t].tid, NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->injected);
+    free(pool->workers);
+    free(pool);
+}
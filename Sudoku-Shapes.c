@@ -0,0 +1,261 @@
+/*
+ * File: Sudoku-Shapes.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Validation of grids with any box shape, where box height and width are independent:
+ *              6x6 with 2x3 boxes, 12x12 with 3x4 boxes, 16x16 with 4x4 boxes, and so on. The common
+ *              shapes get single-pass bitmask kernels compiled with the box dimensions as constants;
+ *              any other shape runs the same check with the dimensions read at run time. Also holds the
+ *              text reader for grids of any order.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+// Struct for one entry of the kernel table.
+typedef struct {
+    int boxRows, boxCols;
+    bool (*solution)(const gridCell *cells);
+    bool (*puzzle)(const gridCell *cells);
+} shapeKernelEntry;
+
+
+/*
+ * Function: checkShape
+ * --------------------
+ * Validates a grid in a single pass, keeping a bitmask of the numbers seen per row, column, and box,
+ * as validateBitmask does for 9x9. Always inlined: the kernels below call it with constant box
+ * dimensions, so the compiler fixes the loop bounds and turns the box divisions into multiplies.
+ *
+ * params:
+ *      cells: order^2 cells in row-major order.
+ *      boxRows, boxCols: Box height and width.
+ *      allowEmpty: Puzzle mode: 0 is an empty cell and only the givens must not repeat.
+ *
+ * Returns: true if the grid is valid, false otherwise.
+ */
+
+static inline __attribute__((always_inline)) bool checkShape(const gridCell *cells, int boxRows, int boxCols,
+                                                             bool allowEmpty) {
+    int order = boxRows * boxCols, boxesPerBand = order / boxCols;
+    uint64_t rows[MAX_ORDER], cols[MAX_ORDER], boxes[MAX_ORDER];
+
+    memset(rows, 0, (size_t)order * sizeof(rows[0]));
+    memset(cols, 0, (size_t)order * sizeof(cols[0]));
+    memset(boxes, 0, (size_t)order * sizeof(boxes[0]));
+    for (int r = 0; r < order; r++) {
+        int band = (r / boxRows) * boxesPerBand;
+        for (int c = 0; c < order; c++) {
+            unsigned num = (unsigned)cells[r * order + c];
+            if (allowEmpty && num == 0) {
+                continue;
+            }
+            num--; // Out-of-range numbers wrap to a large value
+            if (num >= (unsigned)order) {
+                return false;
+            }
+            uint64_t bit = (uint64_t)1 << num;
+            int box = band + c / boxCols;
+            if ((rows[r] | cols[c] | boxes[box]) & bit) {
+                return false;
+            }
+            rows[r] |= bit;
+            cols[c] |= bit;
+            boxes[box] |= bit;
+        }
+    }
+    return true;
+}
+
+
+// Kernels for the common shapes: one for complete grids and one for puzzles per box height and width.
+#define SHAPE_KERNELS(R, C)                                                                     \
+    static bool validate##R##x##C(const gridCell *cells) { return checkShape(cells, R, C, false); } \
+    static bool puzzle##R##x##C(const gridCell *cells) { return checkShape(cells, R, C, true); }
+
+SHAPE_KERNELS(2, 2)
+SHAPE_KERNELS(2, 3)
+SHAPE_KERNELS(3, 2)
+SHAPE_KERNELS(2, 4)
+SHAPE_KERNELS(4, 2)
+SHAPE_KERNELS(3, 3)
+SHAPE_KERNELS(3, 4)
+SHAPE_KERNELS(4, 3)
+SHAPE_KERNELS(4, 4)
+
+#define SHAPE_ENTRY(R, C) {R, C, validate##R##x##C, puzzle##R##x##C}
+
+static const shapeKernelEntry kernels[] = {
+    SHAPE_ENTRY(2, 2), SHAPE_ENTRY(2, 3), SHAPE_ENTRY(3, 2), SHAPE_ENTRY(2, 4), SHAPE_ENTRY(4, 2),
+    SHAPE_ENTRY(3, 3), SHAPE_ENTRY(3, 4), SHAPE_ENTRY(4, 3), SHAPE_ENTRY(4, 4),
+};
+
+
+/*
+ * Function: parseShape
+ * --------------------
+ * Parses a box shape argument: "RxC" for boxes of R rows by C columns, or a single number B for
+ * square B x B boxes.
+ *
+ * text: The argument.
+ * shape: Receives the shape.
+ *
+ * Returns: true on success, false if the text is malformed or the grid would be larger than MAX_ORDER.
+ */
+
+bool parseShape(const char *text, gridShape *shape) {
+    char *end;
+    long rows = strtol(text, &end, 10), cols = rows;
+
+    if (end == text) {
+        return false;
+    }
+    if (*end == 'x' || *end == 'X') {
+        const char *start = end + 1;
+        cols = strtol(start, &end, 10);
+        if (end == start) {
+            return false;
+        }
+    }
+    if (*end || rows < 1 || cols < 1 || rows * cols > MAX_ORDER) {
+        return false;
+    }
+    shape->boxRows = (int)rows;
+    shape->boxCols = (int)cols;
+    shape->order = (int)(rows * cols);
+    return true;
+}
+
+
+/*
+ * Function: shapeKernel
+ * ---------------------
+ * Looks up the compiled kernel for a shape.
+ *
+ * shape: The box shape.
+ * allowEmpty: Whether the kernel should check puzzles rather than complete grids.
+ *
+ * Returns: The kernel, or NULL if the shape has none and shapeValidate must be used.
+ */
+
+bool (*shapeKernel(const gridShape *shape, bool allowEmpty))(const gridCell *cells) {
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (kernels[i].boxRows == shape->boxRows && kernels[i].boxCols == shape->boxCols) {
+            return allowEmpty ? kernels[i].puzzle : kernels[i].solution;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: shapeValidate
+ * -----------------------
+ * Validates a grid of any shape, with the box dimensions read at run time.
+ *
+ * shape: The box shape.
+ * cells: order^2 cells in row-major order.
+ * allowEmpty: Puzzle mode: 0 is an empty cell and only the givens must not repeat.
+ *
+ * Returns: true if the grid is valid, false otherwise.
+ */
+
+bool shapeValidate(const gridShape *shape, const gridCell *cells, bool allowEmpty) {
+    return checkShape(cells, shape->boxRows, shape->boxCols, allowEmpty);
+}
+
+
+/*
+ * Function: shapeUnitValid
+ * ------------------------
+ * Checks one row, column, or box of a grid of any shape.
+ *
+ * shape: The box shape.
+ * cells: order^2 cells in row-major order.
+ * unit: Unit index in results order (order rows, then order columns, then order boxes).
+ * allowEmpty: Puzzle mode: 0 is an empty cell and only the givens must not repeat.
+ *
+ * Returns: true if the unit is valid, false otherwise.
+ */
+
+bool shapeUnitValid(const gridShape *shape, const gridCell *cells, int unit, bool allowEmpty) {
+    int order = shape->order, kind = unit / order, index = unit % order;
+    int boxesPerBand = order / shape->boxCols;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < order; i++) {
+        int r, c;
+        if (kind == 0) {
+            r = index;
+            c = i;
+        } else if (kind == 1) {
+            r = i;
+            c = index;
+        } else {
+            r = (index / boxesPerBand) * shape->boxRows + i / shape->boxCols;
+            c = (index % boxesPerBand) * shape->boxCols + i % shape->boxCols;
+        }
+        unsigned num = (unsigned)cells[r * order + c];
+        if (allowEmpty && num == 0) {
+            continue;
+        }
+        num--;
+        if (num >= (unsigned)order || (seen & ((uint64_t)1 << num))) {
+            return false;
+        }
+        seen |= (uint64_t)1 << num;
+    }
+    return true;
+}
+
+
+/*
+ * Function: readGridText
+ * ----------------------
+ * Reads the next grid of any order from a text file: whitespace-separated numbers, or one-line grids
+ * with '1'-'9' and 'A'... ('a'...) for 10 and up. '.' or 0 is an empty cell in either layout.
+ *
+ * file: The open file.
+ * order: Side length of the grids.
+ * cells: Receives order^2 cells.
+ *
+ * Returns: true if a full grid was read, false at the end of the file or a malformed token.
+ */
+
+bool readGridText(FILE *file, int order, gridCell *cells) {
+    int total = order * order, cell = 0;
+    char token[1024];
+
+    while (cell < total && fscanf(file, "%1023s", token) == 1) {
+        size_t length = strlen(token);
+        bool oneLine = (int)length == total || length == 1 || strchr(token, '.');
+        if (!oneLine) {
+            char *end;
+            long value = strtol(token, &end, 10);
+            if (*end || value < 0) {
+                return false;
+            }
+            cells[cell++] = toCell(value);
+            continue;
+        }
+        for (size_t i = 0; i < length && cell < total; i++) {
+            char ch = token[i];
+            if (ch == '.' || ch == '0') {
+                cells[cell++] = 0;
+            } else if (ch >= '1' && ch <= '9') {
+                cells[cell++] = ch - '0';
+            } else if (ch >= 'A' && ch <= 'Z') {
+                cells[cell++] = ch - 'A' + 10;
+            } else if (ch >= 'a' && ch <= 'z') {
+                cells[cell++] = ch - 'a' + 10;
+            } else {
+                return false;
+            }
+        }
+    }
+    return cell == total;
+}
@@ -0,0 +1,977 @@
+/*
+ * File: Sudoku-Solver.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Constraint-propagation solver for partial grids. Every cell holds a bitmask of its
+ *              remaining candidates; placing a number strips it from the cell's peers (naked singles
+ *              cascade from there), each unit is scanned for numbers with only one possible cell
+ *              (hidden singles), and when propagation stalls the search branches on the cell with the
+ *              fewest candidates, or on the cells of a unit left for some number when those are fewer.
+ *              The whole search state is a small array copied by value at each branch, so the search
+ *              never touches the heap; a parallel search draws its subtree tasks from slots allocated
+ *              before it starts. Also provides the solve subcommand.
+ */
+
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+// The candidate tables and locked-candidate scans below assume 3x3 boxes; the dlx engine (--engine dlx
+// --box RxC) solves other shapes at run time.
+#if BOX_ROWS != 3 || BOX_COLS != 3
+#error "Sudoku-Solver.c supports only 3x3 boxes"
+#endif
+
+#define ALL_CANDIDATES ((1u << SIZE) - 1)
+
+// Puzzles per worker chunk in the solve subcommand.
+#define SOLVE_CHUNK_GRIDS 1024
+
+// Search nodes a batch worker spends on one puzzle before handing it to a parallel search.
+#define SOLVE_NODE_BUDGET 2048
+
+// Subtrees per thread a parallel search aims for, and the most it keeps. FRONTIER_MAX is also the
+// number of subtree tasks a parallel search can have queued or running at once.
+#define FRONTIER_PER_THREAD 8
+#define FRONTIER_MAX 4096
+
+// Number of candidates in every possible mask, built at compile time so counting never needs a
+// popcount instruction the target may lack.
+#define COUNT2(n) n, n + 1, n + 1, n + 2
+#define COUNT4(n) COUNT2(n), COUNT2(n + 1), COUNT2(n + 1), COUNT2(n + 2)
+#define COUNT6(n) COUNT4(n), COUNT4(n + 1), COUNT4(n + 1), COUNT4(n + 2)
+#define COUNT8(n) COUNT6(n), COUNT6(n + 1), COUNT6(n + 1), COUNT6(n + 2)
+static const unsigned char candidateCount[1 << SIZE] = {COUNT8(0), COUNT8(1)};
+
+// Struct for the search state: one candidate bitmask per cell (bit n - 1 for number n). A cell with
+// a single candidate is solved.
+typedef struct {
+    uint16_t cells[SIZE * SIZE];
+} solverState;
+
+// Struct for the placements a search node branches on, which between them cover every solution: each
+// candidate of one cell, or each cell of one unit that can hold a number.
+typedef struct {
+    int count;
+    unsigned char cells[SIZE];
+    uint16_t bits[SIZE];
+} solverBranch;
+
+// Struct for a search split across the workers of a pool. The top of the search tree is expanded
+// breadth-first into subtrees, each submitted as a task. A task that sees the pool run dry hands
+// untried branches of its subtree back to the pool, where idle workers steal them.
+typedef struct parallelSearch {
+    workPool *pool;
+    int limit;
+    int found;           // Solutions found by every task
+    pthread_mutex_t lock;
+    bool haveFirst;
+    solverState first;
+    struct subtreeTask *freeTasks; // Task slots not in use, guarded by lock
+} parallelSearch;
+
+// Struct for one subtree of a parallel search, owned by the task that searches it.
+typedef struct subtreeTask {
+    parallelSearch *par;
+    struct subtreeTask *nextFree;
+    solverState state;
+} subtreeTask;
+
+// Struct for one depth-first search, either a whole solveGrid call or one subtree of a parallel search.
+typedef struct {
+    int limit;           // Stop after this many solutions
+    int found;           // Solutions found by this search
+    parallelSearch *par; // The parallel search this is part of, or NULL
+    uint64_t nodes;
+    uint64_t budget;     // Give up after this many nodes; 0 for no limit
+    bool exhausted;      // The budget ran out before the search finished
+    solverState first;   // The first solution found
+} solverSearch;
+
+// Struct describing the chunk one solve worker is responsible for.
+typedef struct {
+    const gridCell (*grids)[SIZE][SIZE];
+    size_t count;
+    int limit;
+    uint64_t budget;         // Search nodes per puzzle; 0 for no limit
+    signed char *outcomes;   // Solutions found per puzzle, or -1 if the node budget ran out
+    gridCell (*solutions)[SIZE][SIZE];
+} solveTask;
+
+
+/*
+ * Function: isSingle
+ * ------------------
+ * Reports whether a candidate mask holds exactly one number.
+ */
+
+static inline bool isSingle(unsigned mask) {
+    return (mask & (mask - 1)) == 0;
+}
+
+
+/*
+ * Function: place
+ * ---------------
+ * Fixes a cell to one number and removes that number from all of its peers. Peers left with a single
+ * candidate are fixed in turn (naked singles), until nothing more follows.
+ *
+ * state: The search state.
+ * cell: Row-major cell index.
+ * bit: Candidate bit of the number to place; must be one of the cell's candidates.
+ *
+ * Returns: false if some cell ran out of candidates, true otherwise.
+ */
+
+static bool place(solverState *state, int cell, unsigned bit) {
+    unsigned char pending[SIZE * SIZE];
+    int top = 0;
+
+    state->cells[cell] = (uint16_t)bit;
+    pending[top++] = (unsigned char)cell;
+    while (top > 0) {
+        int from = pending[--top];
+        unsigned remove = state->cells[from];
+        for (int i = 0; i < NUM_PEERS; i++) {
+            int peer = cellPeers[from][i];
+            unsigned mask = state->cells[peer];
+            if (!(mask & remove)) {
+                continue;
+            }
+            mask &= ~remove;
+            if (mask == 0) {
+                return false;
+            }
+            state->cells[peer] = (uint16_t)mask;
+            if (isSingle(mask)) {
+                pending[top++] = (unsigned char)peer;
+            }
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: hiddenSingles
+ * -----------------------
+ * Scans every unit for numbers that fit in only one of its cells and places them there.
+ *
+ * state: The search state.
+ * changed: Set to true if any number was placed.
+ *
+ * Returns: false if some unit has no room left for a number, true otherwise.
+ */
+
+static bool hiddenSingles(solverState *state, bool *changed) {
+    for (int unit = 0; unit < NUM_THREADS; unit++) {
+        const unsigned char *cells = unitCells[unit];
+        unsigned once = 0, twice = 0, solved = 0;
+        for (int i = 0; i < SIZE; i++) {
+            unsigned mask = state->cells[cells[i]];
+            twice |= once & mask;
+            once |= mask;
+            solved |= isSingle(mask) ? mask : 0;
+        }
+        if (once != ALL_CANDIDATES) {
+            return false;
+        }
+
+        for (unsigned only = once & ~twice & ~solved; only; only &= only - 1) {
+            unsigned bit = only & -only;
+            int i = 0;
+            while (i < SIZE && !(state->cells[cells[i]] & bit)) {
+                i++;
+            }
+            if (i == SIZE) {
+                return false; // An earlier placement in this unit took the number's last cell
+            }
+            if (state->cells[cells[i]] != bit) {
+                if (!place(state, cells[i], bit)) {
+                    return false;
+                }
+                *changed = true;
+            }
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: eliminate
+ * -------------------
+ * Removes candidates from the cells of a unit that lie outside a given subgrid.
+ *
+ * state: The search state.
+ * unit: The row or column to clear.
+ * box: The subgrid whose cells are left alone.
+ * remove: Candidate bits to remove.
+ * changed: Set to true if any candidate was removed.
+ *
+ * Returns: false if some cell ran out of candidates, true otherwise.
+ */
+
+static bool eliminate(solverState *state, int unit, int box, unsigned remove, bool *changed) {
+    for (int i = 0; i < SIZE; i++) {
+        int cell = unitCells[unit][i];
+        unsigned mask = state->cells[cell];
+        if (!(mask & remove) || cellUnits[cell][2] == box) {
+            continue;
+        }
+        mask &= ~remove;
+        if (mask == 0) {
+            return false;
+        }
+        state->cells[cell] = (uint16_t)mask;
+        *changed = true;
+        if (isSingle(mask) && !place(state, cell, mask)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: lockedCandidates
+ * --------------------------
+ * Applies pointing eliminations: when a number's candidates within a subgrid all lie on one row (or
+ * column), no other cell of that row (or column) can hold the number.
+ *
+ * state: The search state.
+ * changed: Set to true if any candidate was removed.
+ *
+ * Returns: false if some cell ran out of candidates, true otherwise.
+ */
+
+static bool lockedCandidates(solverState *state, bool *changed) {
+    for (int box = 2 * SIZE; box < NUM_THREADS; box++) {
+        const unsigned char *cells = unitCells[box]; // Row-major within the subgrid
+        unsigned rows[3], cols[3], solved = 0;
+
+        for (int k = 0; k < 3; k++) {
+            rows[k] = state->cells[cells[3 * k]] | state->cells[cells[3 * k + 1]] | state->cells[cells[3 * k + 2]];
+            cols[k] = state->cells[cells[k]] | state->cells[cells[k + 3]] | state->cells[cells[k + 6]];
+        }
+        for (int i = 0; i < SIZE; i++) {
+            unsigned mask = state->cells[cells[i]];
+            solved |= isSingle(mask) ? mask : 0;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            unsigned rowOnly = rows[k] & ~(rows[(k + 1) % 3] | rows[(k + 2) % 3]) & ~solved;
+            unsigned colOnly = cols[k] & ~(cols[(k + 1) % 3] | cols[(k + 2) % 3]) & ~solved;
+            if (rowOnly && !eliminate(state, cellUnits[cells[3 * k]][0], box, rowOnly, changed)) {
+                return false;
+            }
+            if (colOnly && !eliminate(state, cellUnits[cells[k]][1], box, colOnly, changed)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: propagate
+ * -------------------
+ * Applies hidden singles and locked candidates until neither makes progress.
+ *
+ * state: The search state.
+ *
+ * Returns: false if the state turned out to be contradictory, true otherwise.
+ */
+
+static bool propagate(solverState *state) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        if (!hiddenSingles(state, &changed)) {
+            return false;
+        }
+        if (!changed && !lockedCandidates(state, &changed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: chooseBranch
+ * ----------------------
+ * Picks the smallest set of placements that between them cover every solution: the candidates of the
+ * unsolved cell with the fewest, or the cells of a unit that can still hold some number, whichever
+ * is fewer. Cells win ties, and with two candidates no unit can do better since propagation has
+ * already placed every hidden single.
+ *
+ * state: The search state, propagated to a fixed point.
+ * branch: Receives the placements to try.
+ *
+ * Returns: false if every cell is solved, true otherwise.
+ */
+
+static bool chooseBranch(const solverState *state, solverBranch *branch) {
+    int best = -1, bestCount = SIZE + 1, bestUnit = -1;
+    unsigned bestBit = 0;
+
+    for (int cell = 0; cell < SIZE * SIZE && bestCount > 2; cell++) {
+        int count = candidateCount[state->cells[cell]];
+        if (count > 1 && count < bestCount) {
+            best = cell;
+            bestCount = count;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+
+    // As in hiddenSingles, bit n of atLeast[k] is set once number n + 1 fits in k cells of the unit.
+    // Placed numbers fit in exactly one, and every other number in two or more.
+    for (int unit = 0; unit < NUM_THREADS && bestCount > 2; unit++) {
+        const unsigned char *cells = unitCells[unit];
+        unsigned atLeast[SIZE + 1] = {ALL_CANDIDATES};
+        for (int i = 0; i < SIZE; i++) {
+            unsigned mask = state->cells[cells[i]];
+            for (int k = bestCount; k > 0; k--) {
+                atLeast[k] |= atLeast[k - 1] & mask;
+            }
+        }
+        for (int k = 2; k < bestCount; k++) {
+            unsigned exactly = atLeast[k] & ~atLeast[k + 1];
+            if (exactly) {
+                bestUnit = unit;
+                bestBit = exactly & -exactly;
+                bestCount = k;
+                break;
+            }
+        }
+    }
+
+    branch->count = 0;
+    if (bestUnit >= 0) {
+        for (int i = 0; i < SIZE; i++) {
+            int cell = unitCells[bestUnit][i];
+            if (state->cells[cell] & bestBit) {
+                branch->cells[branch->count] = (unsigned char)cell;
+                branch->bits[branch->count++] = (uint16_t)bestBit;
+            }
+        }
+    } else {
+        for (unsigned left = state->cells[best]; left; left &= left - 1) {
+            branch->cells[branch->count] = (unsigned char)best;
+            branch->bits[branch->count++] = (uint16_t)(left & -left);
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: toGrid
+ * ----------------
+ * Converts a fully solved state back to a grid of numbers.
+ */
+
+static void toGrid(const solverState *state, gridCell grid[SIZE][SIZE]) {
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+        grid[cell / SIZE][cell % SIZE] = (gridCell)(__builtin_ctz(state->cells[cell]) + 1);
+    }
+}
+
+
+/*
+ * Function: recordSolution
+ * ------------------------
+ * Counts a solved state after confirming it with the validator's bitmask check, so a solver bug can
+ * never report a grid that is not a valid solution.
+ *
+ * run: The search that found the solution.
+ * state: The solved state.
+ *
+ * Returns: void.
+ */
+
+static void recordSolution(solverSearch *run, const solverState *state) {
+    gridCell grid[SIZE][SIZE];
+    toGrid(state, grid);
+    if (!validateBitmask(grid)) {
+        return;
+    }
+    if (run->found++ == 0) {
+        run->first = *state;
+    }
+    if (run->par) {
+        __atomic_fetch_add(&run->par->found, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/*
+ * Function: searchDone
+ * --------------------
+ * Reports whether a search should stop: its budget ran out, or enough solutions have been found by it
+ * or, in a parallel search, by any thread.
+ */
+
+static bool searchDone(const solverSearch *run) {
+    int found = run->par ? __atomic_load_n(&run->par->found, __ATOMIC_RELAXED) : run->found;
+    return run->exhausted || found >= run->limit;
+}
+
+
+static bool spawnSubtree(parallelSearch *par, const solverState *state);
+
+
+/*
+ * Function: search
+ * ----------------
+ * Propagates hidden singles and locked candidates to a fixed point, then branches on the smallest
+ * choice left (a cell's candidates or a number's cells within a unit), trying each placement on a copy
+ * of the state. In a parallel search, branches other than the last are handed to the pool instead
+ * while it has no queued work.
+ *
+ * state: The search state, modified in place.
+ * run: The search this node belongs to.
+ *
+ * Returns: void.
+ */
+
+static void search(solverState *state, solverSearch *run) {
+    if (run->budget && ++run->nodes > run->budget) {
+        run->exhausted = true;
+        return;
+    }
+    if (!propagate(state)) {
+        return;
+    }
+
+    solverBranch branch;
+    if (!chooseBranch(state, &branch)) {
+        recordSolution(run, state);
+        return;
+    }
+
+    for (int i = 0; i < branch.count && !searchDone(run); i++) {
+        solverState next = *state;
+        if (!place(&next, branch.cells[i], branch.bits[i])) {
+            continue;
+        }
+        if (run->par && i + 1 < branch.count && poolWantsWork(run->par->pool) && spawnSubtree(run->par, &next)) {
+            continue;
+        }
+        search(&next, run);
+    }
+}
+
+
+/*
+ * Function: initState
+ * -------------------
+ * Builds the starting state of a puzzle where 0 marks an empty cell, placing every given.
+ *
+ * Returns: false if a given is out of range or conflicts with another, true otherwise.
+ */
+
+static bool initState(solverState *state, const gridCell puzzle[SIZE][SIZE]) {
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+        state->cells[cell] = ALL_CANDIDATES;
+    }
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+        unsigned value = (unsigned)puzzle[cell / SIZE][cell % SIZE];
+        if (value == 0) {
+            continue;
+        }
+        if (value > SIZE || !(state->cells[cell] & (1u << (value - 1))) ||
+            !place(state, cell, 1u << (value - 1))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: solveBudgeted
+ * -----------------------
+ * Runs a single-threaded search, optionally giving up after a number of nodes.
+ *
+ * params:
+ *      puzzle: The 9x9 puzzle.
+ *      solution: Receives the first solution found; may be NULL.
+ *      limit: Stop once this many solutions have been found.
+ *      budget: Most search nodes to visit; 0 for no limit.
+ *
+ * Returns: The number of solutions found, or -1 if the budget ran out first.
+ */
+
+static int solveBudgeted(const gridCell puzzle[SIZE][SIZE], gridCell solution[SIZE][SIZE], int limit, uint64_t budget) {
+    solverSearch run = {.limit = limit > 0 ? limit : 1, .budget = budget};
+    solverState state;
+
+    if (!initState(&state, puzzle)) {
+        return 0;
+    }
+    search(&state, &run);
+    if (run.exhausted) {
+        return -1;
+    }
+    if (run.found > 0 && solution) {
+        toGrid(&run.first, solution);
+    }
+    return run.found;
+}
+
+
+/*
+ * Function: solveGrid
+ * -------------------
+ * Solves a puzzle where 0 marks an empty cell. Every solution counted has passed validateBitmask.
+ * A limit of 2 answers whether the puzzle has exactly one solution.
+ *
+ * params:
+ *      puzzle: The 9x9 puzzle.
+ *      solution: Receives the first solution found; may be NULL. Untouched if there is none.
+ *      limit: Stop searching once this many solutions have been found (at least 1).
+ *
+ * Returns: The number of solutions found, at most limit; 0 if the puzzle has none or its givens are
+ *          out of range or conflict.
+ */
+
+int solveGrid(const gridCell puzzle[SIZE][SIZE], gridCell solution[SIZE][SIZE], int limit) {
+    return solveBudgeted(puzzle, solution, limit, 0);
+}
+
+
+/*
+ * Function: expandFrontier
+ * ------------------------
+ * Splits the top of the search tree breadth-first until there are enough subtrees to keep every worker
+ * busy. Solutions met on the way are counted directly.
+ *
+ * params:
+ *      par: The parallel search.
+ *      frontier: Array of FRONTIER_MAX states, holding the root state on entry.
+ *      target: Number of subtrees to aim for.
+ *
+ * Returns: The number of subtrees left in the frontier.
+ */
+
+static int expandFrontier(parallelSearch *par, solverState *frontier, int target) {
+    solverSearch run = {.limit = par->limit};
+    int total = 1;
+
+    while (total > 0 && total < target && total * (SIZE + 1) <= FRONTIER_MAX && run.found < run.limit) {
+        int count = total;
+        total = 0;
+        // Children go after the parents still waiting to be expanded, then move down
+        for (int i = 0; i < count && run.found < run.limit; i++) {
+            solverState *state = &frontier[i];
+            if (!propagate(state)) {
+                continue;
+            }
+            solverBranch branch;
+            if (!chooseBranch(state, &branch)) {
+                recordSolution(&run, state);
+                continue;
+            }
+            for (int k = 0; k < branch.count; k++) {
+                solverState *child = &frontier[count + total];
+                *child = *state;
+                if (place(child, branch.cells[k], branch.bits[k])) {
+                    total++;
+                }
+            }
+        }
+        memmove(frontier, frontier + count, (size_t)total * sizeof(*frontier));
+    }
+
+    par->found = run.found;
+    if (run.found > 0) {
+        par->haveFirst = true;
+        par->first = run.first;
+    }
+    return run.found < run.limit ? total : 0;
+}
+
+
+/*
+ * Function: keepFirst
+ * -------------------
+ * Records a subtree's first solution as the parallel search's, unless another subtree got there first.
+ */
+
+static void keepFirst(parallelSearch *par, const solverSearch *run) {
+    if (run->found > 0) {
+        pthread_mutex_lock(&par->lock);
+        if (!par->haveFirst) {
+            par->haveFirst = true;
+            par->first = run->first;
+        }
+        pthread_mutex_unlock(&par->lock);
+    }
+}
+
+
+/*
+ * Function: subtreeWorker
+ * -----------------------
+ * Pool task that searches one subtree of a parallel search, unless enough solutions have been found
+ * already, and returns its slot.
+ *
+ * arg: Pointer to a subtreeTask.
+ *
+ * Returns: NULL.
+ */
+
+static void *subtreeWorker(void *arg) {
+    subtreeTask *task = (subtreeTask *)arg;
+    parallelSearch *par = task->par;
+
+    if (__atomic_load_n(&par->found, __ATOMIC_RELAXED) < par->limit) {
+        solverSearch run = {.limit = par->limit, .par = par};
+        search(&task->state, &run);
+        keepFirst(par, &run);
+    }
+    pthread_mutex_lock(&par->lock);
+    task->nextFree = par->freeTasks;
+    par->freeTasks = task;
+    pthread_mutex_unlock(&par->lock);
+    return NULL;
+}
+
+
+/*
+ * Function: spawnSubtree
+ * ----------------------
+ * Submits a subtree of a parallel search to the pool, in a free task slot.
+ *
+ * par: The parallel search.
+ * state: The subtree's root, copied into the task.
+ *
+ * Returns: true on success, false if every slot is in use (the caller searches it instead).
+ */
+
+static bool spawnSubtree(parallelSearch *par, const solverState *state) {
+    pthread_mutex_lock(&par->lock);
+    subtreeTask *task = par->freeTasks;
+    if (task) {
+        par->freeTasks = task->nextFree;
+    }
+    pthread_mutex_unlock(&par->lock);
+    if (!task) {
+        return false;
+    }
+    task->par = par;
+    task->state = *state;
+    poolSubmit(par->pool, subtreeWorker, task);
+    return true;
+}
+
+
+/*
+ * Function: solveGridParallel
+ * ---------------------------
+ * Solves one puzzle on all workers of a pool. Meant for hard puzzles, where the search tree is large
+ * enough to be worth splitting; otherwise behaves like solveGrid. Which solution is stored may vary
+ * between runs when the puzzle has more than one. Must be called from outside the pool.
+ *
+ * params:
+ *      puzzle: The 9x9 puzzle.
+ *      solution: Receives a solution; may be NULL. Untouched if there is none.
+ *      limit: Stop searching once this many solutions have been found (at least 1).
+ *      pool: The workers to search with; NULL searches on the calling thread.
+ *
+ * Returns: The number of solutions found, at most limit.
+ */
+
+int solveGridParallel(const gridCell puzzle[SIZE][SIZE], gridCell solution[SIZE][SIZE], int limit, workPool *pool) {
+    parallelSearch par = {.pool = pool, .limit = limit > 0 ? limit : 1};
+    bool split = pool && poolSize(pool) > 1;
+    solverState *frontier = split ? malloc(FRONTIER_MAX * sizeof(*frontier)) : NULL;
+    subtreeTask *tasks = frontier ? malloc(FRONTIER_MAX * sizeof(*tasks)) : NULL;
+
+    if (!tasks) {
+        free(frontier);
+        return solveGrid(puzzle, solution, limit);
+    }
+    if (!initState(&frontier[0], puzzle)) {
+        free(tasks);
+        free(frontier);
+        return 0;
+    }
+    int count = expandFrontier(&par, frontier, (int)poolSize(pool) * FRONTIER_PER_THREAD);
+
+    // Every subtree task, including those split off during the search, lives in one of these slots
+    for (int i = 0; i < FRONTIER_MAX; i++) {
+        tasks[i].nextFree = i + 1 < FRONTIER_MAX ? &tasks[i + 1] : NULL;
+    }
+    par.freeTasks = tasks;
+    pthread_mutex_init(&par.lock, NULL);
+    for (int i = 0; i < count; i++) {
+        if (!spawnSubtree(&par, &frontier[i])) {
+            solverSearch run = {.limit = par.limit, .par = &par};
+            search(&frontier[i], &run);
+            keepFirst(&par, &run);
+        }
+    }
+    free(frontier);
+    poolWait(pool);
+    pthread_mutex_destroy(&par.lock);
+    free(tasks);
+
+    if (par.haveFirst && solution) {
+        toGrid(&par.first, solution);
+    }
+    return par.found < par.limit ? par.found : par.limit;
+}
+
+
+/*
+ * Function: solveWorker
+ * ---------------------
+ * Solves one chunk of puzzles within the node budget, recording how many solutions each has and the
+ * first one found. Puzzles that exhaust the budget are marked -1 and left for a parallel search.
+ *
+ * arg: Pointer to a solveTask.
+ *
+ * Returns: NULL.
+ */
+
+static void *solveWorker(void *arg) {
+    solveTask *task = (solveTask *)arg;
+
+    for (size_t n = 0; n < task->count; n++) {
+        task->outcomes[n] = (signed char)solveBudgeted(task->grids[n], task->solutions[n], task->limit,
+                                                       task->budget);
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: formatOutcome
+ * -----------------------
+ * Appends the line for one puzzle: the solution as SIZE*SIZE digits, or a verdict word.
+ *
+ * out: Destination buffer.
+ * found: Solutions found (limited to 2 in unique mode).
+ * solution: The first solution found, if any.
+ * unique: Whether puzzles with several solutions are rejected.
+ * verdictOnly: Whether to print a verdict word instead of the solution.
+ *
+ * Returns: void.
+ */
+
+static void formatOutcome(outputBuffer *out, int found, const gridCell solution[SIZE][SIZE], bool unique,
+                          bool verdictOnly) {
+    char line[SIZE * SIZE + 1];
+
+    if (found == 0) {
+        outputString(out, "UNSOLVABLE\n");
+    } else if (unique && found > 1) {
+        outputString(out, "MULTIPLE\n");
+    } else if (verdictOnly) {
+        outputString(out, unique ? "unique\n" : "solvable\n");
+    } else {
+        for (int cell = 0; cell < SIZE * SIZE; cell++) {
+            line[cell] = (char)('0' + solution[cell / SIZE][cell % SIZE]);
+        }
+        line[SIZE * SIZE] = '\n';
+        outputBytes(out, line, sizeof(line));
+    }
+}
+
+
+/*
+ * Function: solveUsage
+ * --------------------
+ * Prints the options accepted by the solve subcommand.
+ */
+
+static void solveUsage(void) {
+    fprintf(stderr,
+            "Usage: solve [--output solution|verdict] [--unique] [--engine bitboard|dlx] [--box RxC] [--threads T]\n"
+            "             [--cpus LIST | --cpuset LIST] [--io-cpus LIST] <puzzle_file>\n"
+            "  --output MODE  solution: the solved grid on one line per puzzle (default);\n"
+            "                 verdict: solvable (unique with --unique) or UNSOLVABLE per puzzle\n"
+            "  --unique       Require exactly one solution; puzzles with more are reported as MULTIPLE\n"
+            "  --engine E     bitboard (default for 9x9) or dlx (exact cover with dancing links)\n"
+            "  --box RxC      Box rows x columns: 3x3 for 9x9 (default), 2x3 for 6x6, 3x4 for 12x12;\n"
+            "                 a single number B means BxB. Grids other than 9x9 use dlx\n"
+            "  --threads T    Worker threads (default: one per usable CPU, within any cgroup CPU quota)\n"
+            "  --cpus LIST    Pin worker i to the i-th CPU of LIST, e.g. 0-3,8 (cycling when T is larger)\n"
+            "  --cpuset LIST  Let the workers share the CPUs of LIST\n"
+            "  --io-cpus LIST Run the thread that reads puzzles and writes results on LIST\n");
+}
+
+
+/*
+ * Function: solveMain
+ * -------------------
+ * Entry point of the solve subcommand. Solves every puzzle of a corpus file (any format corpusOpen
+ * reads; 0 or '.' marks an empty cell) and writes one line per puzzle to stdout. Each round, workers
+ * solve a chunk of puzzles apiece within a node budget; the few hard puzzles that exhaust it are then
+ * solved one at a time by all threads together. A count of outcomes is printed to stderr.
+ *
+ * argc: The number of arguments, including the subcommand name.
+ * argv: Array of arguments, with the subcommand name in argv[0].
+ *
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE on bad options, an unreadable corpus, or a write error.
+ */
+
+int solveMain(int argc, char *argv[]) {
+    bool verdictOnly = false, unique = false, useDlx = false, bitboard = false;
+    gridShape shape = {BOX_ROWS, BOX_COLS, SIZE};
+    unsigned threads = 0;
+    cpuPlacement placement = {0};
+    const char *corpusFile = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "solution") != 0 && strcmp(argv[i], "verdict") != 0) {
+                solveUsage();
+                return EXIT_FAILURE;
+            }
+            verdictOnly = strcmp(argv[i], "verdict") == 0;
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            i++;
+            useDlx = strcmp(argv[i], "dlx") == 0;
+            bitboard = strcmp(argv[i], "bitboard") == 0;
+            if (!useDlx && !bitboard) {
+                solveUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--box") == 0 && i + 1 < argc) {
+            if (!parseShape(argv[++i], &shape)) {
+                fprintf(stderr, "Box shape must be RxC or B, for grids up to %dx%d\n", MAX_ORDER, MAX_ORDER);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--unique") == 0) {
+            unique = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)strtoul(argv[++i], NULL, 10);
+            if (threads == 0) {
+                solveUsage();
+                return EXIT_FAILURE;
+            }
+        } else if (isPlacementOption(argv[i]) && i + 1 < argc) {
+            if (!parsePlacementOption(&placement, argv[i], argv[i + 1])) {
+                fprintf(stderr, "%s: not a list of CPUs this process may use: %s\n", argv[i], argv[i + 1]);
+                return EXIT_FAILURE;
+            }
+            i++;
+        } else if (argv[i][0] != '-' && !corpusFile) {
+            corpusFile = argv[i];
+        } else {
+            solveUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!corpusFile) {
+        solveUsage();
+        return EXIT_FAILURE;
+    }
+    if (threads == 0) {
+        threads = defaultThreads(&placement);
+    }
+    if (shape.boxRows != BOX_ROWS || shape.boxCols != BOX_COLS) {
+        if (bitboard) {
+            fprintf(stderr, "The bitboard engine only solves %dx%d grids with %dx%d boxes; use --engine dlx\n", SIZE, SIZE,
+                    BOX_ROWS, BOX_COLS);
+            return EXIT_FAILURE;
+        }
+        useDlx = true;
+    }
+    if (useDlx) {
+        return dlxSolveFile(corpusFile, &shape, threads, &placement, unique, verdictOnly);
+    }
+
+    // The workers are started before this thread moves to the I/O CPUs, so they do not inherit them
+    workPool *pool = poolCreate(threads, &placement);
+    if (!placeIoThread(&placement)) {
+        perror("Error placing the I/O thread");
+    }
+    corpusStream *stream = corpusOpen(corpusFile);
+    if (!stream) {
+        perror("Error opening corpus");
+        poolDestroy(pool);
+        return EXIT_FAILURE;
+    }
+
+    size_t roundGrids = (size_t)threads * SOLVE_CHUNK_GRIDS;
+    int limit = unique ? 2 : 1;
+    // A lone worker has no one to share a hard puzzle with, so it finishes the search it started
+    uint64_t budget = pool && poolSize(pool) > 1 ? SOLVE_NODE_BUDGET : 0;
+    solveTask *tasks = calloc(threads, sizeof(*tasks));
+    gridCell (*grids)[SIZE][SIZE] = malloc(roundGrids * sizeof(*grids));
+    signed char *outcomes = malloc(roundGrids);
+    gridCell (*solutions)[SIZE][SIZE] = malloc(roundGrids * sizeof(*solutions));
+    outputBuffer out = {0};
+    bool ok = pool && tasks && grids && outcomes && solutions &&
+              outputInit(&out, STDOUT_FILENO, roundGrids * (SIZE * SIZE + 1));
+    if (!ok) {
+        perror("Error allocating solver buffers");
+    }
+
+    size_t count = 0, tally[3] = {0}, loaded;
+    while (ok && (loaded = corpusNext(stream, grids, roundGrids)) > 0) {
+        unsigned started = 0;
+        for (size_t next = 0; next < loaded; started++) {
+            solveTask *task = &tasks[started];
+            task->grids = (const gridCell (*)[SIZE][SIZE])grids + next;
+            task->count = loaded - next < SOLVE_CHUNK_GRIDS ? loaded - next : SOLVE_CHUNK_GRIDS;
+            task->limit = limit;
+            task->budget = budget;
+            task->outcomes = outcomes + next;
+            task->solutions = solutions + next;
+            next += task->count;
+            poolSubmit(pool, solveWorker, task);
+        }
+        poolWait(pool);
+
+        for (size_t n = 0; n < loaded; n++) {
+            if (outcomes[n] < 0) {
+                outcomes[n] = (signed char)solveGridParallel((const gridCell (*)[SIZE])grids[n], solutions[n], limit, pool);
+            }
+            tally[outcomes[n]]++;
+            formatOutcome(&out, outcomes[n], solutions[n], unique, verdictOnly);
+        }
+        count += loaded;
+        if (!outputFlush(&out)) {
+            perror("Error writing solutions");
+            ok = false;
+        }
+    }
+
+    outputFree(&out);
+    free(solutions);
+    free(outcomes);
+    free(grids);
+    free(tasks);
+    poolDestroy(pool);
+
+    if (ok && corpusError(stream)) {
+        errno = corpusError(stream);
+        perror("Error reading corpus");
+        ok = false;
+    }
+    corpusClose(stream);
+
+    if (ok && unique) {
+        fprintf(stderr, "%s: %zu puzzles, %zu unique, %zu MULTIPLE, %zu UNSOLVABLE\n", corpusFile, count, tally[1],
+                tally[2], tally[0]);
+    } else if (ok) {
+        fprintf(stderr, "%s: %zu puzzles, %zu solved, %zu UNSOLVABLE\n", corpusFile, count, tally[1], tally[0]);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+/*
+ * File: Sudoku-Tables.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Lookup tables shared by every engine, generated by the preprocessor at compile time: the
+ *              row, column, and subgrid unit of every cell, the cells of every unit, and the peers of
+ *              every cell. Each entry is a constant expression of its indices, and repetition macros
+ *              expand one entry per index, so the tables are plain constant data in the binary.
+ */
+
+
+#include "Sudoku-Validator.h"
+
+// Literal counts for the repetition macros, which can only paste literal numbers. Every box shape whose
+// cell indices fit a byte is listed; NUM_PEERS depends on the box shape, not just on SIZE.
+#if SIZE == 4
+#define SIZE_COUNT 4
+#elif SIZE == 6
+#define SIZE_COUNT 6
+#elif SIZE == 8
+#define SIZE_COUNT 8
+#elif SIZE == 9
+#define SIZE_COUNT 9
+#elif SIZE == 10
+#define SIZE_COUNT 10
+#elif SIZE == 12
+#define SIZE_COUNT 12
+#elif SIZE == 14
+#define SIZE_COUNT 14
+#elif SIZE == 15
+#define SIZE_COUNT 15
+#else
+#error "No lookup tables for this grid size"
+#endif
+
+#if NUM_PEERS == 7
+#define PEERS_COUNT 7
+#elif NUM_PEERS == 12
+#define PEERS_COUNT 12
+#elif NUM_PEERS == 17
+#define PEERS_COUNT 17
+#elif NUM_PEERS == 20
+#define PEERS_COUNT 20
+#elif NUM_PEERS == 22
+#define PEERS_COUNT 22
+#elif NUM_PEERS == 27
+#define PEERS_COUNT 27
+#elif NUM_PEERS == 28
+#define PEERS_COUNT 28
+#elif NUM_PEERS == 32
+#define PEERS_COUNT 32
+#elif NUM_PEERS == 36
+#define PEERS_COUNT 36
+#else
+#error "No lookup tables for this box shape"
+#endif
+
+#define PASTE(a, b) a##b
+#define CAT(a, b) PASTE(a, b)
+
+// REPEAT_OUTER_n(M) expands to M(0) ... M(n - 1); REPEAT_INNER_n(M, x) and REPEAT_PEER_n(M, x) to
+// M(x, 0) ... M(x, n - 1). A macro cannot expand inside its own expansion, so each level of a nested
+// table needs its own family: the peer table nests all three.
+#define REPEAT_OUTER_1(M) M(0)
+#define REPEAT_OUTER_2(M) REPEAT_OUTER_1(M) M(1)
+#define REPEAT_OUTER_3(M) REPEAT_OUTER_2(M) M(2)
+#define REPEAT_OUTER_4(M) REPEAT_OUTER_3(M) M(3)
+#define REPEAT_OUTER_5(M) REPEAT_OUTER_4(M) M(4)
+#define REPEAT_OUTER_6(M) REPEAT_OUTER_5(M) M(5)
+#define REPEAT_OUTER_7(M) REPEAT_OUTER_6(M) M(6)
+#define REPEAT_OUTER_8(M) REPEAT_OUTER_7(M) M(7)
+#define REPEAT_OUTER_9(M) REPEAT_OUTER_8(M) M(8)
+#define REPEAT_OUTER_10(M) REPEAT_OUTER_9(M) M(9)
+#define REPEAT_OUTER_11(M) REPEAT_OUTER_10(M) M(10)
+#define REPEAT_OUTER_12(M) REPEAT_OUTER_11(M) M(11)
+#define REPEAT_OUTER_13(M) REPEAT_OUTER_12(M) M(12)
+#define REPEAT_OUTER_14(M) REPEAT_OUTER_13(M) M(13)
+#define REPEAT_OUTER_15(M) REPEAT_OUTER_14(M) M(14)
+
+#define REPEAT_INNER_1(M, x) M(x, 0)
+#define REPEAT_INNER_2(M, x) REPEAT_INNER_1(M, x) M(x, 1)
+#define REPEAT_INNER_3(M, x) REPEAT_INNER_2(M, x) M(x, 2)
+#define REPEAT_INNER_4(M, x) REPEAT_INNER_3(M, x) M(x, 3)
+#define REPEAT_INNER_5(M, x) REPEAT_INNER_4(M, x) M(x, 4)
+#define REPEAT_INNER_6(M, x) REPEAT_INNER_5(M, x) M(x, 5)
+#define REPEAT_INNER_7(M, x) REPEAT_INNER_6(M, x) M(x, 6)
+#define REPEAT_INNER_8(M, x) REPEAT_INNER_7(M, x) M(x, 7)
+#define REPEAT_INNER_9(M, x) REPEAT_INNER_8(M, x) M(x, 8)
+#define REPEAT_INNER_10(M, x) REPEAT_INNER_9(M, x) M(x, 9)
+#define REPEAT_INNER_11(M, x) REPEAT_INNER_10(M, x) M(x, 10)
+#define REPEAT_INNER_12(M, x) REPEAT_INNER_11(M, x) M(x, 11)
+#define REPEAT_INNER_13(M, x) REPEAT_INNER_12(M, x) M(x, 12)
+#define REPEAT_INNER_14(M, x) REPEAT_INNER_13(M, x) M(x, 13)
+#define REPEAT_INNER_15(M, x) REPEAT_INNER_14(M, x) M(x, 14)
+
+#define REPEAT_PEER_1(M, x) M(x, 0)
+#define REPEAT_PEER_2(M, x) REPEAT_PEER_1(M, x) M(x, 1)
+#define REPEAT_PEER_3(M, x) REPEAT_PEER_2(M, x) M(x, 2)
+#define REPEAT_PEER_4(M, x) REPEAT_PEER_3(M, x) M(x, 3)
+#define REPEAT_PEER_5(M, x) REPEAT_PEER_4(M, x) M(x, 4)
+#define REPEAT_PEER_6(M, x) REPEAT_PEER_5(M, x) M(x, 5)
+#define REPEAT_PEER_7(M, x) REPEAT_PEER_6(M, x) M(x, 6)
+#define REPEAT_PEER_8(M, x) REPEAT_PEER_7(M, x) M(x, 7)
+#define REPEAT_PEER_9(M, x) REPEAT_PEER_8(M, x) M(x, 8)
+#define REPEAT_PEER_10(M, x) REPEAT_PEER_9(M, x) M(x, 9)
+#define REPEAT_PEER_11(M, x) REPEAT_PEER_10(M, x) M(x, 10)
+#define REPEAT_PEER_12(M, x) REPEAT_PEER_11(M, x) M(x, 11)
+#define REPEAT_PEER_13(M, x) REPEAT_PEER_12(M, x) M(x, 12)
+#define REPEAT_PEER_14(M, x) REPEAT_PEER_13(M, x) M(x, 13)
+#define REPEAT_PEER_15(M, x) REPEAT_PEER_14(M, x) M(x, 14)
+#define REPEAT_PEER_16(M, x) REPEAT_PEER_15(M, x) M(x, 15)
+#define REPEAT_PEER_17(M, x) REPEAT_PEER_16(M, x) M(x, 16)
+#define REPEAT_PEER_18(M, x) REPEAT_PEER_17(M, x) M(x, 17)
+#define REPEAT_PEER_19(M, x) REPEAT_PEER_18(M, x) M(x, 18)
+#define REPEAT_PEER_20(M, x) REPEAT_PEER_19(M, x) M(x, 19)
+#define REPEAT_PEER_21(M, x) REPEAT_PEER_20(M, x) M(x, 20)
+#define REPEAT_PEER_22(M, x) REPEAT_PEER_21(M, x) M(x, 21)
+#define REPEAT_PEER_23(M, x) REPEAT_PEER_22(M, x) M(x, 22)
+#define REPEAT_PEER_24(M, x) REPEAT_PEER_23(M, x) M(x, 23)
+#define REPEAT_PEER_25(M, x) REPEAT_PEER_24(M, x) M(x, 24)
+#define REPEAT_PEER_26(M, x) REPEAT_PEER_25(M, x) M(x, 25)
+#define REPEAT_PEER_27(M, x) REPEAT_PEER_26(M, x) M(x, 26)
+#define REPEAT_PEER_28(M, x) REPEAT_PEER_27(M, x) M(x, 27)
+#define REPEAT_PEER_29(M, x) REPEAT_PEER_28(M, x) M(x, 28)
+#define REPEAT_PEER_30(M, x) REPEAT_PEER_29(M, x) M(x, 29)
+#define REPEAT_PEER_31(M, x) REPEAT_PEER_30(M, x) M(x, 30)
+#define REPEAT_PEER_32(M, x) REPEAT_PEER_31(M, x) M(x, 31)
+#define REPEAT_PEER_33(M, x) REPEAT_PEER_32(M, x) M(x, 32)
+#define REPEAT_PEER_34(M, x) REPEAT_PEER_33(M, x) M(x, 33)
+#define REPEAT_PEER_35(M, x) REPEAT_PEER_34(M, x) M(x, 34)
+#define REPEAT_PEER_36(M, x) REPEAT_PEER_35(M, x) M(x, 35)
+
+#define REPEAT_OUTER(n, M) CAT(REPEAT_OUTER_, n)(M)
+#define REPEAT_INNER(n, M, x) CAT(REPEAT_INNER_, n)(M, x)
+#define REPEAT_PEER(n, M, x) CAT(REPEAT_PEER_, n)(M, x)
+
+// Row and column of a row-major cell index.
+#define ROW_OF(cell) ((cell) / SIZE)
+#define COL_OF(cell) ((cell) % SIZE)
+
+// Cell i of a unit in results order. Subgrid cells are row-major within the subgrid.
+#define BOX_CELL(box, i)                                                               \
+    ((((box) / (SIZE / BOX_COLS)) * BOX_ROWS + (i) / BOX_COLS) * SIZE +                \
+     ((box) % (SIZE / BOX_COLS)) * BOX_COLS + (i) % BOX_COLS)
+#define UNIT_CELL(unit, i)                                                             \
+    ((unit) < SIZE       ? (unit) * SIZE + (i)                                         \
+     : (unit) < 2 * SIZE ? (i) * SIZE + (unit) - SIZE                                  \
+                         : BOX_CELL((unit) - 2 * SIZE, i))
+
+// Skips over the cell's own position when listing the other positions of a line or box.
+#define SKIP(k, own) ((k) < (own) ? (k) : (k) + 1)
+
+// Peer j of a cell: the other SIZE - 1 cells of its row, then the other SIZE - 1 cells of its column,
+// then the cells of its subgrid on neither line.
+#define BOX_PEER(cell, k)                                                                        \
+    ((ROW_OF(cell) - ROW_OF(cell) % BOX_ROWS + SKIP((k) / (BOX_COLS - 1), ROW_OF(cell) % BOX_ROWS)) * SIZE + \
+     COL_OF(cell) - COL_OF(cell) % BOX_COLS + SKIP((k) % (BOX_COLS - 1), COL_OF(cell) % BOX_COLS))
+#define PEER(cell, j)                                                                    \
+    ((j) < SIZE - 1       ? ROW_OF(cell) * SIZE + SKIP(j, COL_OF(cell))                  \
+     : (j) < 2 * SIZE - 2 ? SKIP((j) - (SIZE - 1), ROW_OF(cell)) * SIZE + COL_OF(cell)   \
+                          : BOX_PEER(cell, (j) - 2 * (SIZE - 1)))
+
+// Table rows.
+#define UNITS_OF_CELL(row, col) {ROW_UNIT(row), COLUMN_UNIT(col), SUBGRID_UNIT(row, col)},
+#define CELL_UNITS_ROW(row) REPEAT_INNER(SIZE_COUNT, UNITS_OF_CELL, row)
+#define UNIT_CELL_ENTRY(unit, i) UNIT_CELL(unit, i),
+#define ROW_CELLS(row) {REPEAT_INNER(SIZE_COUNT, UNIT_CELL_ENTRY, ROW_UNIT(row))},
+#define COLUMN_CELLS(col) {REPEAT_INNER(SIZE_COUNT, UNIT_CELL_ENTRY, COLUMN_UNIT(col))},
+#define SUBGRID_CELLS(box) {REPEAT_INNER(SIZE_COUNT, UNIT_CELL_ENTRY, 2 * SIZE + (box))},
+#define PEER_ENTRY(cell, j) PEER(cell, j),
+#define CELL_PEERS(cell) {REPEAT_PEER(PEERS_COUNT, PEER_ENTRY, cell)},
+#define ROW_PEERS(row) REPEAT_INNER(SIZE_COUNT, ROW_PEERS_CELL, row)
+#define ROW_PEERS_CELL(row, col) CELL_PEERS((row) * SIZE + (col))
+
+const unsigned char cellUnits[SIZE * SIZE][3] = {REPEAT_OUTER(SIZE_COUNT, CELL_UNITS_ROW)};
+
+const unsigned char unitCells[NUM_THREADS][SIZE] = {
+    REPEAT_OUTER(SIZE_COUNT, ROW_CELLS) REPEAT_OUTER(SIZE_COUNT, COLUMN_CELLS) REPEAT_OUTER(SIZE_COUNT, SUBGRID_CELLS)
+};
+
+const unsigned char cellPeers[SIZE * SIZE][NUM_PEERS] = {REPEAT_OUTER(SIZE_COUNT, ROW_PEERS)};
@@ -0,0 +1,491 @@
+/*
+ * File: Sudoku-Uring.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: io_uring ingestion backend for the multi-file validator. Each reader keeps a fixed set
+ *              of slots in flight; every slot walks a file through openat, read, and close submissions,
+ *              and completed buffers are handed straight to the caller's parser. The ring is driven
+ *              with raw system calls so no extra library is needed. On systems without io_uring,
+ *              uringCreate fails and callers fall back to the thread-based reader.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Sudoku-Validator.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Bytes read per file in a single submission. Puzzle files are far smaller; larger files are
+// finished with a regular read.
+#define URING_READ_BYTES 4096
+
+// Longest a failed reader waits for the kernel to finish operations it already accepted, in milliseconds.
+#define URING_DRAIN_MS 1000
+
+// Kind of operation encoded in the high bits of a submission's user_data.
+#define URING_OPEN 1ull
+#define URING_READ 2ull
+#define URING_CLOSE 3ull
+
+// Struct for one file moving through the ring.
+typedef struct {
+    char *path;          // NULL when the slot is free
+    int fd;              // -1 until the open completes
+    bool busy;           // An open or read for the file is queued and not yet reaped
+    char *buffer;
+} uringSlot;
+
+// Struct for a reader: the mapped rings plus its slots.
+struct uringReader {
+    int ringFd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sqEntries;
+    unsigned pending;    // SQEs prepared but not yet submitted
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+    uringSlot *slots;
+    unsigned depth;
+    char *scratch;       // Used for files larger than URING_READ_BYTES
+    size_t scratchCapacity;
+};
+
+
+/*
+ * Function: uringSupportsOps
+ * --------------------------
+ * Asks the kernel whether the opcodes the reader needs are available.
+ */
+
+static bool uringSupportsOps(int ringFd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) {
+        return false;
+    }
+    bool ok = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    static const int needed[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+    for (size_t i = 0; ok && i < sizeof(needed) / sizeof(needed[0]); i++) {
+        ok = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+
+/*
+ * Function: uringCreate
+ * ---------------------
+ * Sets up a ring able to keep `depth` files in flight.
+ *
+ * depth: Number of files processed concurrently.
+ *
+ * Returns: A new reader, or NULL (with errno set) if io_uring or a required opcode is unavailable.
+ */
+
+uringReader *uringCreate(unsigned depth) {
+    uringReader *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    r->ringFd = -1;
+
+    // Every slot can have one open or read plus one close outstanding
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    r->ringFd = (int)syscall(__NR_io_uring_setup, depth * 2, &params);
+    if (r->ringFd < 0) {
+        free(r);
+        return NULL;
+    }
+    if (!uringSupportsOps(r->ringFd)) {
+        uringDestroy(r);
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+
+    r->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        r->sqRingSize = r->cqRingSize = r->sqRingSize > r->cqRingSize ? r->sqRingSize : r->cqRingSize;
+    }
+    r->sqRing = mmap(NULL, r->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd,
+                     IORING_OFF_SQ_RING);
+    if (r->sqRing == MAP_FAILED) {
+        r->sqRing = NULL;
+        uringDestroy(r);
+        return NULL;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cqRing = r->sqRing;
+    } else {
+        r->cqRing = mmap(NULL, r->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd,
+                         IORING_OFF_CQ_RING);
+        if (r->cqRing == MAP_FAILED) {
+            r->cqRing = NULL;
+            uringDestroy(r);
+            return NULL;
+        }
+    }
+    r->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        uringDestroy(r);
+        return NULL;
+    }
+
+    char *sq = r->sqRing, *cq = r->cqRing;
+    r->sqHead = (unsigned *)(sq + params.sq_off.head);
+    r->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    r->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    r->sqArray = (unsigned *)(sq + params.sq_off.array);
+    r->cqHead = (unsigned *)(cq + params.cq_off.head);
+    r->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    r->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    r->sqEntries = params.sq_entries;
+
+    r->depth = depth;
+    r->slots = calloc(depth, sizeof(*r->slots));
+    if (!r->slots) {
+        uringDestroy(r);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (unsigned i = 0; i < depth; i++) {
+        r->slots[i].buffer = malloc(URING_READ_BYTES);
+        if (!r->slots[i].buffer) {
+            uringDestroy(r);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    return r;
+}
+
+
+/*
+ * Function: uringDestroy
+ * ----------------------
+ * Unmaps the rings and frees the reader.
+ */
+
+void uringDestroy(uringReader *r) {
+    if (!r) {
+        return;
+    }
+    if (r->slots) {
+        for (unsigned i = 0; i < r->depth; i++) {
+            free(r->slots[i].buffer);
+        }
+        free(r->slots);
+    }
+    if (r->sqes) {
+        munmap(r->sqes, r->sqesSize);
+    }
+    if (r->cqRing && r->cqRing != r->sqRing) {
+        munmap(r->cqRing, r->cqRingSize);
+    }
+    if (r->sqRing) {
+        munmap(r->sqRing, r->sqRingSize);
+    }
+    if (r->ringFd >= 0) {
+        close(r->ringFd);
+    }
+    free(r->scratch);
+    free(r);
+}
+
+
+/*
+ * Function: uringEnter
+ * --------------------
+ * Submits every prepared SQE and optionally waits for at least one completion.
+ *
+ * Returns: true on success, false on a fatal ring error.
+ */
+
+static bool uringEnter(uringReader *r, bool wait) {
+    while (true) {
+        int rc = (int)syscall(__NR_io_uring_enter, r->ringFd, r->pending, wait ? 1 : 0,
+                              wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (rc >= 0) {
+            r->pending -= (unsigned)rc < r->pending ? (unsigned)rc : r->pending;
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return false;
+        }
+        if (errno != EINTR) {
+            // The completion queue is backed up; the caller reaps before trying again
+            return true;
+        }
+    }
+}
+
+
+/*
+ * Function: uringPrepare
+ * ----------------------
+ * Claims the next SQE, submitting what is queued first if the ring is full.
+ *
+ * Returns: A zeroed SQE.
+ */
+
+static struct io_uring_sqe *uringPrepare(uringReader *r) {
+    unsigned tail = *r->sqTail;
+    if (tail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE) >= r->sqEntries) {
+        uringEnter(r, false);
+        tail = *r->sqTail;
+    }
+    unsigned index = tail & *r->sqMask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sqArray[index] = index;
+    __atomic_store_n(r->sqTail, tail + 1, __ATOMIC_RELEASE);
+    r->pending++;
+    return sqe;
+}
+
+
+/*
+ * Function: uringAbandon
+ * ----------------------
+ * Winds down a reader whose ring failed. SQEs still waiting in the submission queue never reached the
+ * kernel, so the descriptors of closes among them are closed here; for the rest, completions are polled
+ * for a while so no read is left writing into a slot buffer. Descriptors the opens returned are closed. A buffer whose read never completes is leaked
+ * rather than freed under the kernel. The slots keep their paths for uringTakeUnfinished.
+ *
+ * r: The reader.
+ * outstanding: SQEs prepared or submitted whose completion has not been reaped.
+ */
+
+static void uringAbandon(uringReader *r, unsigned outstanding) {
+    unsigned tail = *r->sqTail;
+
+    for (unsigned i = 0; i < r->pending; i++) {
+        const struct io_uring_sqe *sqe = &r->sqes[r->sqArray[(tail - 1 - i) & *r->sqMask]];
+        if ((sqe->user_data >> 32) == URING_CLOSE) {
+            close(sqe->fd); // Its slot has let go of the descriptor and may hold another file by now
+        } else {
+            r->slots[sqe->user_data & 0xffffffffu].busy = false;
+        }
+    }
+    outstanding -= r->pending;
+    r->pending = 0;
+
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 1000000};
+    for (int waited = 0; outstanding > 0 && waited <= URING_DRAIN_MS;) {
+        unsigned head = *r->cqHead;
+        if (head == __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE)) {
+            // Returning from the system call also runs any completion work queued for this thread
+            nanosleep(&pause, NULL);
+            waited++;
+            continue;
+        }
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cqMask];
+        unsigned op = (unsigned)(cqe->user_data >> 32);
+        uringSlot *slot = &r->slots[cqe->user_data & 0xffffffffu];
+        if (op == URING_OPEN && cqe->res >= 0) {
+            slot->fd = cqe->res;
+        }
+        if (op != URING_CLOSE) {
+            slot->busy = false;
+        }
+        __atomic_store_n(r->cqHead, head + 1, __ATOMIC_RELEASE);
+        outstanding--;
+    }
+
+    for (unsigned i = 0; i < r->depth; i++) {
+        uringSlot *slot = &r->slots[i];
+        if (slot->busy) {
+            slot->buffer = NULL;
+        }
+        if (slot->path && slot->fd >= 0) {
+            close(slot->fd);
+            slot->fd = -1;
+        }
+    }
+}
+
+
+/*
+ * Function: uringTakeUnfinished
+ * -----------------------------
+ * After uringIngest fails, returns the paths it had taken from the source but not passed to the sink,
+ * one per call, so the caller can read them another way.
+ *
+ * Returns: A path the caller now owns, or NULL once none are left.
+ */
+
+char *uringTakeUnfinished(uringReader *r) {
+    for (unsigned i = 0; i < r->depth; i++) {
+        char *path = r->slots[i].path;
+        if (path) {
+            r->slots[i].path = NULL;
+            return path;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: uringIngest
+ * ---------------------
+ * Reads every file the source provides and passes each one's contents to the sink. Up to `depth` files
+ * are in flight at once; opens, reads, and closes for different files are batched into shared
+ * io_uring_enter calls.
+ *
+ * r: The reader.
+ * next: Returns the next path (owned by the caller of sink afterwards), or NULL. When `wait` is false
+ *       it must not block; it sets *done once no more paths will ever come.
+ * sink: Called once per file with its contents, or with a non-zero errno value on failure. The path is
+ *       passed back so the sink can report and free it.
+ * context: Passed through to sink.
+ *
+ * Returns: true on success, false if the ring itself failed. The caller should then take the files left
+ *          in flight with uringTakeUnfinished and fall back to plain reads.
+ */
+
+bool uringIngest(uringReader *r, char *(*next)(bool wait, bool *done),
+                 void (*sink)(void *context, char *path, const char *data, size_t length, int error),
+                 void *context) {
+    unsigned inFlight = 0;     // Files currently owning a slot
+    unsigned outstanding = 0;  // SQEs submitted whose completion has not been reaped
+    bool done = false;
+
+    while (!done || inFlight > 0 || outstanding > 0) {
+        // Fill free slots with new files
+        for (unsigned i = 0; i < r->depth && !done; i++) {
+            uringSlot *slot = &r->slots[i];
+            if (slot->path) {
+                continue;
+            }
+            slot->path = next(inFlight == 0 && outstanding == 0, &done);
+            if (!slot->path) {
+                break;
+            }
+            slot->fd = -1;
+            slot->busy = true;
+            struct io_uring_sqe *sqe = uringPrepare(r);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)slot->path;
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = (URING_OPEN << 32) | i;
+            inFlight++;
+            outstanding++;
+        }
+        if (inFlight == 0 && outstanding == 0) {
+            continue;
+        }
+
+        if (!uringEnter(r, true)) {
+            uringAbandon(r, outstanding);
+            return false;
+        }
+
+        // Reap completions and advance each file to its next stage
+        unsigned head = *r->cqHead;
+        while (head != __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cqMask];
+            unsigned op = (unsigned)(cqe->user_data >> 32);
+            unsigned index = (unsigned)(cqe->user_data & 0xffffffffu);
+            int res = cqe->res;
+            head++;
+            outstanding--;
+
+            if (op == URING_CLOSE) {
+                continue;
+            }
+            uringSlot *slot = &r->slots[index];
+            slot->busy = false;
+
+            if (op == URING_OPEN) {
+                if (res < 0) {
+                    sink(context, slot->path, NULL, 0, -res);
+                    slot->path = NULL;
+                    inFlight--;
+                    continue;
+                }
+                slot->fd = res;
+                slot->busy = true;
+                struct io_uring_sqe *sqe = uringPrepare(r);
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = slot->fd;
+                sqe->addr = (uint64_t)(uintptr_t)slot->buffer;
+                sqe->len = URING_READ_BYTES;
+                sqe->off = 0;
+                sqe->user_data = (URING_READ << 32) | index;
+                outstanding++;
+                continue;
+            }
+
+            // Read finished: hand the buffer over, then close without waiting on the result
+            if (res < 0) {
+                sink(context, slot->path, NULL, 0, -res);
+            } else if (res == URING_READ_BYTES) {
+                size_t length;
+                int error = readWholeFile(slot->path, &r->scratch, &r->scratchCapacity, &length);
+                sink(context, slot->path, r->scratch, error ? 0 : length, error);
+            } else {
+                sink(context, slot->path, slot->buffer, (size_t)res, 0);
+            }
+            struct io_uring_sqe *sqe = uringPrepare(r);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = slot->fd;
+            sqe->user_data = (URING_CLOSE << 32) | index;
+            outstanding++;
+            slot->path = NULL;
+            inFlight--;
+        }
+        __atomic_store_n(r->cqHead, head, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+#else
+
+uringReader *uringCreate(unsigned depth) {
+    (void)depth;
+    errno = ENOSYS;
+    return NULL;
+}
+
+void uringDestroy(uringReader *r) {
+    (void)r;
+}
+
+char *uringTakeUnfinished(uringReader *r) {
+    (void)r;
+    return NULL;
+}
+
+bool uringIngest(uringReader *r, char *(*next)(bool wait, bool *done),
+                 void (*sink)(void *context, char *path, const char *data, size_t length, int error),
+                 void *context) {
+    (void)r;
+    (void)next;
+    (void)sink;
+    (void)context;
+    return false;
+}
+
+#endif
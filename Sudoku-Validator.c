@@ -8,36 +8,97 @@
  */
 
 
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
 
-// Define the size of the Sudoku grid and the total number of threads required.
-#define SIZE 9
-#define NUM_THREADS (SIZE * 3) // 27 threads: 9 for rows, 9 for columns, 9 for subgrids
+#include "Sudoku-Validator.h"
 
 // Mutex for synchronizing access to shared resources among threads.
 pthread_mutex_t mutex;
 
-// Struct to pass parameters to the threads.
-typedef struct {
-    int row;
-    int col;
-    int sudoku[SIZE][SIZE];
-} parameters;
-
-// Struct to store the validation result and message for each thread.
-typedef struct {
-    int valid; // 0 for invalid, 1 for valid
-    char message[100];
-} validationResult;
-
 // Array to store the results from all threads.
 validationResult results[NUM_THREADS];
 
 
+/*
+ * Function: isRowValid
+ * --------------------
+ * Scans a single row of the grid for out-of-range numbers and duplicates.
+ *
+ * sudoku: The 9x9 grid to inspect.
+ * row: Index of the row to scan.
+ *
+ * Returns: true if the row holds each of 1..SIZE exactly once, false otherwise.
+ */
+
+bool isRowValid(const gridCell sudoku[SIZE][SIZE], int row) {
+    int check[SIZE] = {0};
+
+    for (int i = 0; i < SIZE; i++) {
+        int num = sudoku[row][i];
+        if (num < 1 || num > SIZE || check[num - 1]++) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: isColumnValid
+ * -----------------------
+ * Scans a single column of the grid for out-of-range numbers and duplicates.
+ *
+ * sudoku: The 9x9 grid to inspect.
+ * col: Index of the column to scan.
+ *
+ * Returns: true if the column holds each of 1..SIZE exactly once, false otherwise.
+ */
+
+bool isColumnValid(const gridCell sudoku[SIZE][SIZE], int col) {
+    int check[SIZE] = {0};
+
+    for (int i = 0; i < SIZE; i++) {
+        int num = sudoku[i][col];
+        if (num < 1 || num > SIZE || check[num - 1]++) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: isSubgridValid
+ * ------------------------
+ * Scans a single BOX_ROWS x BOX_COLS subgrid for out-of-range numbers and duplicates.
+ *
+ * sudoku: The 9x9 grid to inspect.
+ * rowStart, colStart: Top-left coordinates of the subgrid.
+ *
+ * Returns: true if the subgrid holds each of 1..SIZE exactly once, false otherwise.
+ */
+
+bool isSubgridValid(const gridCell sudoku[SIZE][SIZE], int rowStart, int colStart) {
+    int check[SIZE] = {0};
+
+    for (int row = rowStart; row < rowStart + BOX_ROWS; row++) {
+        for (int col = colStart; col < colStart + BOX_COLS; col++) {
+            int num = sudoku[row][col];
+            if (num < 1 || num > SIZE || check[num - 1]++) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
 /*
  * Function: checkRow
  * ------------------
@@ -51,27 +112,25 @@ validationResult results[NUM_THREADS];
 void *checkRow(void *params) {
     parameters *data = (parameters *)params;
     int row = data->row;
-    int check[SIZE] = {0};
 
-    // Iterate through each row
-    for (int i = 0; i < SIZE; i++) {
-        int num = data->sudoku[row][i];
+    // Validate the numbers (they should be between 1 and SIZE inclusive) and check for duplicates
+    uint64_t start = METRICS_NOW();
+    bool valid = isRowValid(data->sudoku, row);
+    metricsUnitChecked(row, valid, METRICS_NOW() - start);
 
-        // Validate the number (it should be between 1 and SIZE inclusive) and checks for duplicates
-        if (num < 1 || num > SIZE || check[num - 1]++) {
-            // Lock the mutex before accessing shared data to avoid race conditions
-            pthread_mutex_lock(&mutex);
+    if (!valid) {
+        // Lock the mutex before accessing shared data to avoid race conditions
+        pthread_mutex_lock(&mutex);
 
-            // Mark the row as invalid in the shared results array
-            sprintf(results[row].message, "Thread # %2d (row %d) is INVALID\n", row + 1, row + 1);
-            results[row].valid = 0;
+        // Mark the row as invalid in the shared results array
+        sprintf(results[row].message, "Thread # %2d (row %d) is INVALID\n", row + 1, row + 1);
+        results[row].valid = 0;
 
-            // Unlock the mutex after modifying shared data
-            pthread_mutex_unlock(&mutex);
+        // Unlock the mutex after modifying shared data
+        pthread_mutex_unlock(&mutex);
 
-            // Exit the thread as we have determined the row is invalid
-            pthread_exit(NULL);
-        }
+        // Exit the thread as we have determined the row is invalid
+        pthread_exit(NULL);
     }
 
     // If we reach here, no duplicates or invalid numbers were found in the row
@@ -100,29 +159,27 @@ void *checkRow(void *params) {
 void *checkColumn(void *params) {
     parameters *data = (parameters *)params;
     int col = data->col;
-    int check[SIZE] = {0};
 
-    // Iterate through each column
-    for (int i = 0; i < SIZE; i++) {
-        int num = data->sudoku[i][col];
+    // Validate the numbers (they should be between 1 and SIZE inclusive) and check for duplicates
+    uint64_t start = METRICS_NOW();
+    bool valid = isColumnValid(data->sudoku, col);
+    metricsUnitChecked(SIZE + col, valid, METRICS_NOW() - start);
 
-        // Validate the number (it should be between 1 and SIZE inclusive) and check for duplicates
-        if (num < 1 || num > SIZE || check[num - 1]++) {
-            pthread_mutex_lock(&mutex);
+    if (!valid) {
+        pthread_mutex_lock(&mutex);
 
-            sprintf(results[SIZE + col].message, "Thread # %2d (column %d) is INVALID\n", col + 10, col + 1);
-            results[SIZE + col].valid = 0;
+        sprintf(results[SIZE + col].message, "Thread # %2d (column %d) is INVALID\n", SIZE + col + 1, col + 1);
+        results[SIZE + col].valid = 0;
 
-            pthread_mutex_unlock(&mutex);
-            pthread_exit(NULL);
-        }
+        pthread_mutex_unlock(&mutex);
+        pthread_exit(NULL);
     }
 
     // If we reach here, no duplicates or invalid numbers were found in the column
 
     pthread_mutex_lock(&mutex);
 
-    sprintf(results[SIZE + col].message, "Thread # %2d (column %d) is valid\n", col + 10, col + 1);
+    sprintf(results[SIZE + col].message, "Thread # %2d (column %d) is valid\n", SIZE + col + 1, col + 1);
     results[SIZE + col].valid = 1;
 
     pthread_mutex_unlock(&mutex);
@@ -133,7 +190,7 @@ void *checkColumn(void *params) {
 /*
  * Function: checkSubgrid
  * ----------------------
- * Validates all numbers in a specific 3x3 subgrid of the Sudoku grid. Ensures that there are no duplicates
+ * Validates all numbers in a specific subgrid of the Sudoku grid. Ensures that there are no duplicates
  *
  * params: Pointer to a parameters struct containing the top-left coordinates of the subgrid and the Sudoku grid.
  *
@@ -144,30 +201,24 @@ void *checkSubgrid(void *params) {
     parameters *data = (parameters *)params;
     int rowStart = data->row;
     int colStart = data->col;
-    int check[SIZE] = {0};
 
     // Calculate the index for results array specifically for subgrids,
     // adjusting it based on its position in the overall thread/task structure
-    int index = (rowStart / 3) * 3 + (colStart / 3) + (2 * SIZE); // Adjust index for subgrids
+    int index = cellUnits[rowStart * SIZE + colStart][2]; // Adjust index for subgrids
 
-    // Iterate through each cell in the subgrid
-    for (int row = rowStart; row < rowStart + 3; row++) {
+    // Validate the numbers (should be between 1 and SIZE) and check for duplicates
+    uint64_t start = METRICS_NOW();
+    bool valid = isSubgridValid(data->sudoku, rowStart, colStart);
+    metricsUnitChecked(index, valid, METRICS_NOW() - start);
 
-        for (int col = colStart; col < colStart + 3; col++) {
-            int num = data->sudoku[row][col];
+    if (!valid) {
+        pthread_mutex_lock(&mutex);
 
-            // Validate the number (should be between 1 and SIZE) and check for duplicates
-            if (num < 1 || num > SIZE || check[num - 1]++) {
-                pthread_mutex_lock(&mutex);
-
-                sprintf(results[index].message, "Thread # %2d (subgrid %d) is INVALID\n", index + 1, index - (2 * SIZE) + 1);
-                results[index].valid = 0;
-
-                pthread_mutex_unlock(&mutex);
-                pthread_exit(NULL);
-            }
-        }
+        sprintf(results[index].message, "Thread # %2d (subgrid %d) is INVALID\n", index + 1, index - (2 * SIZE) + 1);
+        results[index].valid = 0;
 
+        pthread_mutex_unlock(&mutex);
+        pthread_exit(NULL);
     }
 
     // If we reach here, no duplicates or invalid numbers were found in the subgrid
@@ -182,10 +233,246 @@ void *checkSubgrid(void *params) {
 }
 
 
+/*
+ * Function: validateThreaded
+ * --------------------------
+ * Validates a grid with one thread per row, column, and subgrid. Each thread records its verdict
+ * and message in the shared results array, which printResults can report afterwards.
+ *
+ * sudoku: The 9x9 grid to validate.
+ *
+ * Returns: true if every row, column, and subgrid is valid, false otherwise.
+ */
+
+bool validateThreaded(const gridCell sudoku[SIZE][SIZE]) {
+    pthread_mutex_init(&mutex, NULL);
+    
+    pthread_t tids[NUM_THREADS];
+    parameters params[NUM_THREADS];
+    uint64_t setupStart = METRICS_NOW();
+    
+    // Initialize parameters for each thread
+    for (int i = 0; i < SIZE; i++) {
+        // Initialize row checkers
+        params[i].row = i;
+        params[i].col = 0;
+        memcpy(params[i].sudoku, sudoku, sizeof(params[i].sudoku));
+        pthread_create(&tids[i], NULL, checkRow, &params[i]);
+
+        // Initialize column checkers
+        params[SIZE + i].row = 0;
+        params[SIZE + i].col = i;
+        memcpy(params[SIZE + i].sudoku, sudoku, sizeof(params[SIZE + i].sudoku));
+        pthread_create(&tids[SIZE + i], NULL, checkColumn, &params[SIZE + i]);
+    }
+
+    // Initialize subgrid checkers
+    for (int index = 2 * SIZE; index < NUM_THREADS; index++) {
+        int corner = unitCells[index][0]; // Top-left cell of the subgrid
+        params[index].row = corner / SIZE;
+        params[index].col = corner % SIZE;
+        memcpy(params[index].sudoku, sudoku, sizeof(params[index].sudoku));
+        pthread_create(&tids[index], NULL, checkSubgrid, &params[index]);
+    }
+    
+    uint64_t checkStart = METRICS_NOW();
+    metricsPhaseAdd(METRIC_THREAD_SETUP, checkStart - setupStart);
+
+    // Join threads
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    metricsPhaseAdd(METRIC_CHECK, METRICS_NOW() - checkStart);
+
+    pthread_mutex_destroy(&mutex);
+
+    // Check results and determine overall validity
+    bool isValid = true; // Assume the solution is valid initially
+    for (int i = 0; i < NUM_THREADS; i++) {
+        if (results[i].valid == 0) { // If any thread found the solution to be invalid
+            isValid = false;
+            break;
+        }
+    }
+
+    return isValid;
+}
+
+
+/*
+ * Function: validateSerial
+ * ------------------------
+ * Validates a grid on the calling thread using the same per-unit checks as the threaded path.
+ *
+ * sudoku: The 9x9 grid to validate.
+ *
+ * Returns: true if every row, column, and subgrid is valid, false otherwise.
+ */
+
+bool validateSerial(const gridCell sudoku[SIZE][SIZE]) {
+    for (int i = 0; i < SIZE; i++) {
+        if (!isRowValid(sudoku, i) || !isColumnValid(sudoku, i)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < SIZE; i += BOX_ROWS) {
+        for (int j = 0; j < SIZE; j += BOX_COLS) {
+            if (!isSubgridValid(sudoku, i, j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: validateBitmask
+ * -------------------------
+ * Validates a grid in a single pass over its cells. Every row, column, and subgrid keeps a bitmask
+ * of the numbers seen so far, so a duplicate is caught the moment its bit is already set.
+ *
+ * sudoku: The 9x9 grid to validate.
+ *
+ * Returns: true if every row, column, and subgrid is valid, false otherwise.
+ */
+
+bool validateBitmask(const gridCell sudoku[SIZE][SIZE]) {
+    const gridCell *cells = &sudoku[0][0];
+    unsigned seen[NUM_THREADS] = {0};
+
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+        unsigned num = (unsigned)cells[cell] - 1; // Out-of-range numbers wrap to a large value
+        if (num >= SIZE) {
+            return false;
+        }
+        unsigned bit = 1u << num;
+        const unsigned char *units = cellUnits[cell];
+        if ((seen[units[0]] | seen[units[1]] | seen[units[2]]) & bit) {
+            return false;
+        }
+        seen[units[0]] |= bit;
+        seen[units[1]] |= bit;
+        seen[units[2]] |= bit;
+    }
+    return true;
+}
+
+
+/*
+ * Function: validateBatch
+ * -----------------------
+ * Validates a contiguous array of grids back to back with the bitmask check.
+ *
+ * grids: Array of 9x9 grids.
+ * count: Number of grids in the array.
+ * verdicts: Output array with one entry per grid (1 valid, 0 invalid).
+ *
+ * Returns: The number of valid grids.
+ */
+
+size_t validateBatch(const gridCell (*grids)[SIZE][SIZE], size_t count, unsigned char *verdicts) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+        verdicts[i] = validateBitmask(grids[i]);
+        valid += verdicts[i];
+    }
+    return valid;
+}
+
+
+/*
+ * Function: isUnitConsistent
+ * --------------------------
+ * Checks one row, column, or subgrid of a puzzle: empty cells (0) are allowed, every given must be
+ * between 1 and SIZE, and no given may repeat.
+ *
+ * sudoku: The 9x9 puzzle.
+ * unit: Unit index in results order (rows, then columns, then subgrids).
+ *
+ * Returns: true if the unit's givens do not conflict, false otherwise.
+ */
+
+bool isUnitConsistent(const gridCell sudoku[SIZE][SIZE], int unit) {
+    unsigned seen = 0;
+
+    for (int i = 0; i < SIZE; i++) {
+        unsigned num = (unsigned)(&sudoku[0][0])[unitCells[unit][i]];
+        if (num == 0) {
+            continue;
+        }
+        if (num > SIZE || (seen & (1u << num))) {
+            return false;
+        }
+        seen |= 1u << num;
+    }
+    return true;
+}
+
+
+/*
+ * Function: validatePuzzle
+ * ------------------------
+ * Checks an unsolved puzzle in a single pass with the same bitmasks validateBitmask uses. Empty cells (0)
+ * are skipped, so only the givens are checked: each must be between 1 and SIZE and none may repeat
+ * within its row, column, or subgrid.
+ *
+ * sudoku: The 9x9 puzzle.
+ *
+ * Returns: true if the givens are consistent, false otherwise.
+ */
+
+bool validatePuzzle(const gridCell sudoku[SIZE][SIZE]) {
+    const gridCell *cells = &sudoku[0][0];
+    unsigned seen[NUM_THREADS] = {0};
+
+    for (int cell = 0; cell < SIZE * SIZE; cell++) {
+        unsigned num = (unsigned)cells[cell];
+        if (num == 0) {
+            continue;
+        }
+        if (num > SIZE) {
+            return false;
+        }
+        unsigned bit = 1u << num;
+        const unsigned char *units = cellUnits[cell];
+        if ((seen[units[0]] | seen[units[1]] | seen[units[2]]) & bit) {
+            return false;
+        }
+        seen[units[0]] |= bit;
+        seen[units[1]] |= bit;
+        seen[units[2]] |= bit;
+    }
+    return true;
+}
+
+
+/*
+ * Function: validatePuzzleBatch
+ * -----------------------------
+ * Checks a contiguous array of puzzles back to back with validatePuzzle.
+ *
+ * grids: Array of 9x9 puzzles.
+ * count: Number of puzzles in the array.
+ * verdicts: Output array with one entry per puzzle (1 consistent, 0 not).
+ *
+ * Returns: The number of consistent puzzles.
+ */
+
+size_t validatePuzzleBatch(const gridCell (*grids)[SIZE][SIZE], size_t count, unsigned char *verdicts) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+        verdicts[i] = validatePuzzle(grids[i]);
+        valid += verdicts[i];
+    }
+    return valid;
+}
+
+
 /*
  * Function: loadSudoku
  * --------------------
- * Loads the Sudoku puzzle from a plain text file into a 2D integer array.
+ * Loads the Sudoku puzzle from a plain text file into a 2D array of cells.
  *
  * params: 
  *      filename: String path to the file containing the Sudoku puzzle.
@@ -194,7 +481,8 @@ void *checkSubgrid(void *params) {
  * Returns: void. Exits the program on file read error.
  */
 
-void loadSudoku(const char *filename, int sudoku[SIZE][SIZE]) {
+void loadSudoku(const char *filename, gridCell sudoku[SIZE][SIZE]) {
+    int values[SIZE][SIZE] = {{0}};
     FILE *file = fopen(filename, "r");
     if (!file) {
         perror("Error opening file");
@@ -202,10 +490,137 @@ void loadSudoku(const char *filename, int sudoku[SIZE][SIZE]) {
     }
     for (int i = 0; i < SIZE; i++) {
         for (int j = 0; j < SIZE; j++) {
-            fscanf(file, "%d", &sudoku[i][j]);
+            fscanf(file, "%d", &values[i][j]);
         }
     }
     fclose(file);
+    packGrid(values, sudoku);
+}
+
+
+/*
+ * Function: packGrid
+ * ------------------
+ * Compatibility shim for grids held as ints: packs them into the one-byte cells every check works on.
+ *
+ * values: The grid as ints.
+ * sudoku: Receives the packed grid.
+ */
+
+void packGrid(const int values[SIZE][SIZE], gridCell sudoku[SIZE][SIZE]) {
+    for (int i = 0; i < SIZE; i++) {
+        for (int j = 0; j < SIZE; j++) {
+            sudoku[i][j] = toCell(values[i][j]);
+        }
+    }
+}
+
+
+/*
+ * Function: parseSudoku
+ * ---------------------
+ * Parses a grid from an in-memory copy of a puzzle file, in the same layout loadSudoku reads:
+ * SIZE*SIZE whitespace-separated numbers in row-major order. One-line grids (SIZE*SIZE characters with
+ * no separators) are accepted as well, and '.' may stand for an empty cell (0) in either layout.
+ * Only whitespace may follow the grid.
+ *
+ * params:
+ *      text: The file contents (need not be NUL-terminated).
+ *      length: Number of bytes in text.
+ *      sudoku: 2D array (9x9) to store the Sudoku puzzle numbers.
+ *
+ * Returns: true if a full grid was parsed, false if the text is short, holds something other than numbers,
+ *          or goes on after the grid.
+ */
+
+bool parseSudoku(const char *text, size_t length, gridCell sudoku[SIZE][SIZE]) {
+    const char *p = text, *end = text + length;
+
+    for (int cell = 0; cell < SIZE * SIZE;) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+
+        // A run holding a blank, or exactly SIZE*SIZE digits, has one cell per character
+        size_t run = 0;
+        bool blanks = false;
+        while (p + run < end && ((p[run] >= '0' && p[run] <= '9') || p[run] == '.')) {
+            blanks = blanks || p[run] == '.';
+            run++;
+        }
+        if (blanks || run == SIZE * SIZE) {
+            for (; run > 0 && cell < SIZE * SIZE; run--, p++, cell++) {
+                sudoku[cell / SIZE][cell % SIZE] = *p == '.' ? 0 : *p - '0';
+            }
+            continue;
+        }
+
+        bool negative = p < end && *p == '-';
+        p += negative;
+        if (p == end || *p < '0' || *p > '9') {
+            return false;
+        }
+        // The whole digit run is one number; it stops growing once it is out of range for a cell
+        long value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            value = value < CELL_OUT_OF_RANGE ? value * 10 + (*p - '0') : value;
+        }
+        sudoku[cell / SIZE][cell % SIZE] = toCell(negative ? -value : value);
+        cell++;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p == end;
+}
+
+
+/*
+ * Function: loadCorpus
+ * --------------------
+ * Loads every grid from a corpus file into memory. Any format corpusOpen understands is accepted:
+ * plain text holding one or more puzzles back to back (each run of SIZE*SIZE numbers forms one grid),
+ * the binary format (see CORPUS_MAGIC), and gzip or zstd compressed versions of either.
+ *
+ * params:
+ *      filename: String path to the corpus file.
+ *      count: Receives the number of complete grids read.
+ *
+ * Returns: A heap array of grids the caller must free, or NULL (with errno set) on failure.
+ */
+
+gridCell (*loadCorpus(const char *filename, size_t *count))[SIZE][SIZE] {
+    corpusStream *stream = corpusOpen(filename);
+    if (!stream) {
+        return NULL;
+    }
+
+    size_t capacity = 1024, n = 0, got;
+    gridCell (*grids)[SIZE][SIZE] = malloc(capacity * sizeof(*grids));
+    while (grids && (got = corpusNext(stream, grids + n, capacity - n)) > 0) {
+        n += got;
+        if (n == capacity) {
+            capacity *= 2;
+            gridCell (*grown)[SIZE][SIZE] = realloc(grids, capacity * sizeof(*grids));
+            if (!grown) {
+                free(grids);
+                grids = NULL;
+            }
+            grids = grown;
+        }
+    }
+
+    int error = grids ? corpusError(stream) : ENOMEM;
+    corpusClose(stream);
+    if (error) {
+        free(grids);
+        errno = error;
+        return NULL;
+    }
+
+    *count = n;
+    return grids;
 }
 
 
@@ -214,16 +629,14 @@ void loadSudoku(const char *filename, int sudoku[SIZE][SIZE]) {
  * ----------------------
  * Prints the validation results for each row, column, and subgrid checked by the threads.
  *
+ * out: Buffer the messages are appended to; nothing is written until the caller flushes it.
+ *
  * Returns: void.
  */
 
-void printResults() {
+void printResults(outputBuffer *out) {
     for (int i = 0; i < NUM_THREADS; i++) {
-        if (results[i].valid) {
-            printf("%s", results[i].message);
-        } else {
-            printf("%s", results[i].message);
-        }
+        outputString(out, results[i].message);
     }
 }
 
@@ -240,70 +653,143 @@ void printResults() {
  */
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <sudoku_puzzle_file>\n", argv[0]);
-        return EXIT_FAILURE;
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        return benchMain(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "gen") == 0) {
+        return genMain(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "batch") == 0) {
+        return batchMain(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "edit") == 0) {
+        return editMain(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "solve") == 0) {
+        return solveMain(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "ring") == 0) {
+        return ringMain(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && strcmp(argv[1], "daemon") == 0) {
+        return daemonMain(argc - 1, argv + 1);
     }
-    
-    int sudoku[SIZE][SIZE];
-    loadSudoku(argv[1], sudoku);
-    
-    pthread_mutex_init(&mutex, NULL);
-    
-    pthread_t tids[NUM_THREADS];
-    parameters params[NUM_THREADS];
-    
-    // Initialize parameters for each thread
-    for (int i = 0; i < SIZE; i++) {
-        // Initialize row checkers
-        params[i].row = i;
-        params[i].col = 0;
-        memcpy(params[i].sudoku, sudoku, SIZE*SIZE*sizeof(int));
-        pthread_create(&tids[i], NULL, checkRow, &params[i]);
 
-        // Initialize column checkers
-        params[SIZE + i].row = 0;
-        params[SIZE + i].col = i;
-        memcpy(params[SIZE + i].sudoku, sudoku, SIZE*SIZE*sizeof(int));
-        pthread_create(&tids[SIZE + i], NULL, checkColumn, &params[SIZE + i]);
+    // Leading options; --threads only matters when several files are validated
+    unsigned threads = 0;
+    ioBackend backend = IO_AUTO;
+    bool perfEnabled = false;
+    const char *perfJson = NULL;
+    const char *metricsFile = NULL;
+    int arg = 1;
+    while (arg < argc - 1 && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "--perf") == 0) {
+            perfEnabled = true;
+            arg++;
+        } else if (strcmp(argv[arg], "--perf-json") == 0 && arg + 2 < argc) {
+            perfEnabled = true;
+            perfJson = argv[arg + 1];
+            arg += 2;
+        } else if (strcmp(argv[arg], "--metrics") == 0 && arg + 2 < argc) {
+            metricsFile = argv[arg + 1];
+            arg += 2;
+        } else if (strcmp(argv[arg], "--threads") == 0 && arg + 2 < argc) {
+            threads = (unsigned)strtoul(argv[arg + 1], NULL, 10);
+            arg += 2;
+        } else if (strcmp(argv[arg], "--io") == 0 && arg + 2 < argc) {
+            const char *mode = argv[arg + 1];
+            backend = strcmp(mode, "uring") == 0 ? IO_URING : strcmp(mode, "threads") == 0 ? IO_THREADS : IO_AUTO;
+            arg += 2;
+        } else {
+            break;
+        }
     }
 
-    // Initialize subgrid checkers
-    for (int i = 0; i < SIZE; i += 3) {
-        for (int j = 0; j < SIZE; j += 3) {
-            int index = 2*SIZE + (i + j/3);
-            params[index].row = i;
-            params[index].col = j;
-            memcpy(params[index].sudoku, sudoku, SIZE*SIZE*sizeof(int));
-            pthread_create(&tids[index], NULL, checkSubgrid, &params[index]);
+    if (argc - arg > 1 || (argc - arg == 1 && isMultiPath(argv[arg]))) {
+        // Perf counters and metrics cover the phases of a single file, run on this thread
+        if (perfEnabled || metricsFile) {
+            fprintf(stderr, "--perf, --perf-json, and --metrics take a single puzzle file\n");
+            return EXIT_FAILURE;
         }
+        return validatePaths(argv + arg, argc - arg, threads, backend);
+    }
+
+    if (argc - arg != 1) {
+        printf("Usage: %s [--perf] [--perf-json FILE] [--metrics FILE] <sudoku_puzzle_file>\n", argv[0]);
+        printf("       %s [--threads T] [--io auto|uring|threads] <file|directory|glob|@listfile>...\n", argv[0]);
+        printf("       %s bench [options] [corpus_file]\n", argv[0]);
+        printf("       %s gen [options]\n", argv[0]);
+        printf("       %s batch [options] <corpus_file>\n", argv[0]);
+        printf("       %s edit [<sudoku_puzzle_file>] < edits\n", argv[0]);
+        printf("       %s solve [options] <puzzle_file>\n", argv[0]);
+        printf("       %s ring serve|submit ...\n", argv[0]);
+        printf("       %s daemon [options] <socket_path>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *filename = argv[arg];
+
+    if (perfEnabled) {
+        perfOpen();
+    }
+    if (metricsFile) {
+#ifdef SUDOKU_NO_METRICS
+        fprintf(stderr, "Metrics were compiled out (SUDOKU_NO_METRICS); ignoring --metrics\n");
+        metricsFile = NULL;
+#endif
+        metricsEnable();
     }
     
-    // Join threads
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pthread_join(tids[i], NULL);
+    gridCell sudoku[SIZE][SIZE];
+    perfBegin(PHASE_PARSE);
+    uint64_t phaseStart = METRICS_NOW();
+    loadSudoku(filename, sudoku);
+    metricsPhaseAdd(METRIC_LOAD, METRICS_NOW() - phaseStart);
+    perfEnd(PHASE_PARSE);
+    
+    perfBegin(PHASE_VALIDATE);
+    phaseStart = METRICS_NOW();
+    bool isValid = validateThreaded(sudoku);
+    metricsGridLatency(METRICS_NOW() - phaseStart);
+    perfEnd(PHASE_VALIDATE);
+
+    perfBegin(PHASE_REPORT);
+    phaseStart = METRICS_NOW();
+
+    // Print results; the whole report goes out in a single write
+    outputBuffer out;
+    if (!outputInit(&out, STDOUT_FILENO, 4096)) {
+        perror("Error allocating output buffer");
+        return EXIT_FAILURE;
     }
+    printResults(&out);
 
-    // Check results and determine overall validity
-    bool isValid = true; // Assume the solution is valid initially
-    for (int i = 0; i < NUM_THREADS; i++) {
-        if (results[i].valid == 0) { // If any thread found the solution to be invalid
-            isValid = false;
-            break;
-        }
+    // Print the final outcome
+    outputString(&out, filename);
+    outputString(&out, isValid ? " contains a valid solution\n" : " contains an INVALID solution\n");
+    if (!outputFlush(&out)) {
+        perror("Error writing results");
     }
+    outputFree(&out);
 
-    // Print results
-    printResults();
+    metricsPhaseAdd(METRIC_PRINT, METRICS_NOW() - phaseStart);
+    perfEnd(PHASE_REPORT);
 
-    pthread_mutex_destroy(&mutex);
+    if (metricsFile && !metricsWrite(metricsFile)) {
+        perror("Error writing metrics file");
+    }
 
-    // Print the final outcome
-    if (isValid) {
-        printf("%s contains a valid solution\n", argv[1]);
-    } else {
-        printf("%s contains an INVALID solution\n", argv[1]);
+    if (perfJson) {
+        FILE *perfOut = fopen(perfJson, "w");
+        if (!perfOut) {
+            perror("Error opening perf output file");
+        } else {
+            perfReport(perfOut, true);
+            fclose(perfOut);
+        }
+    } else if (perfEnabled) {
+        perfReport(stderr, false);
     }
+    perfClose();
 
     return EXIT_SUCCESS;
 }
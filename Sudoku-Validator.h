@@ -0,0 +1,447 @@
+/*
+ * File: Sudoku-Validator.h
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Shared definitions for the Sudoku validator. Declares the grid layout, the
+ *              validation engines, the loaders, and the entry points of each subcommand.
+ */
+
+#ifndef SUDOKU_VALIDATOR_H
+#define SUDOKU_VALIDATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Define the box shape, the size of the Sudoku grid, and the total number of threads required. Boxes are
+// BOX_ROWS rows by BOX_COLS columns, with SIZE = BOX_ROWS * BOX_COLS. The shared tables and validators
+// follow any shape, but the generator, the bitboard solver, and the variants are written for 3x3 boxes
+// and stop the build otherwise; other shapes are handled at run time (see gridShape and --box).
+#define BOX_ROWS 3
+#define BOX_COLS 3
+#define SIZE (BOX_ROWS * BOX_COLS)
+#define NUM_THREADS (SIZE * 3) // 27 threads: 9 for rows, 9 for columns, 9 for subgrids
+
+// One cell of a grid. Grids are stored as SIZE x SIZE bytes (81 for 9x9) throughout, with 0 for an empty
+// cell, so a grid is a quarter of its int size and matches the binary corpus layout byte for byte.
+// Numbers that do not fit a byte are stored as CELL_OUT_OF_RANGE, which every check rejects just as it
+// would the original number.
+typedef uint8_t gridCell;
+#define CELL_OUT_OF_RANGE 0xFF
+
+// Struct to pass parameters to the threads.
+typedef struct {
+    int row;
+    int col;
+    gridCell sudoku[SIZE][SIZE];
+} parameters;
+
+// Struct to store the validation result and message for each thread.
+typedef struct {
+    int valid; // 0 for invalid, 1 for valid
+    char message[100];
+} validationResult;
+
+// Binary corpus layout: an 8-byte header ("SDKB", version, grid size, two reserved bytes)
+// followed by SIZE*SIZE bytes per grid in row-major order.
+#define CORPUS_MAGIC "SDKB"
+#define CORPUS_VERSION 1
+#define CORPUS_HEADER_SIZE 8
+
+// Defects the corpus generator can inject into an otherwise valid grid.
+typedef enum {
+    INVALID_NONE,
+    INVALID_SWAP,    // Two cells of a row exchanged
+    INVALID_RANGE,   // One cell set to 0 or SIZE + 1
+    INVALID_ROW,     // One cell duplicated within its row
+    INVALID_COLUMN,  // One cell duplicated within its column
+    INVALID_SUBGRID, // One cell duplicated within its subgrid
+    INVALID_MIXED    // One of the above, chosen per grid
+} invalidKind;
+
+// Phases instrumented by the performance counters.
+typedef enum {
+    PHASE_PARSE,
+    PHASE_VALIDATE,
+    PHASE_REPORT,
+    NUM_PHASES
+} phaseId;
+
+// Struct for a buffered writer that flushes to a file descriptor in large chunks.
+typedef struct {
+    int fd;
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;     // Set once a write fails; later output is discarded
+} outputBuffer;
+
+// How much the batch validator reports per grid.
+typedef enum {
+    VERDICT_FULL,    // The 27 unit lines and a summary line, as for a single grid
+    VERDICT_LINE,    // One "valid" or "INVALID" line per grid
+    VERDICT_BYTE,    // One byte per grid: '1' valid, '0' invalid
+    VERDICT_BITMAP   // One bit per grid, least significant bit first; 1 means valid
+} verdictMode;
+
+// Unit indices in results order: rows first, then columns, then subgrids. Subgrids are numbered
+// row-major; each band of BOX_ROWS rows holds SIZE / BOX_COLS of them.
+#define ROW_UNIT(row) (row)
+#define COLUMN_UNIT(col) (SIZE + (col))
+#define BOX_INDEX(row, col) (((row) / BOX_ROWS) * (SIZE / BOX_COLS) + (col) / BOX_COLS)
+#define SUBGRID_UNIT(row, col) (2 * SIZE + BOX_INDEX(row, col))
+
+// Cells sharing a row, column, or subgrid with a given cell: 8 + 8 + 4 for a 9x9 grid.
+#define NUM_PEERS (2 * (SIZE - 1) + (BOX_ROWS - 1) * (BOX_COLS - 1))
+
+// Grids of other shapes, handled by the shape validator and the DLX solver. Numbers must fit a
+// 64-bit mask, so the largest grid is 64x64.
+#define MAX_ORDER 64
+
+// Struct describing a grid shape: boxes of boxRows x boxCols cells in a grid of order x order cells.
+typedef struct {
+    int boxRows;
+    int boxCols;
+    int order;           // boxRows * boxCols
+} gridShape;
+
+// Struct for a grid that is edited one cell at a time. Every row, column, and subgrid keeps a count
+// per number, a bitmask of the numbers present, and its surplus (duplicate) occurrences, so a single
+// cell change updates the whole verdict in constant time.
+typedef struct {
+    unsigned char cells[SIZE][SIZE];              // 0 for an empty cell
+    unsigned char counts[NUM_THREADS][SIZE + 1];  // Occurrences of each number per unit
+    uint16_t present[NUM_THREADS];                // Bit n - 1 set while number n occurs in the unit
+    unsigned char duplicates[NUM_THREADS];        // Occurrences beyond the first, per unit
+    int totalDuplicates;
+    int filled;
+} incrementalGrid;
+
+// Sudoku variants. Each is a table of units that must hold 1..SIZE exactly once: X adds the two
+// diagonals, windoku adds four windows, and jigsaw replaces the subgrids with irregular regions.
+typedef enum {
+    VARIANT_STANDARD,
+    VARIANT_X,
+    VARIANT_WINDOKU,
+    VARIANT_JIGSAW
+} variantKind;
+
+typedef enum {
+    UNIT_ROW,
+    UNIT_COLUMN,
+    UNIT_SUBGRID,
+    UNIT_DIAGONAL,
+    UNIT_WINDOW,
+    UNIT_REGION
+} unitKind;
+
+#define MAX_UNITS (NUM_THREADS + 4)
+
+// Struct for the unit table of a variant.
+typedef struct {
+    variantKind variant;
+    int count;
+    unsigned char cells[MAX_UNITS][SIZE];           // Row-major cell indices of each unit
+    unsigned char kind[MAX_UNITS];                  // unitKind of each unit
+    unsigned char number[MAX_UNITS];                // 1-based position among units of the same kind
+    bool (*kernel)(const gridCell sudoku[SIZE][SIZE]);   // Specialized check for complete grids, or NULL
+} unitTable;
+
+// Array to store the results from all threads.
+extern validationResult results[NUM_THREADS];
+
+// Unit tables, built at compile time in Sudoku-Tables.c: the row, column, and subgrid unit of every cell,
+// the cells (row-major indices) of every unit in results order, and the peers of every cell.
+extern const unsigned char cellUnits[SIZE * SIZE][3];
+extern const unsigned char unitCells[NUM_THREADS][SIZE];
+extern const unsigned char cellPeers[SIZE * SIZE][NUM_PEERS];
+
+
+// Per-unit checks shared by every engine.
+bool isRowValid(const gridCell sudoku[SIZE][SIZE], int row);
+bool isColumnValid(const gridCell sudoku[SIZE][SIZE], int col);
+bool isSubgridValid(const gridCell sudoku[SIZE][SIZE], int rowStart, int colStart);
+
+// Validation engines. All of them agree on the verdict; they differ only in how the work is scheduled.
+bool validateThreaded(const gridCell sudoku[SIZE][SIZE]);
+bool validateSerial(const gridCell sudoku[SIZE][SIZE]);
+bool validateBitmask(const gridCell sudoku[SIZE][SIZE]);
+size_t validateBatch(const gridCell (*grids)[SIZE][SIZE], size_t count, unsigned char *verdicts);
+
+// Puzzle checks: 0 marks an empty cell, and only the givens must be in range and free of duplicates.
+bool isUnitConsistent(const gridCell sudoku[SIZE][SIZE], int unit);
+bool validatePuzzle(const gridCell sudoku[SIZE][SIZE]);
+size_t validatePuzzleBatch(const gridCell (*grids)[SIZE][SIZE], size_t count, unsigned char *verdicts);
+
+// Loaders and reporting.
+void loadSudoku(const char *filename, gridCell sudoku[SIZE][SIZE]);
+bool parseSudoku(const char *text, size_t length, gridCell sudoku[SIZE][SIZE]);
+void packGrid(const int values[SIZE][SIZE], gridCell sudoku[SIZE][SIZE]);
+gridCell (*loadCorpus(const char *filename, size_t *count))[SIZE][SIZE];
+void printResults(outputBuffer *out);
+
+// Incremental validation.
+void incrementalInit(incrementalGrid *grid);
+bool incrementalLoad(incrementalGrid *grid, const gridCell sudoku[SIZE][SIZE]);
+bool incrementalSetCell(incrementalGrid *grid, int row, int col, int value);
+bool incrementalUnitValid(const incrementalGrid *grid, int unit);
+bool incrementalConsistent(const incrementalGrid *grid);
+bool incrementalComplete(const incrementalGrid *grid);
+
+// Thread placement. CPU lists are bitmaps of up to MAX_CPUS CPUs; an empty list leaves those threads
+// wherever the scheduler puts them.
+#define MAX_CPUS 1024
+
+typedef struct {
+    uint64_t workers[MAX_CPUS / 64];  // CPUs for the pool workers
+    uint64_t io[MAX_CPUS / 64];       // CPUs for the thread that reads and writes the corpus
+    bool pinEach;                     // Pin each worker to one CPU of workers in turn, rather than share them
+    unsigned firstWorker;             // Added to each worker's index with pinEach, so that the pools of
+                                      // several processes take turns over the list instead of overlapping
+} cpuPlacement;
+
+bool isPlacementOption(const char *option);
+bool parsePlacementOption(cpuPlacement *placement, const char *option, const char *value);
+unsigned defaultThreads(const cpuPlacement *placement);
+bool placeWorkerThread(const cpuPlacement *placement, unsigned index);
+bool placeIoThread(const cpuPlacement *placement);
+
+// Work-stealing thread pool. Tasks have the pthread start-routine signature; their results are ignored.
+typedef struct workPool workPool;
+workPool *poolCreate(unsigned threads, const cpuPlacement *placement);
+void poolDestroy(workPool *pool);
+unsigned poolSize(const workPool *pool);
+int poolWorkerIndex(void);
+void poolSubmit(workPool *pool, void *(*fn)(void *), void *arg);
+bool poolWantsWork(const workPool *pool);
+void poolWait(workPool *pool);
+
+// Solver. Both calls count solutions up to a limit (2 tells unique puzzles apart) and store one of them.
+int solveGrid(const gridCell puzzle[SIZE][SIZE], gridCell solution[SIZE][SIZE], int limit);
+int solveGridParallel(const gridCell puzzle[SIZE][SIZE], gridCell solution[SIZE][SIZE], int limit, workPool *pool);
+
+// Grids of any shape. Cells are order^2 bytes in row-major order; shapeKernel returns NULL for shapes
+// without a compiled kernel, which shapeValidate handles instead.
+bool parseShape(const char *text, gridShape *shape);
+bool (*shapeKernel(const gridShape *shape, bool allowEmpty))(const gridCell *cells);
+bool shapeValidate(const gridShape *shape, const gridCell *cells, bool allowEmpty);
+bool shapeUnitValid(const gridShape *shape, const gridCell *cells, int unit, bool allowEmpty);
+bool readGridText(FILE *file, int order, gridCell *cells);
+
+// Dancing-links exact-cover solver for any shape. Each solver owns its matrix, so use one per thread.
+typedef struct dlxSolver dlxSolver;
+dlxSolver *dlxCreate(const gridShape *shape);
+void dlxDestroy(dlxSolver *dlx);
+int dlxOrder(const dlxSolver *dlx);
+int dlxSolve(dlxSolver *dlx, const gridCell *puzzle, gridCell *solution, int limit);
+int dlxSolveFile(const char *path, const gridShape *shape, unsigned threads, const cpuPlacement *placement,
+                 bool unique, bool verdictOnly);
+
+// Variant validation. validateUnits is the generic engine for any table; table->kernel, when set, is
+// the faster equivalent for complete grids.
+int parseVariant(const char *name);
+bool loadRegions(const char *path, gridCell regions[SIZE][SIZE]);
+bool unitTableBuild(unitTable *table, variantKind variant, const gridCell regions[SIZE][SIZE]);
+bool isTableUnitValid(const unitTable *table, const gridCell sudoku[SIZE][SIZE], int unit, bool allowEmpty);
+bool validateUnits(const unitTable *table, const gridCell sudoku[SIZE][SIZE], bool allowEmpty);
+const char *unitKindName(const unitTable *table, int unit);
+
+// Bump allocator for batch storage: slabs are mapped whole (huge pages where available) and every
+// allocation is released at once by arenaFree.
+typedef struct arenaSlab arenaSlab;
+
+typedef struct {
+    arenaSlab *slabs;    // In mapping order
+    arenaSlab *current;  // Last slab mapped, which allocations are carved from
+    size_t slabBytes;
+    size_t footprint;    // Bytes mapped
+    bool hugePages;      // Whether any slab got explicit huge pages
+} arena;
+
+void arenaInit(arena *a, size_t slabBytes);
+void *arenaAlloc(arena *a, size_t bytes);
+void arenaFree(arena *a);
+
+// Buffered output.
+int parseVerdictMode(const char *name);
+bool outputInit(outputBuffer *out, int fd, size_t capacity);
+void outputAttach(outputBuffer *out, int fd, char *data, size_t capacity);
+void outputFree(outputBuffer *out);
+bool outputFlush(outputBuffer *out);
+bool outputFlushAll(outputBuffer *buffers, size_t count);
+void outputBytes(outputBuffer *out, const void *data, size_t length);
+void outputString(outputBuffer *out, const char *text);
+void outputUnsigned(outputBuffer *out, uint64_t value);
+void outputUnitLine(outputBuffer *out, int index, bool valid);
+void outputNamedUnitLine(outputBuffer *out, int index, const char *kind, int number, bool valid);
+
+// Streaming corpus reader for text, binary, and gzip/zstd compressed corpora.
+typedef struct corpusStream corpusStream;
+corpusStream *corpusOpen(const char *filename);
+size_t corpusNext(corpusStream *stream, gridCell (*grids)[SIZE][SIZE], size_t max);
+int corpusError(const corpusStream *stream);
+int64_t corpusOffset(const corpusStream *stream);
+bool corpusSeek(corpusStream *stream, int64_t offset);
+bool corpusRange(corpusStream *stream, int64_t start, int64_t end);
+void corpusClose(corpusStream *stream);
+
+// Progress of a batch run, saved periodically so an interrupted run can resume where it stopped.
+typedef struct {
+    uint64_t corpusSize;     // Size and modification time of the corpus, to catch a changed file
+    int64_t corpusModified;
+    int mode;                // Options that shape the output; a resumed run must use the same ones
+    int puzzle;
+    int variant;
+    int boxRows;
+    int boxCols;
+    uint64_t grids;          // Grids validated and written so far
+    uint64_t valid;
+    int64_t input;           // Byte offset of the next grid in the corpus, or -1 to skip grids by parsing
+    uint64_t output;         // Bytes of verdicts written, all on disk
+} batchCheckpoint;
+
+bool checkpointSave(const char *path, const batchCheckpoint *checkpoint);
+bool checkpointLoad(const char *path, batchCheckpoint *checkpoint);
+
+// Corpus generation.
+int parseInvalidKind(const char *name);
+void generateGrid(gridCell grid[SIZE][SIZE], uint64_t seed, uint64_t index, invalidKind kind, unsigned percent);
+bool writeCorpusHeader(FILE *file);
+
+// Hardware performance counters (perf_event_open). All calls are cheap no-ops until perfOpen succeeds.
+bool perfOpen(void);
+void perfBegin(phaseId phase);
+void perfEnd(phaseId phase);
+void perfReport(FILE *out, bool json);
+void perfClose(void);
+
+// Pipeline phases tracked by the metrics exporter.
+typedef enum {
+    METRIC_LOAD,
+    METRIC_THREAD_SETUP,
+    METRIC_CHECK,
+    METRIC_PRINT,
+    NUM_METRIC_PHASES
+} metricPhase;
+
+// Run metrics in Prometheus text format. Compiling with -DSUDOKU_NO_METRICS turns every call into an
+// empty inline function; otherwise each call is a single branch until metricsEnable is called.
+#define METRICS_MAX_SLOTS 256
+
+#ifndef SUDOKU_NO_METRICS
+extern bool metricsOn;
+void metricsEnable(void);
+void metricsPhaseAdd(metricPhase phase, uint64_t nanos);
+void metricsUnitChecked(int slot, bool valid, uint64_t nanos);
+void metricsGridLatency(uint64_t nanos);
+bool metricsWrite(const char *path);
+#define METRICS_NOW() (metricsOn ? nowNanos() : 0)
+#else
+#define metricsOn false
+static inline void metricsEnable(void) {}
+static inline void metricsPhaseAdd(metricPhase phase, uint64_t nanos) { (void)phase; (void)nanos; }
+static inline void metricsUnitChecked(int slot, bool valid, uint64_t nanos) { (void)slot; (void)valid; (void)nanos; }
+static inline void metricsGridLatency(uint64_t nanos) { (void)nanos; }
+static inline bool metricsWrite(const char *path) { (void)path; return false; }
+#define METRICS_NOW() 0
+#endif
+
+// Multi-file validation. Exit codes of validatePaths summarise the whole run.
+#define EXIT_ALL_VALID 0
+#define EXIT_SOME_INVALID 1
+#define EXIT_SOME_UNREADABLE 2
+
+// How the multi-file validator reads files.
+typedef enum {
+    IO_AUTO,         // io_uring when the kernel allows it, plain reads otherwise
+    IO_URING,
+    IO_THREADS
+} ioBackend;
+
+bool isMultiPath(const char *path);
+int readWholeFile(const char *path, char **data, size_t *capacity, size_t *length);
+int validatePaths(char *paths[], int count, unsigned threads, ioBackend backend);
+
+// io_uring file ingestion. uringCreate returns NULL where io_uring is unavailable.
+typedef struct uringReader uringReader;
+uringReader *uringCreate(unsigned depth);
+void uringDestroy(uringReader *r);
+bool uringIngest(uringReader *r, char *(*next)(bool wait, bool *done),
+                 void (*sink)(void *context, char *path, const char *data, size_t length, int error),
+                 void *context);
+char *uringTakeUnfinished(uringReader *r);
+
+// Shared memory submission ring. Producers in any process submit grids and collect their own verdicts
+// without system calls while the validator is busy; see Sudoku-Ring.c.
+typedef struct ringChannel ringChannel;
+#define RING_WAIT_VERDICT 1u // ringWait: a verdict is ready to collect
+#define RING_WAIT_SPACE 2u   // ringWait: a submission slot is free
+ringChannel *ringCreate(const char *name, unsigned slots, unsigned producers, bool puzzle);
+ringChannel *ringAttach(const char *name);
+bool ringSubmit(ringChannel *ring, const gridCell grid[SIZE][SIZE], uint64_t tag);
+bool ringReap(ringChannel *ring, uint64_t *tag, bool *valid);
+void ringWait(ringChannel *ring, unsigned waitFor);
+bool ringClosed(const ringChannel *ring);
+void ringClose(ringChannel *ring);
+
+// Subcommand entry points. Each receives argv with the subcommand name in argv[0].
+int benchMain(int argc, char *argv[]);
+int genMain(int argc, char *argv[]);
+int batchMain(int argc, char *argv[]);
+int editMain(int argc, char *argv[]);
+int solveMain(int argc, char *argv[]);
+int ringMain(int argc, char *argv[]);
+int daemonMain(int argc, char *argv[]);
+
+
+/*
+ * Function: nowNanos
+ * ------------------
+ * Reads the monotonic clock.
+ *
+ * Returns: Nanoseconds since an arbitrary fixed point.
+ */
+
+static inline uint64_t nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+
+/*
+ * Function: readCycles
+ * --------------------
+ * Reads the CPU timestamp counter where the architecture exposes one.
+ *
+ * Returns: The current cycle count, or 0 on architectures without a readable counter.
+ */
+
+static inline uint64_t readCycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+/*
+ * Function: toCell
+ * ----------------
+ * Stores a parsed number in a grid cell.
+ *
+ * Returns: The number, or CELL_OUT_OF_RANGE if it is negative or does not fit a cell.
+ */
+
+static inline gridCell toCell(long value) {
+    return value >= 0 && value < CELL_OUT_OF_RANGE ? (gridCell)value : CELL_OUT_OF_RANGE;
+}
+
+#endif
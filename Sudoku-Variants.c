@@ -0,0 +1,277 @@
+/*
+ * File: Sudoku-Variants.c
+ * Author: Joel Daniel
+ * Date: March 5th, 2024
+ * Description: Table-driven validation for Sudoku variants. A variant is a list of units (sets of SIZE
+ *              cells that must each hold 1..SIZE exactly once): the standard rows, columns, and
+ *              subgrids, plus the two diagonals for X Sudoku or the four extra windows for windoku, or
+ *              with irregular regions replacing the subgrids for jigsaw. Any table can be checked by
+ *              the generic engine; the fixed variants also get kernels compiled from constant tables.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sudoku-Validator.h"
+
+// The diagonals and windoku windows below are laid out for 9x9 grids.
+#if BOX_ROWS != 3 || BOX_COLS != 3
+#error "Sudoku-Variants.c supports only 3x3 boxes"
+#endif
+
+// Row-major index of a cell, and the cells of a 3x3 block with the given top-left corner.
+#define CELL(r, c) ((r) * SIZE + (c))
+#define BLOCK(r, c) {CELL(r, c), CELL(r, c + 1), CELL(r, c + 2), CELL(r + 1, c), CELL(r + 1, c + 1), \
+                     CELL(r + 1, c + 2), CELL(r + 2, c), CELL(r + 2, c + 1), CELL(r + 2, c + 2)}
+
+// Extra units of the fixed variants, known at compile time.
+static const unsigned char diagonalUnits[2][SIZE] = {
+    {CELL(0, 0), CELL(1, 1), CELL(2, 2), CELL(3, 3), CELL(4, 4), CELL(5, 5), CELL(6, 6), CELL(7, 7), CELL(8, 8)},
+    {CELL(0, 8), CELL(1, 7), CELL(2, 6), CELL(3, 5), CELL(4, 4), CELL(5, 3), CELL(6, 2), CELL(7, 1), CELL(8, 0)},
+};
+static const unsigned char windowUnits[4][SIZE] = {BLOCK(1, 1), BLOCK(1, 5), BLOCK(5, 1), BLOCK(5, 5)};
+
+static const char *variantNames[] = {"standard", "x", "windoku", "jigsaw"};
+static const char *unitKindNames[] = {"row", "column", "subgrid", "diagonal", "window", "region"};
+
+
+/*
+ * Function: checkUnits
+ * --------------------
+ * Checks that each of a list of units holds 1..SIZE exactly once. Inlined into the kernels below with
+ * a constant table and count, so the compiler can unroll it against the fixed cell indices.
+ *
+ * sudoku: The grid to check.
+ * units: The units, as row-major cell indices.
+ * count: Number of units.
+ *
+ * Returns: true if every unit is valid, false otherwise.
+ */
+
+static inline bool checkUnits(const gridCell sudoku[SIZE][SIZE], const unsigned char (*units)[SIZE], int count) {
+    const gridCell *cells = &sudoku[0][0];
+
+    for (int u = 0; u < count; u++) {
+        unsigned seen = 0;
+        for (int i = 0; i < SIZE; i++) {
+            unsigned num = (unsigned)cells[units[u][i]] - 1;
+            if (num >= SIZE || (seen & (1u << num))) {
+                return false;
+            }
+            seen |= 1u << num;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: validateX
+ * -------------------
+ * Kernel for X Sudoku: the standard single-pass bitmask check, then both diagonals.
+ */
+
+static bool validateX(const gridCell sudoku[SIZE][SIZE]) {
+    return validateBitmask(sudoku) && checkUnits(sudoku, diagonalUnits, 2);
+}
+
+
+/*
+ * Function: validateWindoku
+ * -------------------------
+ * Kernel for windoku: the standard single-pass bitmask check, then the four extra windows.
+ */
+
+static bool validateWindoku(const gridCell sudoku[SIZE][SIZE]) {
+    return validateBitmask(sudoku) && checkUnits(sudoku, windowUnits, 4);
+}
+
+
+/*
+ * Function: parseVariant
+ * ----------------------
+ * Maps a --variant argument to its variantKind.
+ *
+ * Returns: The matching variant, or -1 if the name is unknown.
+ */
+
+int parseVariant(const char *name) {
+    for (size_t i = 0; i < sizeof(variantNames) / sizeof(variantNames[0]); i++) {
+        if (strcmp(name, variantNames[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+
+/*
+ * Function: addUnit
+ * -----------------
+ * Appends one unit to a table.
+ */
+
+static void addUnit(unitTable *table, const unsigned char cells[SIZE], unitKind kind, int number) {
+    memcpy(table->cells[table->count], cells, SIZE);
+    table->kind[table->count] = (unsigned char)kind;
+    table->number[table->count] = (unsigned char)number;
+    table->count++;
+}
+
+
+/*
+ * Function: unitTableBuild
+ * ------------------------
+ * Builds the unit table of a variant. Rows and columns come first, in results order; then the subgrids
+ * (or, for jigsaw, the regions); then any extra units.
+ *
+ * params:
+ *      table: The table to fill.
+ *      variant: Which variant to build.
+ *      regions: For jigsaw, the region (1..SIZE) of every cell; ignored otherwise.
+ *
+ * Returns: true on success, false if a jigsaw region map does not split the grid into SIZE regions of
+ *          SIZE cells.
+ */
+
+bool unitTableBuild(unitTable *table, variantKind variant, const gridCell regions[SIZE][SIZE]) {
+    unsigned char cells[SIZE];
+
+    table->variant = variant;
+    table->count = 0;
+    for (int r = 0; r < SIZE; r++) {
+        addUnit(table, unitCells[ROW_UNIT(r)], UNIT_ROW, r + 1);
+    }
+    for (int c = 0; c < SIZE; c++) {
+        addUnit(table, unitCells[COLUMN_UNIT(c)], UNIT_COLUMN, c + 1);
+    }
+
+    if (variant == VARIANT_JIGSAW) {
+        for (int region = 1; region <= SIZE; region++) {
+            int n = 0;
+            for (int cell = 0; cell < SIZE * SIZE; cell++) {
+                if (regions[cell / SIZE][cell % SIZE] == region) {
+                    if (n == SIZE) {
+                        return false;
+                    }
+                    cells[n++] = (unsigned char)cell;
+                }
+            }
+            if (n != SIZE) {
+                return false;
+            }
+            addUnit(table, cells, UNIT_REGION, region);
+        }
+    } else {
+        for (int b = 0; b < SIZE; b++) {
+            addUnit(table, unitCells[2 * SIZE + b], UNIT_SUBGRID, b + 1);
+        }
+    }
+
+    table->kernel = validateBitmask;
+    if (variant == VARIANT_X) {
+        addUnit(table, diagonalUnits[0], UNIT_DIAGONAL, 1);
+        addUnit(table, diagonalUnits[1], UNIT_DIAGONAL, 2);
+        table->kernel = validateX;
+    } else if (variant == VARIANT_WINDOKU) {
+        for (int w = 0; w < 4; w++) {
+            addUnit(table, windowUnits[w], UNIT_WINDOW, w + 1);
+        }
+        table->kernel = validateWindoku;
+    } else if (variant == VARIANT_JIGSAW) {
+        table->kernel = NULL;
+    }
+    return true;
+}
+
+
+/*
+ * Function: loadRegions
+ * ---------------------
+ * Reads a jigsaw region map: SIZE*SIZE region numbers 1..SIZE in row-major order, laid out like a
+ * puzzle file (whitespace-separated or one line).
+ *
+ * path: The region map file.
+ * regions: Receives the region of every cell.
+ *
+ * Returns: true on success, false if the file cannot be read (errno set) or is malformed (errno EINVAL).
+ */
+
+bool loadRegions(const char *path, gridCell regions[SIZE][SIZE]) {
+    char *data = NULL;
+    size_t capacity = 0, length;
+    int error = readWholeFile(path, &data, &capacity, &length);
+    bool ok = !error && parseSudoku(data, length, regions);
+
+    free(data);
+    errno = error ? error : EINVAL;
+    return ok;
+}
+
+
+/*
+ * Function: isTableUnitValid
+ * --------------------------
+ * Checks one unit of a table.
+ *
+ * table: The variant's units.
+ * sudoku: The grid to check.
+ * unit: Index into the table.
+ * allowEmpty: Puzzle mode: 0 is an empty cell and only the givens must not repeat.
+ *
+ * Returns: true if the unit is valid, false otherwise.
+ */
+
+bool isTableUnitValid(const unitTable *table, const gridCell sudoku[SIZE][SIZE], int unit, bool allowEmpty) {
+    const gridCell *cells = &sudoku[0][0];
+    unsigned seen = 0;
+
+    for (int i = 0; i < SIZE; i++) {
+        unsigned num = (unsigned)cells[table->cells[unit][i]];
+        if (allowEmpty && num == 0) {
+            continue;
+        }
+        if (num - 1 >= SIZE || (seen & (1u << num))) {
+            return false;
+        }
+        seen |= 1u << num;
+    }
+    return true;
+}
+
+
+/*
+ * Function: validateUnits
+ * -----------------------
+ * The generic engine: checks every unit of a table. Handles any variant, including jigsaw regions and
+ * puzzle mode; the fixed variants have faster kernels in table->kernel for complete grids.
+ *
+ * table: The variant's units.
+ * sudoku: The grid to check.
+ * allowEmpty: Puzzle mode: 0 is an empty cell and only the givens must not repeat.
+ *
+ * Returns: true if every unit is valid, false otherwise.
+ */
+
+bool validateUnits(const unitTable *table, const gridCell sudoku[SIZE][SIZE], bool allowEmpty) {
+    for (int unit = 0; unit < table->count; unit++) {
+        if (!isTableUnitValid(table, sudoku, unit, allowEmpty)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Function: unitKindName
+ * ----------------------
+ * Returns: The word used for a unit in report lines ("row", "diagonal", ...).
+ */
+
+const char *unitKindName(const unitTable *table, int unit) {
+    return unitKindNames[table->kind[unit]];
+}